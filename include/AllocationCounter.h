@@ -0,0 +1,39 @@
+// AllocationCounter.h
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "EnginePhase.h"
+
+// Counts the calls to the global operator new made by each thread, split by
+// engine phase (see EnginePhase.h), so the benchmark and search stats can
+// show how often the engine touches the heap. Counting replaces operator new
+// and is only compiled into builds configured with
+// -DBLACKJACKLAB_COUNT_ALLOCATIONS=ON; other builds report zero.
+namespace AllocationCounter {
+#ifdef BLACKJACKLAB_COUNT_ALLOCATIONS
+constexpr bool kEnabled = true;
+#else
+constexpr bool kEnabled = false;
+#endif
+
+// Stores a number of allocations
+struct Counts {
+  uint64_t allocations = 0;
+  uint64_t bytes = 0;
+
+  // Adds another count to this one
+  void merge(const Counts& other) {
+    allocations += other.allocations;
+    bytes += other.bytes;
+  }
+};
+using PhaseCounts = std::array<Counts, EnginePhase::kNumPhases>;
+
+// Returns the allocations made by the calling thread since it started
+Counts getThreadCounts();
+
+// Returns the allocations made by the calling thread in each phase
+PhaseCounts getThreadPhaseCounts();
+}  // namespace AllocationCounter
@@ -0,0 +1,87 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+
+#include "BlackjackGame.h"
+#include "Card.h"
+
+// Stores how often a true count occurs and the per-round result of a one unit
+// bet placed at that count
+struct TrueCountRow {
+  int trueCount;
+  double frequency;
+  double ev;
+  double variance;
+};
+
+// Stores the long-run figures for betting a ramp over a true count table
+struct BankrollSummary {
+  double evPerRound = 0.0;        // Units won per round
+  double variancePerRound = 0.0;  // Units squared per round
+  double averageBet = 0.0;        // Average initial bet in units
+  double riskOfRuin = 1.0;        // Probability of ever losing the bankroll
+  double n0 = 0.0;                // Rounds until EV equals one SD
+};
+
+// Stores the settings of a bankroll Monte Carlo run
+struct SessionConfig {
+  double bankroll = 1000.0;
+  long long roundsPerSession = 1000;
+  long long numSessions = 1000000;
+  int numCheckpoints = 10;
+  int threadCount = 1;
+  unsigned long long seed = 0;
+};
+
+class BankrollCalculator {
+ public:
+  // Entry point for the bankroll calculator
+  static int run(int argc, char* argv[]);
+
+ private:
+  // Reads a true count table CSV (as written by simulate --tc-output). Throws
+  // std::runtime_error if the file cannot be read or is malformed.
+  static std::vector<TrueCountRow> readTrueCountCSV(
+      const std::string& filename);
+
+  // Writes a true count table CSV
+  static int writeTrueCountCSV(const std::string& filename,
+                               const std::vector<TrueCountRow>& rows);
+
+  // Replaces the EV of each row with the exact EV of a round dealt from a
+  // shoe whose composition matches that true count
+  static void fillExactEVs(const BlackjackGame::GameRules& rules,
+                           std::vector<TrueCountRow>& rows, int decksRemaining,
+                           int threadCount);
+
+  // Builds a shoe of the given size with Hi-Lo running count
+  // trueCount * decksRemaining, by removing low or high cards evenly
+  static std::map<Card::Rank, int> compositionForTrueCount(int decksRemaining,
+                                                           int trueCount);
+
+  // Calculates the exact EV of a full round (every starting hand against
+  // every upcard, including dealer and player blackjacks) dealt from the
+  // given composition with optimal play
+  static double calculateRoundEV(const BlackjackGame& game,
+                                 const BlackjackGame::GameRules& rules,
+                                 const std::map<Card::Rank, int>& composition);
+
+  // Calculates EV, variance, risk of ruin and N0 for the bet at each row
+  static BankrollSummary summarize(const std::vector<TrueCountRow>& rows,
+                                   const std::vector<double>& bets,
+                                   double bankroll);
+
+  // Calculates the Kelly-optimal bet at each row (bet proportional to
+  // EV/variance), rounded to whole units within [minBet, maxBet]
+  static std::vector<double> kellyBets(const std::vector<TrueCountRow>& rows,
+                                       double bankroll, double kellyFraction,
+                                       double minBet, double maxBet);
+
+  // Plays many sessions with the bet at each row using a Monte Carlo and
+  // prints ruin probability and bankroll percentiles along the way
+  static int simulateSessions(const std::vector<TrueCountRow>& rows,
+                              const std::vector<double>& bets,
+                              const SessionConfig& config,
+                              const std::string& trajectoryFile);
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "AllocationCounter.h"
+#include "BlackjackGame.h"
+#include "Card.h"
+#include "HardwareCounters.h"
+
+// Stores one hand to solve in the benchmark
+struct BenchmarkMatchup {
+  std::vector<Card::Rank> playerRanks;
+  Card::Rank dealerUpcard;
+};
+
+// Stores the work and allocations of one benchmark thread
+struct BenchmarkThreadResult {
+  BlackjackGame::SearchStats stats;
+  AllocationCounter::PhaseCounts allocations;
+  HardwareCounters::Counts counters;
+  uint64_t mismatches = 0;  // Interleaved results that failed verification
+};
+
+class Benchmark {
+ public:
+  // Entry point for the benchmark
+  static int run(int argc, char* argv[]);
+
+ private:
+  // Gets the matchups of the strategy chart in chart order
+  static std::vector<BenchmarkMatchup> getChartMatchups();
+
+  // Solves rows of matchups (one player hand against several upcards)
+  // claimed from a shared index, clearing the memos between rows like the
+  // strategy generator does. With interleave > 0 each row is solved as one
+  // interleaved batch, and with verify each interleaved result is compared
+  // with a plain solve.
+  static void solveMatchups(
+      const BlackjackGame::GameRules& rules,
+      const std::vector<std::vector<BenchmarkMatchup>>& rows,
+      std::atomic<size_t>& nextRow, BlackjackGame::MemoStorage memoStorage,
+      int interleave, bool verify, bool hwCounters,
+      BenchmarkThreadResult& result);
+};
@@ -2,33 +2,51 @@
 #pragma once
 
 #include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <numeric>
 #include <random>
+#include <set>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
 #include "Card.h"
 #include "Deck.h"
+#include "FlatMemo.h"
 #include "Hand.h"
+#include "Interleaving.h"
+
+class DealerTable;
+class LayeredSolver;
 
 class BlackjackGame {
  public:
   enum class PlayerAction { Hit, Stand, Split, Double, Surrender, None };
   enum class SurrenderType { Early, Late, None };
 
-  // Stores the state of the game
+  // Card counts indexed by rank (Ace = 1 to King = 13, index 0 unused)
+  using RankCounts = std::array<int, 14>;
+
+  // Stores the state of the game. Holds no heap memory, so the search can
+  // copy it freely.
   struct GameState {
     Hand playerHand;
     Card dealerUpcard;
     Hand dealerHand;
 
-    std::map<Card::Rank, int> remainingCardCounts;
+    RankCounts remainingCardCounts;
     int totalCardsRemaining;
     int originalNumDecks;
     bool dealerChecked = true;
     bool wasSplit = false;
     int numPlayerHands = 1;
+    double reachProbability = 1.0;  // Probability of reaching this state
   };
 
   // Stores the rules of the game
@@ -52,6 +70,27 @@ class BlackjackGame {
     double prob_21 = 0.0;
     double prob_blackjack = 0.0;
     double prob_bust = 0.0;
+    // Probability mass replaced by an estimate in truncation mode
+    double truncatedMass = 0.0;
+  };
+
+  // Stores the second and third raw moments (E[X^2] and E[X^3]) of the net
+  // payout X of an action, NaN if they weren't calculated
+  struct PayoutMoments {
+    double second = std::numeric_limits<double>::quiet_NaN();
+    double third = std::numeric_limits<double>::quiet_NaN();
+
+    // Gets the variance and skewness of a payout with this mean
+    double getVariance(double mean) const { return second - mean * mean; }
+    double getSkewness(double mean) const {
+      double variance = getVariance(mean);
+      if (!(variance > 0.0)) {
+        return std::numeric_limits<double>::quiet_NaN();
+      }
+      double centralThird =
+          third - 3.0 * mean * second + 2.0 * mean * mean * mean;
+      return centralThird / (variance * std::sqrt(variance));
+    }
   };
 
   // Stores the expected value results for each player action
@@ -63,21 +102,130 @@ class BlackjackGame {
     double surrenderEV = 0.0;
     PlayerAction optimalAction;
     double optimalEV = 0.0;
+    // Upper bound on the error of every EV above (0 unless truncating)
+    double errorBound = 0.0;
+    // Payout moments of each action, only calculated with setPayoutMoments
+    PayoutMoments hitMoments;
+    PayoutMoments standMoments;
+    PayoutMoments splitMoments;
+    PayoutMoments doubleMoments;
+    PayoutMoments surrenderMoments;
+    PayoutMoments optimalMoments;
+  };
+
+  // Counts the work done by calculations, for reporting
+  struct SearchStats {
+    uint64_t playerNodes = 0;        // Player states expanded
+    uint64_t dealerNodes = 0;        // Dealer states expanded
+    uint64_t playerMemoLookups = 0;
+    uint64_t playerMemoHits = 0;
+    uint64_t dealerMemoLookups = 0;
+    uint64_t dealerMemoHits = 0;
+    uint64_t dealerTableHits = 0;    // Dealer lookups answered by the table
+    uint64_t standMemoLookups = 0;
+    uint64_t standMemoHits = 0;
+    uint64_t actionsPruned = 0;  // Actions skipped in decision-only mode
+    uint64_t memoValidations = 0;  // Memo hits solved again to validate
+    uint64_t memoMismatches = 0;   // Validated hits that disagreed
+    // Heap use during searches (only counted in allocation-counting builds)
+    uint64_t heapAllocations = 0;
+    uint64_t heapBytes = 0;
+
+    // Adds another accumulator's totals to this one
+    void merge(const SearchStats& other);
+  };
+
+  // Thrown when a calculation runs past the deadline set with setDeadline
+  class DeadlineExceeded : public std::runtime_error {
+   public:
+    using std::runtime_error::runtime_error;
   };
 
   // Constructor for a BlackjackGame instance with custom rules (defaults to
   // standard rules)
   BlackjackGame(const GameRules& rules);
 
-  // Clears the memoization caches
+  // Clears the memoization caches by releasing their arena in one step
   void clearMemos() const;
 
+  // Returns the number of entries in the memoization caches
+  size_t getMemoEntryCount() const;
+
+  // Sets the reach probability below which sub-trees are replaced by a cheap
+  // estimate (0 disables truncation). Each EV then carries an error bound.
+  void setEpsilon(double newEpsilon);
+
+  // Enables decision-only mode, where only the optimal action and its EV are
+  // exact: actions whose upper bound can't beat the best action so far are
+  // skipped (left as NaN). Clears the memoization caches.
+  void setDecisionsOnly(bool newDecisionsOnly);
+
+  // How memo entries are stored. Compact entries pack the dealer memo key,
+  // leave out the dealer bust probability (one minus the others) and keep
+  // only the optimal EV and action of a player state, which takes a third
+  // less memory; the state a query starts from is expanded again for its
+  // action EVs. Float also stores the dealer probabilities in single
+  // precision, halving the memory of the dealer memo. Each stored
+  // probability is then off by at most 2^-24 of itself, so a distribution
+  // by at most 2^-23 per card the dealer can still draw, and an EV (up to
+  // four times a stand EV, in a doubled split hand) by less than 1e-5.
+  // Clears the memoization caches. Throws std::runtime_error for a compact
+  // mode with more than 15 decks.
+  enum class MemoStorage { Full, Compact, Float };
+  void setMemoStorage(MemoStorage newMemoStorage);
+
+  // Enables calculating the second and third moments of the payout of each
+  // action along with its EV, in the same search and memos. Splits treat the
+  // two hands as independent, like their EV treats them as two copies of one
+  // hand. Moments need an exact search; truncated sub-trees leave them NaN.
+  // Clears the memoization caches when enabled.
+  void setPayoutMoments(bool newPayoutMoments);
+
+  // Enables a validation mode where every player memo hit is solved again
+  // and compared, checking that fields dropped from the memo key can't change
+  // the result. Mismatches are counted in the search stats.
+  void setValidateMemoKeys(bool newValidateMemoKeys);
+
+  // Answers dealer lookups from the upcard alone with a precomputed table
+  // where it covers the composition. Throws std::runtime_error if the table
+  // was built for a different shoe or soft 17 rule.
+  void setDealerTable(std::shared_ptr<const DealerTable> table);
+
+  // Returns the work counted since the last reset
+  const SearchStats& getSearchStats() const { return stats; }
+
+  // Resets the work counters
+  void resetSearchStats() { stats = SearchStats(); }
+
+  // Sets a time after which calculations throw DeadlineExceeded
+  void setDeadline(std::chrono::steady_clock::time_point newDeadline);
+
+  // Removes the deadline
+  void clearDeadline();
+
+  // Calculates the optimal strategy EV with truncation, starting at
+  // startEpsilon and tightening it tenfold after each pass until the deadline
+  // passes or a pass is exact. Returns the last completed pass and stores its
+  // epsilon in epsilonUsed. Throws DeadlineExceeded if no pass completes.
+  EVResult calculateEVBeforeDeadline(
+      const GameState& state, std::chrono::steady_clock::time_point deadline,
+      double startEpsilon, double& epsilonUsed);
+
   // Gets the a GameState object representing the current game state
   static GameState getGameStateForCalculation(
       const std::vector<Card::Rank>& player_ranks,
       const Card::Rank& dealer_upcard, const int num_decks,
       const bool dealerCheckedForBJ);
 
+  // Gets a GameState for the given hands dealt from a specific (possibly
+  // depleted) shoe composition instead of a full shoe. Throws
+  // std::runtime_error if the composition doesn't contain the cards.
+  static GameState getGameStateForComposition(
+      const std::vector<Card::Rank>& player_ranks,
+      const Card::Rank& dealer_upcard,
+      std::map<Card::Rank, int> remainingCardCounts, const int num_decks,
+      const bool dealerCheckedForBJ);
+
   // Calculates the expected value for hitting
   double calculateEVForHit(const GameState& state) const;
   // Calculates the expected value for standing
@@ -93,6 +241,13 @@ class BlackjackGame {
   // Calculates the expected value for all player actions and returns an
   // EVResult struct containing the optimal action and its EV
   EVResult calculateEVForOptimalStrategy(const GameState& state) const;
+  // Calculates the optimal strategy EV of several states, like calling
+  // calculateEVForOptimalStrategy on each. The dealer distributions the
+  // searches stand against are calculated first, up to `interleave` at a
+  // time on this thread, switching to another whenever one waits on a memo
+  // lookup. Only exact searches are interleaved; others run one by one.
+  std::vector<EVResult> calculateEVsInterleaved(
+      const std::vector<GameState>& states, int interleave) const;
 
   // Calculates the probabilities of dealer outcomes based on the current game
   DealerOutcomeProbabilities calcDealerOutcomeProbs(
@@ -101,7 +256,17 @@ class BlackjackGame {
   // Returns a string representation of dealer outcomes
   std::string getDealerOutcomesAsString(const GameState& state);
 
+  // Records the best legal action and its EV (and moments) in a result whose
+  // action EVs are filled in
+  static void chooseOptimalAction(EVResult& result);
+
+  // Compares results up to rounding, treating NaNs as equal
+  static bool isSameResult(const EVResult& a, const EVResult& b);
+
  private:
+  // Evaluates player states layer by layer with the helpers below
+  friend class LayeredSolver;
+
   int numDecks;
   bool dealerHitsSoft17;
   double blackjackPayout;
@@ -111,30 +276,284 @@ class BlackjackGame {
   bool canSplitAces;
   int maxSplits;
 
+  double epsilon = 0.0;  // Truncation threshold on reach probability
+  bool decisionsOnly = false;
+  bool validateMemoKeys = false;
+  MemoStorage memoStorage = MemoStorage::Full;
+  bool payoutMoments = false;
+  std::shared_ptr<const DealerTable> dealerTable;
+  mutable SearchStats stats;
+  bool hasDeadline = false;
+  std::chrono::steady_clock::time_point deadline;
+  mutable int deadlineCheckCounter = 0;
+  mutable int expandDepth = 0;  // Player states being expanded
+
   // remainingCardsCounts as array
   using DeckCounts = std::array<int, 10>;
 
-  // Dealer hand score, isSoft, remaining card counts
-  using DealerMemoKey = std::tuple<int, bool, DeckCounts>;
-  using DealerMemo = std::map<DealerMemoKey, DealerOutcomeProbabilities>;
+  // Dealer hand score, isSoft, hole card state (0 = two or more cards, 1 =
+  // upcard only, 2 = upcard only and checked for blackjack, 3 = blackjack),
+  // remaining card counts
+  using DealerMemoKey = std::tuple<int, bool, int, DeckCounts>;
+  struct DealerMemoKeyHash {
+    uint64_t operator()(const DealerMemoKey& key) const {
+      uint64_t hash = std::get<0>(key) * 4 + std::get<1>(key) * 2 +
+                      static_cast<uint64_t>(std::get<2>(key)) * 64;
+      for (int count : std::get<DeckCounts>(key)) {
+        hash = (hash ^ static_cast<uint64_t>(count)) * 0x100000001b3ULL;
+      }
+      // Mix the high bits into the low ones, which pick the index slot
+      hash ^= hash >> 33;
+      hash *= 0xff51afd7ed558ccdULL;
+      hash ^= hash >> 33;
+      return hash;
+    }
+  };
+  // Memo entries remember the truncation tolerance (epsilon / reach
+  // probability) they were calculated with and are only reused by queries
+  // that allow at least as much truncation
+  struct DealerMemoEntry {
+    DealerOutcomeProbabilities outcomes;
+    double tolerance;
+  };
+  using DealerMemo = FlatMemo<DealerMemoKey, DealerMemoEntry, DealerMemoKeyHash>;
 
-  // Player hand value, isSoft, canSplit, dealer upcard value, wasSplit,
-  // dealerChecked, numPlayerHands, remaining card counts
+  // Dealer memo key of the compact modes: the remaining counts, hand score
+  // and flags (isSoft, then the hole card state) in 12 bytes
+  struct CompactDealerMemoKey {
+    std::array<uint8_t, 10> counts;
+    uint8_t score;
+    uint8_t flags;
+    bool operator==(const CompactDealerMemoKey& other) const = default;
+  };
+  struct CompactDealerMemoKeyHash {
+    uint64_t operator()(const CompactDealerMemoKey& key) const {
+      uint64_t hash = key.score * 8 + key.flags;
+      for (uint8_t count : key.counts) {
+        hash = (hash ^ count) * 0x100000001b3ULL;
+      }
+      hash ^= hash >> 33;
+      hash *= 0xff51afd7ed558ccdULL;
+      hash ^= hash >> 33;
+      return hash;
+    }
+  };
+  // Dealer outcomes 17 to 21 and blackjack; bust is one minus their sum.
+  // A single-precision truncated mass is rounded up to stay a bound.
+  template <typename Probability>
+  struct CompactDealerMemoEntry {
+    std::array<Probability, 6> outcomes;
+    Probability truncatedMass;
+    double tolerance;
+  };
+  using CompactDealerMemo =
+      FlatMemo<CompactDealerMemoKey, CompactDealerMemoEntry<double>,
+               CompactDealerMemoKeyHash>;
+  using FloatDealerMemo =
+      FlatMemo<CompactDealerMemoKey, CompactDealerMemoEntry<float>,
+               CompactDealerMemoKeyHash>;
+
+  // Player hand value, isSoft, canSplit, isTwoCardHand, dealer upcard value,
+  // wasSplit, dealerChecked, numPlayerHands, remaining card counts. Fields
+  // that can't affect the sub-tree are canonicalized (see getPlayerMemoKey).
   using PlayerMemoKey =
-      std::tuple<int, bool, bool, int, bool, bool, int, DeckCounts>;
-  using PlayerMemo = std::map<PlayerMemoKey, EVResult>;
+      std::tuple<int, bool, bool, bool, int, bool, bool, int, DeckCounts>;
+  struct PlayerMemoEntry {
+    EVResult result;
+    double tolerance;
+  };
+  using PlayerMemo = std::pmr::map<PlayerMemoKey, PlayerMemoEntry>;
+  // Player entry of the compact modes, with what a parent state reads
+  struct CompactPlayerMemoEntry {
+    double optimalEV;
+    double errorBound;
+    double tolerance;
+    PlayerAction optimalAction;
+    PayoutMoments optimalMoments;
+  };
+  using CompactPlayerMemo =
+      std::pmr::map<PlayerMemoKey, CompactPlayerMemoEntry>;
 
-  mutable DealerMemo DealerMemo_;
-  mutable PlayerMemo PlayerMemo_;
+  // Stand EVs against one dealer distribution for a player total of 16 or
+  // less, 17 to 21 and a natural, keyed like the dealer memo
+  struct StandMemoEntry {
+    std::array<double, 7> standEVs;
+    // E[X^2] and E[X^3] of the same payouts X
+    std::array<double, 7> standSecondMoments;
+    std::array<double, 7> standThirdMoments;
+    double truncatedMass;  // Dealer mass replaced by an estimate
+    double tolerance;
+  };
+  using StandMemo = FlatMemo<DealerMemoKey, StandMemoEntry, DealerMemoKeyHash>;
+
+  // The memos and all their nodes live in a monotonic arena owned by this
+  // game (so by one thread). Clearing releases the arena instead of freeing
+  // each node; the memos are never destroyed, since every node is in the
+  // arena and their keys and entries hold no other memory. Only the dealer
+  // and player memos of the current storage mode are filled.
+  struct Memos {
+    DealerMemo dealer;
+    PlayerMemo player;
+    StandMemo stand;
+    CompactDealerMemo compactDealer;
+    FloatDealerMemo floatDealer;
+    CompactPlayerMemo compactPlayer;
+
+    explicit Memos(std::pmr::memory_resource* arena)
+        : dealer(arena),
+          player(arena),
+          stand(arena),
+          compactDealer(arena),
+          floatDealer(arena),
+          compactPlayer(arena) {}
+  };
+  // Size of the arena's first block
+  static constexpr size_t kMemoArenaInitialBytes = 1 << 20;
+  std::unique_ptr<std::pmr::monotonic_buffer_resource> memoArena;
+  mutable Memos* memos;
+  // Read-only dealer and stand memos of other games, searched after this
+  // game's own, with each key in the shard picked by getMemoShard (empty for
+  // none). Whoever sets them must keep them alive and unchanged while this
+  // game calculates.
+  std::vector<const Memos*> sharedMemos;
+  // Dealer distributions solved to validate memo hits, keyed by everything
+  // that decides them: the values of the dealer's cards, the remaining
+  // counts, the upcard value and whether the dealer checked. Kept apart from
+  // the memos so a faulty memo key can't reach it.
+  using ReferenceDealerKey = std::array<int, 22>;
+  mutable std::map<ReferenceDealerKey, DealerOutcomeProbabilities>
+      referenceDealerOutcomes;
+
+  // Helper function to create empty memos in the arena
+  Memos* createMemos() const;
 
   // Helper function to calculate the payout based on player and dealer scores
   double calculatePayout(int playerHandScore, int dealerHandScore,
                          bool isPlayerBlackjack, bool isDealerBlackjack,
                          bool isDoubledDown = false) const;
 
-  // Helper function to convert a map of card counts to DeckCounts array
-  DeckCounts convertMapToDeckCount(
-      const std::map<Card::Rank, int>& remainingCardCounts) const;
+  // Helper function to convert card counts by rank to a DeckCounts array
+  DeckCounts convertToDeckCounts(const RankCounts& remainingCardCounts) const;
+
+  // Helper function to convert a map of card counts to counts by rank
+  static RankCounts convertMapToRankCounts(
+      const std::map<Card::Rank, int>& remainingCardCounts);
+
+  // Helper function to get the shared memo shard holding a shoe's entries
+  static size_t getMemoShard(const DeckCounts& remainingCounts,
+                             size_t numShards) {
+    size_t hash = 0;
+    for (int count : remainingCounts) {
+      hash = hash * 31 + count;
+    }
+    return hash % numShards;
+  }
+
+  // Helper function to get the canonical player memo key of a state
+  PlayerMemoKey getPlayerMemoKey(const GameState& state) const;
+
+  // Helper function to solve a player state without reading its memo entry
+  EVResult expandPlayerState(const GameState& state) const;
+
+  // Helper function to check whether a hand can still be split
+  bool canSplitHand(const Hand& hand, int numPlayerHands) const;
+
+  // Helper function to get the dealer memo key of a state
+  DealerMemoKey getDealerMemoKey(const GameState& state,
+                                 const DeckCounts& remainingCounts) const;
+
+  // Helper function to get the hole card state of a dealer memo key from the
+  // dealer's card count and total
+  static int getHoleCardState(size_t cardCount, int total,
+                              bool checkedUnderTenOrAce);
+
+  // Helper function to get the stand EVs for every player total against the
+  // dealer hand and shoe of a state, calculating them on first use
+  const StandMemoEntry& getStandEVs(const GameState& state) const;
+
+  // Helper function to get the stand EVs for every player total against a
+  // dealer distribution
+  StandMemoEntry makeStandMemoEntry(
+      const DealerOutcomeProbabilities& outcomeProbs, double tolerance) const;
+
+  // Helper functions to read and write the memos of the current storage
+  // mode. A read finds entries good to a tolerance, in this game's memo or
+  // the shared ones; a write keeps whichever entry is more precise.
+  bool findDealerOutcomes(const DealerMemoKey& key, double tolerance,
+                          DealerOutcomeProbabilities& outcomes) const;
+  void storeDealerOutcomes(const DealerMemoKey& key,
+                           const DealerOutcomeProbabilities& outcomes,
+                           double tolerance) const;
+  bool findPlayerResult(const PlayerMemoKey& key, double tolerance,
+                        EVResult& result, double& entryTolerance) const;
+  void storePlayerResult(const PlayerMemoKey& key, const EVResult& result,
+                         double tolerance) const;
+  bool hasPlayerResult(const PlayerMemoKey& key) const;
+
+  // Helper functions to start loading the index slot, then the entry, that
+  // a dealer memo read will look at
+  void prefetchDealerSlot(const DealerMemoKey& key) const;
+  void prefetchDealerEntry(const DealerMemoKey& key) const;
+
+  // Helper functions to convert between full and compact memo entries
+  static CompactDealerMemoKey packDealerMemoKey(const DealerMemoKey& key);
+  template <typename Probability>
+  static CompactDealerMemoEntry<Probability> packDealerOutcomes(
+      const DealerOutcomeProbabilities& outcomes, double tolerance);
+  template <typename Probability>
+  static DealerOutcomeProbabilities unpackDealerOutcomes(
+      const CompactDealerMemoEntry<Probability>& entry);
+  static CompactPlayerMemoEntry packPlayerResult(const EVResult& result,
+                                                 double tolerance);
+  static EVResult unpackPlayerResult(const CompactPlayerMemoEntry& entry);
+
+  // Helper function to get the outcome of a dealer hand that stands or has
+  // busted. Returns false if the dealer draws again.
+  bool getFinalDealerOutcomes(const Hand& dealerHand,
+                              DealerOutcomeProbabilities& outcomes) const;
+
+  // Helper function to solve a dealer distribution without the memos, for
+  // validating memo hits
+  DealerOutcomeProbabilities solveDealerWithoutMemo(
+      const GameState& state) const;
+
+  // Helper function to round outcomes the way the dealer memo stores them,
+  // and get how far a stored probability can be from the unrounded one
+  DealerOutcomeProbabilities getStoredOutcomes(
+      const DealerOutcomeProbabilities& outcomes,
+      double& maxDifference) const;
+
+  // Helper functions to solve the dealer state of a dealer or stand memo hit
+  // again without memos and count a mismatch if the hit disagrees. Only
+  // exact searches are validated, since truncated entries may be reused by
+  // queries that allow more truncation.
+  void validateDealerHit(const GameState& state,
+                         const DealerOutcomeProbabilities& cached) const;
+  void validateStandHit(const GameState& state,
+                        const StandMemoEntry& cached) const;
+
+  // Helper function to add a distribution, scaled by a weight, to another
+  static void addWeightedOutcomes(
+      DealerOutcomeProbabilities& outcomes, double weight,
+      const DealerOutcomeProbabilities& subOutcomes);
+
+  // Helper function to collect one state for each stand lookup that a
+  // search from a state will make and the stand memo can't answer yet
+  void collectStandStates(const GameState& state,
+                          std::set<PlayerMemoKey>& visited,
+                          std::set<DealerMemoKey>& standKeys,
+                          std::vector<GameState>& standStates) const;
+
+  // Helper coroutine to calculate and memoize the stand EVs of a state.
+  // Returns whether they were added.
+  Interleaving::Task<bool> prepareStandEVs(GameState state) const;
+
+  // Helper coroutine to calculate the dealer outcomes of a state missing
+  // from the memo like calcDealerOutcomeProbs in exact mode. It prefetches
+  // the entries of all the cards the dealer can draw and yields while they
+  // load.
+  Interleaving::Task<DealerOutcomeProbabilities>
+  calcDealerOutcomeProbsInterleaved(GameState state, DealerMemoKey key) const;
 
   // Helper function to get a new GameState with a card dealt to the dealer
   GameState getGameStateMinusCardToDealer(const GameState& oldState,
@@ -148,6 +567,48 @@ class BlackjackGame {
   GameState getGameStateAfterSplit(const GameState& oldState,
                                    Card cardToKeep) const;
 
+  // Helper functions to calculate action EVs along with an upper bound on
+  // their error from truncated sub-trees, and the payout moments if asked
+  // for. Hit, split and double give up and return NaN once their EV
+  // provably can't exceed mustBeat.
+  static constexpr double kNoTarget = -std::numeric_limits<double>::infinity();
+  // Slack for rounding when comparing bounds against EVs
+  static constexpr double kPruneMargin = 1e-9;
+  double calculateEVForHit(const GameState& state, double& errorBound,
+                           double mustBeat = kNoTarget,
+                           PayoutMoments* moments = nullptr) const;
+  double calculateEVForStand(const GameState& state, double& errorBound,
+                             PayoutMoments* moments = nullptr) const;
+  double calculateEVForSplit(const GameState& state, double& errorBound,
+                             double mustBeat = kNoTarget,
+                             PayoutMoments* moments = nullptr) const;
+  double calculateEVForDouble(const GameState& state, double& errorBound,
+                              double mustBeat = kNoTarget,
+                              PayoutMoments* moments = nullptr) const;
+
+  // Helper function to get the largest EV any play of a hand can reach
+  double getMaxEV(const Hand& hand, int numPlayerHands) const;
+
+  // Helper function to get an upper bound on the EV of a hand after it is
+  // dealt a card, without expanding it
+  double getUpperBoundAfterCard(const GameState& state,
+                                Card::Rank rankToPlayer) const;
+
+  // Helper function to get the truncation tolerance of a state
+  double getTolerance(const GameState& state) const;
+
+  // Helper function to throw DeadlineExceeded once the deadline has passed
+  void checkDeadline() const;
+
+  // Helper function to estimate dealer outcomes by drawing from the current
+  // composition without removing cards
+  DealerOutcomeProbabilities estimateDealerOutcomeProbs(
+      const GameState& state) const;
+
+  // Helper function to estimate standing and hitting the same way, with an
+  // error bound that holds for any play from this state
+  EVResult estimateEVForOptimalStrategy(const GameState& state) const;
+
   // Helper function to get the possibility of drawing a specific card rank
   double getCardDrawProbability(const GameState& state, Card::Rank cardRank,
                                 bool cardForDealer = false) const;
@@ -0,0 +1,98 @@
+/* BlackjackLabC.h */
+#pragma once
+
+#include <stddef.h>
+
+/* C interface to the thread-safe Engine, for callers that can't use the C++
+ * API (other languages through an FFI, or C programs). An engine handle can
+ * be used from several threads at once. Functions that can fail return 0 on
+ * success and -1 on failure, with the reason in bjl_last_error(). */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct bjl_engine bjl_engine;
+
+typedef enum {
+  BJL_SURRENDER_NONE = 0,
+  BJL_SURRENDER_LATE = 1,
+  BJL_SURRENDER_EARLY = 2
+} bjl_surrender_type;
+
+typedef enum {
+  BJL_ACTION_HIT = 0,
+  BJL_ACTION_STAND = 1,
+  BJL_ACTION_SPLIT = 2,
+  BJL_ACTION_DOUBLE = 3,
+  BJL_ACTION_SURRENDER = 4,
+  BJL_ACTION_NONE = 5
+} bjl_action;
+
+/* Game rules; fill with bjl_rules_init for the defaults */
+typedef struct {
+  int num_decks;
+  int dealer_hits_soft17;
+  int can_double_after_split;
+  bjl_surrender_type surrender_type;
+  double blackjack_payout;
+  double insurance_payout;
+  int can_split_aces;
+  int max_splits;
+} bjl_rules;
+
+/* How the engine solves queries; fill with bjl_options_init for the
+ * defaults */
+typedef struct {
+  int thread_count;       /* Worker threads (0 for one per core) */
+  double epsilon;         /* Truncation threshold (0 for exact) */
+  int decisions_only;     /* Only the optimal action's EV is exact */
+  int dealer_table_cards; /* Cards covered by the dealer table (0 = none) */
+} bjl_options;
+
+/* A hand to solve. Ranks run from 1 (ace) to 13 (king). */
+typedef struct {
+  const int* player_ranks;
+  size_t num_player_cards;
+  int dealer_upcard;
+  int dealer_checked; /* Dealer has checked for blackjack */
+  /* Cards left in the shoe by rank (index 0 = ace), before the hands above
+   * are dealt; NULL for a full shoe */
+  const int* remaining_counts;
+} bjl_query;
+
+/* EVs of each action, in units of the initial bet */
+typedef struct {
+  double hit_ev;
+  double stand_ev;
+  double split_ev;
+  double double_ev;
+  double surrender_ev;
+  double optimal_ev;
+  double error_bound; /* Bound on the error of every EV (0 unless truncating) */
+  bjl_action optimal_action;
+} bjl_result;
+
+void bjl_rules_init(bjl_rules* rules);
+void bjl_options_init(bjl_options* options);
+
+/* Creates an engine, or returns NULL on failure */
+bjl_engine* bjl_engine_create(const bjl_rules* rules,
+                              const bjl_options* options);
+
+/* Waits for queries in progress and frees the engine */
+void bjl_engine_destroy(bjl_engine* engine);
+
+/* Solves one query */
+int bjl_engine_evaluate(bjl_engine* engine, const bjl_query* query,
+                        bjl_result* result);
+
+/* Solves count queries in parallel, writing results in the same order */
+int bjl_engine_evaluate_batch(bjl_engine* engine, const bjl_query* queries,
+                              size_t count, bjl_result* results);
+
+/* Returns the error from the calling thread's last failed call */
+const char* bjl_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
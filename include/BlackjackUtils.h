@@ -3,7 +3,9 @@
 #include <BlackjackGame.h>
 #include <Card.h>
 
+#include <map>
 #include <string>
+#include <vector>
 
 namespace BlackjackUtils {
 // Convert a string representation of a card rank to its enum value
@@ -18,6 +20,36 @@ std::string suitToString(Card::Suit suit);
 int stringToValue(const std::string& str);
 // Convert a PlayerAction enum value to its string representation
 std::string playerActionToString(BlackjackGame::PlayerAction action);
+// Convert a string representation of a player action to its enum value
+BlackjackGame::PlayerAction stringToPlayerAction(const std::string& str);
 // Convert a SurrenderType enum value to its string representation
 std::string surrenderTypeToString(BlackjackGame::SurrenderType type);
+// Parse '--key value' command-line arguments (starting after the command
+// name) into a map. Prints an error and returns false if a value is missing.
+bool parseArguments(int argc, char* argv[],
+                    std::map<std::string, std::string>& args);
+// Fill game rules from parsed arguments (--decks, --s17, --das, --surrender,
+// --blackjack-payout, --insurance-payout, --can-split-aces, --max-splits).
+// Prints an error and returns false if a value is invalid.
+bool parseGameRules(const std::map<std::string, std::string>& args,
+                    BlackjackGame::GameRules& rules);
+// Read '--threads' ('max'/'all' or a positive integer) from parsed arguments,
+// defaulting to the hardware thread count. Prints an error and returns false
+// if the value is invalid.
+bool parseThreadCount(const std::map<std::string, std::string>& args,
+                      int& threadCount);
+// Read '--memo-storage' ('full', 'compact' or 'float') from parsed
+// arguments, defaulting to full. Prints an error and returns false if the
+// value is invalid.
+bool parseMemoStorage(const std::map<std::string, std::string>& args,
+                      BlackjackGame::MemoStorage& memoStorage);
+// Parse a bet ramp: units bet at true count 1, 2, 3... separated by '/', or
+// 'flat' for a one unit bet. Throws std::invalid_argument or
+// std::out_of_range if the ramp is malformed.
+std::vector<double> parseBetRamp(const std::string& ramp);
+// Look up the bet for a true count in a bet ramp. Counts below 1 use the first
+// entry and counts past the end of the ramp use the last.
+double betForTrueCount(const std::vector<double>& betRamp, int trueCount);
+// Print the states expanded, memo hit rates and pruned actions of a search
+void printSearchStats(const BlackjackGame::SearchStats& stats);
 }  // namespace BlackjackUtils
\ No newline at end of file
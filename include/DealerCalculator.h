@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "BlackjackGame.h"
+
+class DealerCalculator {
+ public:
+  // Entry point for the dealer outcome calculator
+  static int run(int argc, char* argv[]);
+
+ private:
+  // Number of cards of each value in a shoe (A, 2-9, 10)
+  using ShoeCounts = std::array<int, 10>;
+
+  // Stores the dealer outcomes of one shoe for every upcard, soft 17 rule
+  // and hole card check, indexed by getResultIndex
+  struct ShoeResult {
+    std::array<BlackjackGame::DealerOutcomeProbabilities, 40> outcomes;
+    // Whether each row can happen: the shoe holds the upcard, and the dealer
+    // can finish (and pass the check) with the cards left
+    std::array<bool, 40> possible;
+  };
+
+  // Stores the two games (S17 and H17) a worker keeps between shoes. The
+  // upcards of a shoe share the dealer memo entries of their common hands.
+  struct WorkerGames {
+    std::unique_ptr<BlackjackGame> standsSoft17;
+    std::unique_ptr<BlackjackGame> hitsSoft17;
+  };
+
+  // Gets the index of an upcard value index (aces first), soft 17 rule and
+  // hole card check in a ShoeResult
+  static int getResultIndex(int upcardIndex, bool hitsSoft17,
+                            bool dealerChecked) {
+    return (upcardIndex * 2 + (hitsSoft17 ? 1 : 0)) * 2 +
+           (dealerChecked ? 1 : 0);
+  }
+
+  // Parses a shoe given as ten comma-separated card counts in the order A,
+  // 2-9, 10. Throws std::invalid_argument if it's malformed.
+  static ShoeCounts parseShoe(const std::string& text);
+
+  // Reads up to maxShoes shoes, one per line, skipping blank and '#' lines.
+  // Returns false at the end of the input. Throws std::invalid_argument
+  // with the line number if a line is malformed.
+  static bool readShoes(std::istream& input, size_t maxShoes,
+                        std::vector<ShoeCounts>& shoes, long long& lineNumber);
+
+  // Solves a batch of shoes, with the workers claiming blocks of
+  // neighbouring shoes
+  static void solveBatch(const std::vector<ShoeCounts>& shoes,
+                         std::vector<WorkerGames>& workers,
+                         std::vector<ShoeResult>& results);
+
+  // Solves every upcard, soft 17 rule and hole card check of one shoe
+  static void solveShoe(const ShoeCounts& shoe, WorkerGames& games,
+                        ShoeResult& result);
+
+  // Writes the results of a batch as CSV rows or JSON objects, numbering the
+  // shoes from firstShoe
+  static void writeResults(std::ostream& out, bool json,
+                           const std::vector<ShoeResult>& results,
+                           long long firstShoe, bool& firstObject);
+};
@@ -0,0 +1,79 @@
+// DealerTable.h
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "BlackjackGame.h"
+
+// Dealer outcome probabilities for every upcard, hole card check and shoe
+// composition within a few cards of a full shoe, stored in one contiguous
+// array. A composition is the multiset of cards removed from the shoe besides
+// the upcard, ranked with the combinatorial number system, so a lookup is a
+// short loop and an array index. The table is read-only once built and can
+// be shared by any number of threads.
+class DealerTable {
+ public:
+  using DealerOutcomeProbabilities = BlackjackGame::DealerOutcomeProbabilities;
+  // Number of cards of each value (2-9, 10, A)
+  using DeckCounts = std::array<int, 10>;
+
+  // Calculates the table for the given rules over every composition with up
+  // to maxRemovedCards cards removed besides the upcard
+  static DealerTable build(const BlackjackGame::GameRules& rules,
+                           int maxRemovedCards, int threadCount);
+
+  // Loads a table written by save. Throws std::runtime_error if the file
+  // cannot be read or was built for different rules.
+  static DealerTable load(const std::string& filename,
+                          const BlackjackGame::GameRules& rules);
+
+  // Writes the table to a binary file. Throws std::runtime_error if the file
+  // cannot be written.
+  void save(const std::string& filename) const;
+
+  // Returns the dealer outcomes for an upcard value (2-11) and the remaining
+  // shoe, or nullptr if more cards are gone than the table covers
+  const DealerOutcomeProbabilities* find(
+      int upcardValue, bool dealerChecked,
+      const DeckCounts& remainingCounts) const;
+
+  // Returns whether the table was calculated for a shoe and dealer rule
+  bool matches(int decks, bool hitsSoft17) const {
+    return decks == numDecks && hitsSoft17 == dealerHitsSoft17;
+  }
+
+  // Returns the most cards besides the upcard the table covers
+  int getMaxRemovedCards() const { return maxRemovedCards; }
+
+  // Returns the number of stored distributions
+  size_t getEntryCount() const { return entries.size(); }
+
+ private:
+  int numDecks;
+  bool dealerHitsSoft17;
+  int maxRemovedCards;
+  DeckCounts fullCounts;   // Cards of each value in a full shoe
+  size_t numCompositions;  // Compositions per upcard and check state
+  // binomial[n][k] for n up to maxRemovedCards + 10
+  std::vector<std::vector<size_t>> binomial;
+  std::vector<DealerOutcomeProbabilities> entries;
+
+  // Constructor for an empty table
+  DealerTable(int numDecks, bool dealerHitsSoft17, int maxRemovedCards);
+
+  // Helper function to get n choose k (0 when k > n)
+  size_t choose(int n, int k) const { return k > n ? 0 : binomial[n][k]; }
+
+  // Helper function to get the index of a removed-cards multiset. Smaller
+  // multisets come first.
+  size_t rankComposition(const DeckCounts& removedCounts,
+                         int numRemoved) const;
+
+  // Helper function to get the start of the entries for an upcard value
+  // index (0-9) and check state
+  size_t blockOffset(int upcardIndex, bool dealerChecked) const {
+    return (upcardIndex * 2 + (dealerChecked ? 1 : 0)) * numCompositions;
+  }
+};
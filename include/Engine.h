@@ -0,0 +1,86 @@
+// Engine.h
+#pragma once
+
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "BlackjackGame.h"
+#include "DealerTable.h"
+
+// Stores how the engine solves queries
+struct EngineOptions {
+  int threadCount = 0;         // Worker threads (0 for one per core)
+  double epsilon = 0.0;        // Truncation threshold (0 for exact)
+  bool decisionsOnly = false;  // Only the optimal action's EV is exact
+  int dealerTableCards = 0;    // Cards covered by the dealer table (0 = none)
+  size_t maxMemoEntries = 4000000;  // A worker's memos are cleared past this
+  // How memo entries are stored; compact entries take less memory each, so
+  // maxMemoEntries can be raised
+  BlackjackGame::MemoStorage memoStorage = BlackjackGame::MemoStorage::Full;
+  bool payoutMoments = false;  // Also calculate each action's payout moments
+};
+
+// Thread-safe front end to the exact engine, for programs that link the
+// BlackjackEngine library instead of running BlackjackLab. Any number of
+// threads can submit queries; they are solved by a pool of workers that each
+// own a BlackjackGame. Memo entries are keyed by the full shoe composition, so
+// each worker keeps its memos between queries, but the memos are private to
+// the worker: a repeated or related query only reuses work if the same worker
+// takes it. Only the optional dealer table is shared by all workers.
+class Engine {
+ public:
+  // Starts the workers, building the dealer table first if one was requested
+  explicit Engine(const BlackjackGame::GameRules& rules,
+                  const EngineOptions& options = EngineOptions());
+
+  // Finishes the queries already submitted and stops the workers
+  ~Engine();
+
+  Engine(const Engine&) = delete;
+  Engine& operator=(const Engine&) = delete;
+
+  // Solves one state and waits for the result. Rethrows the engine's
+  // std::runtime_error if the state can't be solved.
+  BlackjackGame::EVResult evaluate(const BlackjackGame::GameState& state);
+
+  // Solves several states in parallel and returns their results in order
+  std::vector<BlackjackGame::EVResult> evaluateBatch(
+      std::span<const BlackjackGame::GameState> states);
+
+  // Queues a state and returns a future for its result
+  std::future<BlackjackGame::EVResult> evaluateAsync(
+      const BlackjackGame::GameState& state);
+
+  // Returns the work done by all queries so far
+  BlackjackGame::SearchStats getSearchStats() const;
+
+  const BlackjackGame::GameRules& getRules() const { return rules; }
+
+ private:
+  // Stores a queued state and where its result goes
+  struct Job {
+    BlackjackGame::GameState state;
+    std::promise<BlackjackGame::EVResult> result;
+  };
+
+  // Solves queued jobs until the engine is destroyed
+  void runWorker();
+
+  const BlackjackGame::GameRules rules;
+  const EngineOptions options;
+  std::shared_ptr<const DealerTable> dealerTable;
+
+  mutable std::mutex mutex;  // Guards the fields below
+  std::condition_variable jobAvailable;
+  std::queue<Job> jobs;
+  bool stopping = false;
+  BlackjackGame::SearchStats stats;
+
+  std::vector<std::thread> workers;
+};
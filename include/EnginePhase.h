@@ -0,0 +1,31 @@
+// EnginePhase.h
+#pragma once
+
+// Tracks which part of the engine each thread is working on, so profiling
+// counters (hardware events, heap allocations) can be split by phase.
+// Markers are placed where the search switches between larger pieces of
+// work, and cost a thread-local write when no profiling is enabled.
+namespace EnginePhase {
+enum class Phase { PlayerRecursion, DealerDistribution, SplitEvaluation, Output };
+constexpr int kNumPhases = 4;
+
+// Returns the phase of the calling thread (player recursion by default)
+Phase current();
+
+// Returns the display name of a phase
+const char* name(Phase phase);
+
+// Puts the calling thread in a phase from its construction to its
+// destruction, then returns it to the previous phase
+class Scope {
+ public:
+  explicit Scope(Phase phase);
+  ~Scope();
+
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+ private:
+  Phase previousPhase;
+};
+}  // namespace EnginePhase
@@ -0,0 +1,183 @@
+// FlatMemo.h
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Hash map for the engine's memos, laid out so a lookup touches as few cache
+// lines as possible and can be prefetched. Entries are appended to blocks
+// that never move, and an open-addressing index of 8-byte slots (part of the
+// hash and an entry number) points at them, so a lookup reads one index line
+// and, unless the hash part rules it out, one entry. All memory comes from
+// the given resource and is only returned by releasing it: the memo is meant
+// for a monotonic arena, and entries can't be erased. Keys and values must
+// hold no memory of their own.
+template <typename Key, typename Value, typename Hash>
+class FlatMemo {
+ public:
+  using value_type = std::pair<const Key, Value>;
+
+  // Iterates over the entries in the order they were added
+  class const_iterator {
+   public:
+    const_iterator(const FlatMemo* memo, size_t index)
+        : memo(memo), index(index) {}
+    const value_type& operator*() const { return memo->entryAt(index); }
+    const value_type* operator->() const { return &memo->entryAt(index); }
+    const_iterator& operator++() {
+      ++index;
+      return *this;
+    }
+    bool operator==(const const_iterator& other) const {
+      return index == other.index;
+    }
+
+   private:
+    const FlatMemo* memo;
+    size_t index;
+  };
+
+  explicit FlatMemo(std::pmr::memory_resource* resource)
+      : resource(resource), blocks(resource) {}
+
+  FlatMemo(const FlatMemo&) = delete;
+  FlatMemo& operator=(const FlatMemo&) = delete;
+
+  // Returns the value stored for a key, or nullptr
+  const Value* find(const Key& key) const {
+    if (numEntries == 0) {
+      return nullptr;
+    }
+    uint64_t hash = Hash()(key);
+    for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+      uint64_t entry = index[slot];
+      if (entry == 0) {
+        return nullptr;
+      }
+      if (getTag(entry) == getTag(hash) &&
+          entryAt(getEntryNumber(entry)).first == key) {
+        return &entryAt(getEntryNumber(entry)).second;
+      }
+    }
+  }
+  Value* find(const Key& key) {
+    return const_cast<Value*>(std::as_const(*this).find(key));
+  }
+
+  // Adds an entry unless the key is already present. Returns the stored
+  // value and whether it was added.
+  std::pair<Value*, bool> try_emplace(const Key& key, const Value& value) {
+    static_assert(std::is_trivially_destructible_v<value_type>,
+                  "Memo entries are never destroyed");
+    if ((numEntries + 1) * 4 > capacity * 3) {
+      grow();
+    }
+    uint64_t hash = Hash()(key);
+    size_t slot = hash & mask;
+    for (; index[slot] != 0; slot = (slot + 1) & mask) {
+      uint64_t entry = index[slot];
+      if (getTag(entry) == getTag(hash) &&
+          entryAt(getEntryNumber(entry)).first == key) {
+        return {&entryAt(getEntryNumber(entry)).second, false};
+      }
+    }
+    if (numEntries % kBlockEntries == 0) {
+      blocks.push_back(static_cast<value_type*>(resource->allocate(
+          kBlockEntries * sizeof(value_type), alignof(value_type))));
+    }
+    value_type* stored = ::new (&blocks.back()[numEntries % kBlockEntries])
+        value_type(key, value);
+    index[slot] = makeSlot(hash, numEntries);
+    ++numEntries;
+    return {&stored->second, true};
+  }
+
+  // Returns the value stored for a key, adding a default one if needed
+  Value& operator[](const Key& key) { return *try_emplace(key, Value()).first; }
+
+  // Starts loading the index line a lookup of the key will read
+  void prefetch(const Key& key) const {
+    if (capacity > 0) {
+      __builtin_prefetch(&index[Hash()(key) & mask]);
+    }
+  }
+
+  // Starts loading the entry the key's index slot points at. Best called
+  // once the index line has arrived, after prefetch.
+  void prefetchEntry(const Key& key) const {
+    if (capacity > 0) {
+      uint64_t entry = index[Hash()(key) & mask];
+      if (entry != 0) {
+        __builtin_prefetch(&entryAt(getEntryNumber(entry)));
+      }
+    }
+  }
+
+  size_t size() const { return numEntries; }
+  bool empty() const { return numEntries == 0; }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, numEntries); }
+
+ private:
+  // Entries per block; a block is allocated when the last one fills up
+  static constexpr size_t kBlockEntries = 1024;
+  static constexpr size_t kInitialCapacity = 1024;
+
+  std::pmr::memory_resource* resource;
+  std::pmr::vector<value_type*> blocks;
+  // Slot: hash bits 32-63 above the entry number plus one (0 = empty)
+  uint64_t* index = nullptr;
+  size_t capacity = 0;  // Index slots, a power of two
+  size_t mask = 0;
+  size_t numEntries = 0;
+
+  const value_type& entryAt(size_t entryNumber) const {
+    return blocks[entryNumber / kBlockEntries][entryNumber % kBlockEntries];
+  }
+  value_type& entryAt(size_t entryNumber) {
+    return blocks[entryNumber / kBlockEntries][entryNumber % kBlockEntries];
+  }
+
+  static uint64_t getTag(uint64_t hashOrSlot) { return hashOrSlot >> 32; }
+  static size_t getEntryNumber(uint64_t slot) {
+    return (slot & 0xFFFFFFFF) - 1;
+  }
+  static uint64_t makeSlot(uint64_t hash, size_t entryNumber) {
+    return (hash & ~uint64_t{0xFFFFFFFF}) | (entryNumber + 1);
+  }
+
+  // Doubles the index and reinserts every entry
+  void grow() {
+    size_t newCapacity =
+        capacity == 0 ? kInitialCapacity : std::bit_ceil(capacity * 2);
+    uint64_t* newIndex = static_cast<uint64_t*>(
+        resource->allocate(newCapacity * sizeof(uint64_t), alignof(uint64_t)));
+    std::fill(newIndex, newIndex + newCapacity, 0);
+    size_t newMask = newCapacity - 1;
+    for (size_t i = 0; i < capacity; ++i) {
+      if (index[i] == 0) {
+        continue;
+      }
+      uint64_t hash = Hash()(entryAt(getEntryNumber(index[i])).first);
+      size_t slot = hash & newMask;
+      while (newIndex[slot] != 0) {
+        slot = (slot + 1) & newMask;
+      }
+      newIndex[slot] = index[i];
+    }
+    if (index) {
+      resource->deallocate(index, capacity * sizeof(uint64_t),
+                           alignof(uint64_t));
+    }
+    index = newIndex;
+    capacity = newCapacity;
+    mask = newMask;
+  }
+};
@@ -1,20 +1,25 @@
 // Hand.h
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <span>
 #include <string>
-#include <vector>
 
 #include "Card.h"
 
 class Hand {
  public:
+  // Most cards a hand can hold: 21 aces make 21, which can't be hit
+  static constexpr size_t kMaxCards = 21;
+
   // Constructor for a new Hand object
   Hand();
 
   // Get the list of cards in the hand
-  std::vector<Card> getCards() const { return cards; }
+  std::span<const Card> getCards() const { return {cards.data(), numCards}; }
 
-  // Add a card to the hand
+  // Add a card to the hand. Throws std::runtime_error if the hand is full.
   void addCard(const Card& card);
 
   // Calculate the total value of the hand
@@ -41,6 +46,8 @@ class Hand {
   std::string toString() const;
 
  private:
-  // Represents a hand of cards in a card game
-  std::vector<Card> cards;
+  // Represents a hand of cards in a card game. Stored inline so copying a
+  // hand never allocates.
+  std::array<Card, kMaxCards> cards;
+  size_t numCards = 0;
 };
\ No newline at end of file
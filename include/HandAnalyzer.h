@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "BlackjackGame.h"
+#include "Card.h"
+
+// Stores the lines of one shoe read from a hand-history log
+struct ShoeBlock {
+  long long shoeIndex = 0;
+  std::vector<std::pair<long long, std::string>> lines;  // Line number, text
+};
+
+// Stores the totals of analyzed decisions
+struct AnalysisStats {
+  long long shoes = 0;
+  long long rounds = 0;
+  long long decisions = 0;
+  long long mistakes = 0;       // Decisions that lost EV
+  long long invalidLines = 0;   // Lines skipped because they were malformed
+  double evLost = 0.0;          // Total EV given up against optimal play
+  double loggedResult = 0.0;    // Sum of the results recorded in the log
+  long long roundsWithResult = 0;
+
+  // Adds another accumulator's totals to this one
+  void merge(const AnalysisStats& other);
+};
+
+// Stores the result of analyzing one shoe
+struct ShoeAnalysis {
+  AnalysisStats stats;
+  std::string decisionRows;  // CSV rows for each decision, if requested
+  std::vector<std::string> errors;
+};
+
+class HandAnalyzer {
+ public:
+  // Entry point for the hand-history analyzer
+  static int run(int argc, char* argv[]);
+
+ private:
+  // Settings shared by every worker
+  struct AnalysisConfig {
+    BlackjackGame::GameRules rules;
+    bool writeDecisions = false;
+    size_t maxMemoEntries = 4000000;
+    bool printStats = false;    // Print search statistics at the end
+    bool validateMemo = false;  // Solve memo hits again and compare
+  };
+
+  // Reads shoes from the log one at a time so that workers can share it
+  class ShoeReader {
+   public:
+    explicit ShoeReader(std::istream& input) : input(input) {}
+
+    // Reads the next shoe into block. Returns false at the end of the log.
+    bool next(ShoeBlock& block);
+
+   private:
+    std::istream& input;
+    std::mutex mutex;
+    long long lineNumber = 0;
+    long long shoesRead = 0;
+    std::string pendingLine;  // 'shoe' line that started the next block
+    bool hasPendingLine = false;
+  };
+
+  // Analyzes the whole log across all threads and prints the results
+  static int analyze(std::istream& input, const AnalysisConfig& config,
+                     int threadCount, const std::string& outputFileName);
+
+  // Analyzes the rounds of one shoe, reusing the game's memos between
+  // decisions
+  static ShoeAnalysis analyzeShoe(const ShoeBlock& block,
+                                  const AnalysisConfig& config,
+                                  const BlackjackGame& game);
+
+  // Scores every decision of one round line and removes its cards from the
+  // shoe composition. Throws std::runtime_error if the line is malformed.
+  static void analyzeRound(const std::string& line, long long lineNumber,
+                           long long shoeIndex, const AnalysisConfig& config,
+                           const BlackjackGame& game,
+                           std::map<Card::Rank, int>& shoeCounts,
+                           ShoeAnalysis& analysis);
+
+  // Removes cards from the shoe composition. Throws std::runtime_error if the
+  // shoe doesn't hold them.
+  static void removeCards(const std::vector<Card::Rank>& cards,
+                          std::map<Card::Rank, int>& shoeCounts);
+};
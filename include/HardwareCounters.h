@@ -0,0 +1,51 @@
+// HardwareCounters.h
+#pragma once
+
+#include <array>
+#include <string>
+
+#include "EnginePhase.h"
+
+// Counts CPU events (cycles, instructions, cache, branch and TLB misses) for
+// each thread with perf_event_open and splits them between the engine phases
+// (see EnginePhase.h). Every phase change reads the counters. Where the
+// counters can't be opened (no PMU in a container or VM, or
+// perf_event_paranoid too strict) nothing is counted and the reason is
+// reported instead.
+namespace HardwareCounters {
+// Events counted in each phase
+enum class Event {
+  Cycles,
+  Instructions,
+  L1DMisses,
+  LLCMisses,
+  BranchMisses,
+  DTLBMisses
+};
+constexpr int kNumEvents = 6;
+
+// Stores the events counted by a thread in each phase
+struct Counts {
+  std::array<std::array<double, kNumEvents>, EnginePhase::kNumPhases> values =
+      {};
+  std::array<bool, kNumEvents> available = {};  // Events that could be opened
+
+  // Adds another thread's counts to this one
+  void merge(const Counts& other);
+};
+
+// Starts counting on the calling thread. Returns false and sets error if no
+// counter could be opened.
+bool startThread(std::string& error);
+
+// Stops counting on the calling thread and returns its counts
+Counts stopThread();
+
+// Charges the calling thread's events since the last call to its current
+// phase. Called on every phase change; does nothing unless the thread is
+// counting.
+void attributeToCurrentPhase();
+
+// Prints counts as a table with one row per phase
+void print(const std::string& title, const Counts& counts);
+}  // namespace HardwareCounters
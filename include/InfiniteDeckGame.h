@@ -0,0 +1,100 @@
+// InfiniteDeckGame.h
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "BlackjackGame.h"
+#include "Card.h"
+
+// EV engine for an infinite deck, where every card is drawn with a fixed
+// probability. The dealer's play becomes a small Markov chain over (total,
+// soft) states and the player's values are solved once per upcard by backward
+// induction, so a full chart takes microseconds. Follows the same game model
+// as BlackjackGame and returns the same result types.
+class InfiniteDeckGame {
+ public:
+  using EVResult = BlackjackGame::EVResult;
+  using DealerOutcomeProbabilities = BlackjackGame::DealerOutcomeProbabilities;
+  using PlayerAction = BlackjackGame::PlayerAction;
+
+  // Constructor: precomputes the dealer outcomes and player values for every
+  // upcard under the given rules (the deck count is ignored)
+  InfiniteDeckGame(const BlackjackGame::GameRules& rules);
+
+  // Calculates the expected value for all player actions and returns an
+  // EVResult struct containing the optimal action and its EV. Throws
+  // std::runtime_error if fewer than two player cards are given.
+  EVResult calculateEVForOptimalStrategy(
+      const std::vector<Card::Rank>& playerRanks, Card::Rank dealerUpcard,
+      bool dealerChecked) const;
+
+  // Returns the probabilities of the dealer's final totals for an upcard
+  const DealerOutcomeProbabilities& getDealerOutcomeProbs(
+      Card::Rank dealerUpcard, bool dealerChecked) const;
+
+ private:
+  // Hands are indexed by their total with Aces counted as 1 (up to 31) and
+  // whether they hold an Ace
+  static constexpr int kNumHandStates = 64;
+  // Dealer final totals 17-21 and bust
+  static constexpr int kNumDealerTotals = 6;
+
+  // Stores the values that depend on the dealer upcard and hole card check
+  struct UpcardTables {
+    DealerOutcomeProbabilities dealer;
+    std::array<double, kNumHandStates> standEV;    // Standing on each hand
+    std::array<double, kNumHandStates> hitEV;      // NaN once the hand is 21+
+    std::array<double, kNumHandStates> optimalEV;  // Best of hit and stand
+    bool canSurrender = false;
+  };
+
+  BlackjackGame::GameRules rules;
+
+  // Probability of drawing each rank, and each value (index 1 for an Ace)
+  static constexpr double kRankProbability = 1.0 / 13.0;
+  std::array<double, 11> valueProbabilities = {};
+
+  // Probability of each dealer hand moving to each other one with one card
+  std::array<std::array<double, kNumHandStates>, kNumHandStates>
+      dealerTransition = {};
+  // Probability of each dealer hand finishing on each final total
+  std::array<std::array<double, kNumDealerTotals>, kNumHandStates>
+      dealerAbsorption = {};
+
+  // Tables for each upcard (2-9, 10, A), checked or not
+  std::array<UpcardTables, 20> upcardTables;
+
+  // Helper functions to encode a hand and read its blackjack total
+  static int handIndex(int hardTotal, bool hasAce) {
+    return hardTotal * 2 + (hasAce ? 1 : 0);
+  }
+  static int handIndexAfterCard(int index, int cardValue);
+  static int handValue(int index);
+  static bool isSoftHand(int index);
+
+  // Helper function to get the tables for an upcard
+  const UpcardTables& getTables(Card::Rank dealerUpcard,
+                                bool dealerChecked) const;
+
+  // Helper function to check whether the dealer stops drawing on a hand
+  bool dealerStands(int index) const;
+
+  // Helper function to build the dealer transition matrix and solve it for
+  // the final total reached from every dealer hand
+  void solveDealerChain();
+
+  // Helper function to calculate the dealer outcomes from an upcard alone,
+  // ruling out a blackjack hole card once the dealer has checked
+  DealerOutcomeProbabilities calcDealerOutcomeProbs(int upcardValue,
+                                                    bool dealerChecked) const;
+
+  // Helper function to fill the player values against one upcard
+  void solvePlayerValues(UpcardTables& tables) const;
+
+  // Helper function to calculate every action for a two-card hand, recursing
+  // into the hands made by splitting
+  EVResult calculateEVForTwoCardHand(Card::Rank firstRank, Card::Rank secondRank,
+                                     const UpcardTables& tables, bool wasSplit,
+                                     int numPlayerHands) const;
+};
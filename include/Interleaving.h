@@ -0,0 +1,126 @@
+// Interleaving.h
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <utility>
+
+// Runs several independent searches on one thread, switching between them
+// whenever one is about to wait on memory. A search written as a chain of
+// Task coroutines prefetches the memo entry it needs next and co_awaits
+// Yield, which puts it at the back of the thread's Scheduler and resumes the
+// next search; by the time it comes around again the entry has usually
+// arrived. This is group prefetching without having to split the search
+// into stages by hand.
+namespace Interleaving {
+
+// Helper functions to reuse coroutine frames, which are allocated for every
+// call and would otherwise dominate the heap traffic of a search. Frames are
+// kept per thread and never returned to the system.
+void* allocateFrame(size_t bytes);
+void freeFrame(void* frame, size_t bytes);
+
+// Round-robin queue of the suspended searches of one thread
+class Scheduler {
+ public:
+  // Queues a coroutine to be resumed after the ones already queued
+  void schedule(std::coroutine_handle<> handle) { ready.push_back(handle); }
+
+  // Resumes the first queued coroutine. Returns false if none is queued.
+  bool resumeNext();
+
+  // Returns the scheduler the calling thread's searches yield to
+  static Scheduler*& current();
+
+ private:
+  std::deque<std::coroutine_handle<>> ready;
+};
+
+// Suspends the calling search and lets the others on the thread run
+struct Yield {
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> handle) const {
+    Scheduler::current()->schedule(handle);
+  }
+  void await_resume() const noexcept {}
+};
+
+// A lazily started coroutine returning a T. Awaiting it runs it until it
+// finishes, then continues the awaiting coroutine; a task that isn't awaited
+// by another is started with start() and finishes on its own.
+template <typename T>
+class Task {
+ public:
+  struct promise_type {
+    T value{};
+    std::exception_ptr exception;
+    std::coroutine_handle<> continuation;
+
+    Task get_return_object() {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    // Continues the awaiting coroutine directly, so a deep chain of tasks
+    // doesn't grow the stack
+    struct FinalAwaiter {
+      bool await_ready() noexcept { return false; }
+      std::coroutine_handle<> await_suspend(
+          std::coroutine_handle<promise_type> handle) noexcept {
+        std::coroutine_handle<> continuation = handle.promise().continuation;
+        return continuation ? continuation : std::noop_coroutine();
+      }
+      void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void return_value(T result) { value = std::move(result); }
+    void unhandled_exception() { exception = std::current_exception(); }
+
+    static void* operator new(size_t bytes) { return allocateFrame(bytes); }
+    static void operator delete(void* frame, size_t bytes) {
+      freeFrame(frame, bytes);
+    }
+  };
+
+  explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+  Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+  Task& operator=(Task&& other) noexcept {
+    std::swap(handle, other.handle);
+    return *this;
+  }
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+  ~Task() {
+    if (handle) {
+      handle.destroy();
+    }
+  }
+
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+    handle.promise().continuation = awaiting;
+    return handle;
+  }
+  T await_resume() {
+    if (handle.promise().exception) {
+      std::rethrow_exception(handle.promise().exception);
+    }
+    return std::move(handle.promise().value);
+  }
+
+  // Queues a task nothing awaits on the thread's scheduler
+  void start() { Scheduler::current()->schedule(handle); }
+
+  // Returns whether a started task has finished
+  bool done() const { return handle.done(); }
+
+  // Returns the result of a finished task, rethrowing its exception
+  T result() { return await_resume(); }
+
+ private:
+  std::coroutine_handle<promise_type> handle;
+};
+}  // namespace Interleaving
@@ -0,0 +1,113 @@
+// LayeredSolver.h
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "BlackjackGame.h"
+
+// Exact solver that evaluates the player states of one query a layer at a
+// time instead of by depth-first recursion. Every hit, double or split draw
+// takes one more card from the shoe, so the states reachable from a query
+// fall into layers by cards dealt. The solver enumerates the layers from the
+// query down, then evaluates them from the deepest up, splitting each layer
+// (a dense state array sorted by shoe composition) into one slice per worker
+// thread. A layer only reads the results of the layer below it, so the
+// threads never wait on each other within a layer and only two layers of
+// results are held at once. Each worker owns a BlackjackGame for the stand
+// EVs. States of different layers share most of their dealer sub-trees, so
+// between layers the workers move the dealer and stand entries they
+// calculated into sharded memos that all of them read during the next layer,
+// and a worker rarely repeats dealer work another has done. Memos are kept
+// between queries.
+class LayeredSolver {
+ public:
+  // Counts the states of the last query, for reporting
+  struct LayerStats {
+    int layers = 0;            // Layers below and including the query
+    uint64_t states = 0;       // Distinct player states in all layers
+    uint64_t widestLayer = 0;  // States in the largest layer
+  };
+
+  // Constructor for a solver with the given rules and worker threads
+  LayeredSolver(const BlackjackGame::GameRules& rules, int threadCount);
+
+  // Calculates the EV of every action for a state. Matches
+  // BlackjackGame::calculateEVForOptimalStrategy without truncation up to
+  // rounding in the last bits.
+  BlackjackGame::EVResult calculateEVForOptimalStrategy(
+      const BlackjackGame::GameState& state);
+
+  // Answers the workers' dealer lookups from a shared precomputed table
+  // where it covers the composition. Throws std::runtime_error if the table
+  // was built for a different shoe or soft 17 rule.
+  void setDealerTable(std::shared_ptr<const DealerTable> table);
+
+  // Returns the work done by all workers since the solver was created
+  BlackjackGame::SearchStats getSearchStats() const;
+
+  // Returns the layer sizes of the last query
+  const LayerStats& getLayerStats() const { return layerStats; }
+
+ private:
+  // Marks a draw that busts the hand or can't be taken
+  static constexpr int32_t kBust = -1;
+  static constexpr int32_t kNoChild = -2;
+
+  // Stores a player state and the index of the state each draw leads to in
+  // the next layer, for hitting (and doubling) and for playing a split hand
+  struct Node {
+    BlackjackGame::GameState state;
+    std::array<int32_t, 14> hitChildren;
+    std::array<int32_t, 14> splitChildren;
+  };
+  using Layer = std::vector<Node>;
+  using DealerEntry = BlackjackGame::DealerMemo::value_type;
+  using StandEntry = BlackjackGame::StandMemo::value_type;
+
+  // Fewest states worth giving a thread of its own
+  static constexpr size_t kMinSliceSize = 16;
+
+  // Memos are cleared before a query once they hold this many entries
+  static constexpr size_t kMaxMemoEntries = 4000000;
+
+  std::vector<BlackjackGame> workers;
+  // One shard of the shared memos per worker (none with a single worker,
+  // which keeps its own memos). Only used for their memos.
+  std::vector<BlackjackGame> memoShards;
+  LayerStats layerStats;
+
+  // Helper function to build the layers reachable from a state
+  std::vector<Layer> enumerateLayers(
+      const BlackjackGame::GameState& state) const;
+
+  // Helper function to sort a layer by shoe composition, updating the child
+  // indices of the layer above it
+  void sortByComposition(Layer& layer, Layer& parents) const;
+
+  // Helper function to evaluate a layer from the results of the layer below
+  // it, in parallel
+  std::vector<BlackjackGame::EVResult> evaluateLayer(
+      const Layer& layer,
+      const std::vector<BlackjackGame::EVResult>& childResults);
+
+  // Helper function to move the entries the workers calculated for the last
+  // layer into the shared memos, one shard per thread
+  void shareMemos();
+
+  // Helper function to clear every memo once they grow past kMaxMemoEntries
+  void limitMemos();
+
+  // Helper function to call work(i) for i below numThreads, each on its own
+  // thread unless there is only one, and rethrow the first exception
+  static void runInParallel(size_t numThreads,
+                            const std::function<void(size_t)>& work);
+
+  // Helper function to evaluate one state with a worker's game
+  static BlackjackGame::EVResult evaluateNode(
+      const BlackjackGame& game, const Node& node,
+      const std::vector<BlackjackGame::EVResult>& childResults);
+};
@@ -0,0 +1,94 @@
+// MulticardTable.h
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BlackjackGame.h"
+
+class DealerTable;
+
+// Composition-dependent strategy for player hands of three or more cards
+// against every upcard, for one shoe, dealer rule and hole card check. A hand
+// is stored once per multiset of card values (10s, jacks, queens and kings
+// are one value) under a 40-bit key of 4-bit counts. The entries of each
+// upcard and card count form a block sorted by key, so a lookup is a binary
+// search in one block. Files hold the same records packed into 14 bytes.
+class MulticardTable {
+ public:
+  using PlayerAction = BlackjackGame::PlayerAction;
+  // Number of cards of each value in a hand (A, 2-9, 10)
+  using HandCounts = std::array<int, 10>;
+
+  // Stores the solution of one hand
+  struct Entry {
+    uint64_t key;
+    float optimalEV;
+    float margin;  // Optimal EV minus the EV of the next best action
+    PlayerAction optimalAction;
+  };
+
+  // Most cards in a hand, so every count fits in 4 bits
+  static constexpr int kMaxCardsLimit = 15;
+
+  // Solves every hand of 3 to maxCards cards that can still act (a total of
+  // 20 or less) against each upcard. Each upcard is solved by one game that
+  // keeps its memos throughout: hands are solved from fewest cards up, so the
+  // hands with more cards are already in the memo from the hits of the
+  // smaller ones.
+  static MulticardTable build(const BlackjackGame::GameRules& rules,
+                              bool dealerChecked, int maxCards,
+                              int threadCount,
+                              BlackjackGame::MemoStorage memoStorage,
+                              std::shared_ptr<const DealerTable> dealerTable);
+
+  // Loads a table written by save. Throws std::runtime_error if the file
+  // cannot be read.
+  static MulticardTable load(const std::string& filename);
+
+  // Writes the table to a binary file. Throws std::runtime_error if the file
+  // cannot be written.
+  void save(const std::string& filename) const;
+
+  // Returns the entry of a hand against an upcard value (2-11), or nullptr
+  // if the table doesn't cover the hand
+  const Entry* find(int upcardValue, const HandCounts& counts) const;
+
+  // Returns whether the table was solved for a shoe, dealer rule and check
+  bool matches(int decks, bool hitsSoft17, bool checked) const {
+    return decks == numDecks && hitsSoft17 == dealerHitsSoft17 &&
+           checked == dealerChecked;
+  }
+
+  // Returns the most cards in a stored hand
+  int getMaxCards() const { return maxCards; }
+
+  // Returns the number of stored hands, in total or with a card count
+  size_t getEntryCount() const { return entries.size(); }
+  size_t getEntryCount(int cardCount) const;
+
+ private:
+  int numDecks;
+  bool dealerHitsSoft17;
+  bool dealerChecked;
+  int maxCards;
+  std::vector<Entry> entries;
+  // Start of each block of entries, plus the end of the last one
+  std::vector<uint64_t> blockStarts;
+
+  // Constructor for an empty table
+  MulticardTable(int numDecks, bool dealerHitsSoft17, bool dealerChecked,
+                 int maxCards);
+
+  // Helper function to get the block of an upcard value index (0-9, aces
+  // first) and card count
+  size_t blockIndex(int upcardIndex, int cardCount) const {
+    return upcardIndex * (maxCards - 2) + (cardCount - 3);
+  }
+
+  // Helper function to pack the counts of a hand into its key
+  static uint64_t packKey(const HandCounts& counts);
+};
@@ -0,0 +1,56 @@
+// Rng.h
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Fast xoshiro256** pseudo-random number generator. Much cheaper than
+// std::mt19937 and supports splitting into independent streams with jump(),
+// which is how each simulation thread gets its own sequence.
+class Rng {
+ public:
+  // Constructor: seeds the 256-bit state from a single 64-bit seed
+  explicit Rng(uint64_t seed = 0x9E3779B97F4A7C15ULL);
+
+  // Returns an Rng for the given stream index: the seeded state advanced by
+  // streamIndex jumps of 2^128 steps, so streams never overlap
+  static Rng forStream(uint64_t seed, int streamIndex);
+
+  // Returns the next 64 random bits
+  uint64_t next() {
+    const uint64_t result = rotl(state[1] * 5, 7) * 9;
+    const uint64_t t = state[1] << 17;
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = rotl(state[3], 45);
+    return result;
+  }
+
+  // Returns a uniformly distributed integer in [0, bound) (Lemire's method)
+  uint32_t nextBelow(uint32_t bound) {
+    uint64_t product = (next() >> 32) * bound;
+    uint32_t low = static_cast<uint32_t>(product);
+    if (low < bound) {
+      uint32_t threshold = -bound % bound;
+      while (low < threshold) {
+        product = (next() >> 32) * bound;
+        low = static_cast<uint32_t>(product);
+      }
+    }
+    return static_cast<uint32_t>(product >> 32);
+  }
+
+  // Returns a uniformly distributed double in [0, 1)
+  double nextDouble() { return (next() >> 11) * 0x1.0p-53; }
+
+  // Advances the state by 2^128 steps
+  void jump();
+
+ private:
+  std::array<uint64_t, 4> state;
+
+  static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+};
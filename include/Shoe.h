@@ -0,0 +1,70 @@
+// Shoe.h
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "Card.h"
+#include "Rng.h"
+
+// Compact shoe for simulation. Where Deck keeps full Card objects and a
+// per-rank map, the Shoe stores each card as a single byte holding its
+// blackjack value (1 = Ace, 2-9, 10 = any ten-valued card) so that dealing is
+// an index increment and shuffling touches a few hundred bytes. The shoe also
+// keeps the Hi-Lo running count of the cards dealt since the last shuffle.
+class Shoe {
+ public:
+  static constexpr int kMaxDecks = 8;
+  static constexpr int kMaxCards = kMaxDecks * 52;
+  static constexpr uint8_t kAce = 1;
+
+  // Constructor: Takes number of decks and the fraction of the shoe dealt
+  // before the cut card comes out
+  Shoe(int numDecks = 6, double penetration = 0.75);
+
+  // Converts a card rank to its 8-bit shoe encoding
+  static uint8_t encode(Card::Rank rank);
+
+  // Shuffles the full shoe and moves the cut card back into place
+  void shuffle(Rng& rng);
+
+  // Deals the next card. The cut card only stops play between rounds, so this
+  // keeps dealing past it; it only reshuffles if the shoe is truly empty.
+  uint8_t dealCard(Rng& rng) {
+    if (nextCard == numCards) {
+      shuffle(rng);
+    }
+    uint8_t card = cards[nextCard++];
+    runningCount += kHiLoTags[card];
+    return card;
+  }
+
+  // Checks if the cut card has been reached
+  bool isCutCardReached() const { return nextCard >= cutCard; }
+
+  // Returns number of cards dealt since the last shuffle
+  int getCardsDealt() const { return nextCard; }
+
+  // Returns number of undealt cards remaining in the shoe
+  int getRemainingCardsCount() const { return numCards - nextCard; }
+
+  // Returns the Hi-Lo running count of the cards dealt since the last shuffle
+  int getRunningCount() const { return runningCount; }
+
+  // Returns the Hi-Lo true count (running count per deck remaining), floored
+  int getTrueCount() const;
+
+  // Returns the number of decks the shoe was built with
+  int getNumDecks() const { return numDecks; }
+
+ private:
+  std::array<uint8_t, kMaxCards> cards;  // Encoded cards in deal order
+  int numDecks;                          // Number of decks in the shoe
+  int numCards;                          // Total cards in the shoe
+  int nextCard = 0;                      // Index of the next card to deal
+  int cutCard;                           // Index of the cut card
+  int runningCount = 0;                  // Hi-Lo running count
+
+  // Hi-Lo tag for each encoded card value (index 0 unused)
+  static constexpr int kHiLoTags[11] = {0, -1, 1, 1, 1, 1, 1, 0, 0, 0, -1};
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "BlackjackGame.h"
+#include "BlackjackUtils.h"
+#include "Rng.h"
+#include "Shoe.h"
+#include "StrategyTable.h"
+
+// Maximum number of seats at a simulated table
+constexpr int kMaxSeats = 7;
+
+// True counts tracked per seat; counts outside the range go to the end bins
+constexpr int kMinTrackedTrueCount = -10;
+constexpr int kMaxTrackedTrueCount = 10;
+constexpr int kNumTrueCountBins =
+    kMaxTrackedTrueCount - kMinTrackedTrueCount + 1;
+
+// Totals for the rounds played at one true count, per unit of initial bet
+struct TrueCountStats {
+  uint64_t rounds = 0;
+  double totalNet = 0.0;
+  double totalNetSquared = 0.0;
+};
+
+// Stores one seat's playing strategy and bet ramp
+struct SeatConfig {
+  StrategyTable strategy;
+  // Bet in units by Hi-Lo true count: entry i is the bet at true count i + 1,
+  // counts below 1 use the first entry and counts past the end use the last
+  std::vector<double> betRamp = {1.0};
+
+  // Returns the bet for the given true count
+  double betForTrueCount(int trueCount) const {
+    return BlackjackUtils::betForTrueCount(betRamp, trueCount);
+  }
+};
+
+// Per-seat totals for simulated rounds
+struct SeatStats {
+  uint64_t handsPlayed = 0;
+  uint64_t blackjacks = 0;
+  uint64_t doubles = 0;
+  uint64_t splits = 0;
+  uint64_t surrenders = 0;
+  double totalInitialBet = 0.0;
+  double totalWagered = 0.0;
+  double totalNet = 0.0;
+  double totalNetSquared = 0.0;
+  // Results per unit bet by the true count the bet was placed at
+  std::array<TrueCountStats, kNumTrueCountBins> byTrueCount;
+
+  // Adds another accumulator's totals to this one
+  void merge(const SeatStats& other);
+};
+
+// Per-thread accumulator for simulated rounds. Each worker owns one (padded
+// to a cache line so workers never share one) and they are merged at the end.
+struct alignas(64) SimulationStats {
+  uint64_t rounds = 0;
+  uint64_t shuffles = 0;
+  uint64_t cardsDealt = 0;
+  double cardsDealtSquared = 0.0;
+  std::array<SeatStats, kMaxSeats> seats;
+
+  // Adds another accumulator's totals to this one
+  void merge(const SimulationStats& other);
+};
+
+// Stores the settings of a simulation run
+struct SimulationConfig {
+  BlackjackGame::GameRules rules;
+  std::vector<SeatConfig> seats;
+  bool countsCards = false;  // Whether the true count is needed each round
+  std::string trueCountOutput;  // Per-true-count CSV for seat 1, if wanted
+  double penetration = 0.75;
+  uint64_t numRounds = 10000000;
+  int threadCount = 1;
+  uint64_t seed = 0;
+};
+
+class Simulator {
+ public:
+  // Entry point for the simulator
+  static int run(int argc, char* argv[]);
+
+ private:
+  // Plays the configured number of rounds across all threads and prints the
+  // results
+  static int simulate(const SimulationConfig& config);
+
+  // Writes seat 1's per-true-count frequency, EV and variance to a CSV file
+  // that the bankroll command can read
+  static int writeTrueCountCSV(const std::string& filename,
+                               const SimulationStats& totals,
+                               const SimulationConfig& config);
+
+  // Plays a share of the rounds on one thread with its own shoe and RNG
+  // stream
+  static void simulateChunk(const SimulationConfig& config, int streamIndex,
+                            uint64_t numRounds, SimulationStats& stats,
+                            std::atomic<uint64_t>& roundsCompleted);
+
+  // Plays a single round for every seat from the shared shoe, adding each
+  // seat's result to the stats
+  static void playRound(const SimulationConfig& config, Shoe& shoe, Rng& rng,
+                        SimulationStats& stats);
+};
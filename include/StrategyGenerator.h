@@ -1,5 +1,8 @@
 #pragma once
+#include <limits>
+#include <memory>
 #include <mutex>
+#include <ostream>
 #include <queue>
 #include <string>
 #include <thread>
@@ -7,6 +10,8 @@
 #include <vector>
 
 #include "BlackjackGame.h"
+#include "DealerTable.h"
+#include "HardwareCounters.h"
 
 // Stores the result of a strategy calculation
 struct StrategyResult {
@@ -14,6 +19,46 @@ struct StrategyResult {
   std::string dealerUpcard;
   BlackjackGame::PlayerAction optimalAction;
   double expectedValue;
+  double errorBound = 0.0;
+  // Of the optimal action's payout, NaN unless moments were calculated
+  double variance = std::numeric_limits<double>::quiet_NaN();
+  double skewness = std::numeric_limits<double>::quiet_NaN();
+};
+
+// Stores a row of the chart to solve: a player hand and the dealer upcards
+// still to solve against it, each with its task index
+struct StrategyRow {
+  std::string playerHand;
+  std::vector<std::pair<std::string, int>> upcards;
+};
+
+// Stores a row of the composition-weighted chart: the two-card holdings
+// counted in it, as indices into the holdings being solved
+struct CompositionRow {
+  std::string chartRow;  // Chart label, e.g. "16" (empty if not charted)
+  std::vector<int> holdings;
+};
+
+// Stores how the strategy chart is calculated
+struct StrategyOptions {
+  double epsilon = 0.0;        // Truncation threshold (0 for exact)
+  bool decisionsOnly = false;  // Skip actions that can't be optimal
+  bool payoutMoments = false;  // Add the variance and skewness of each cell
+  bool compositions = false;   // Weight every holding of each hard total
+  bool multicard = false;      // Solve the hands of three or more cards
+  int maxCards = 5;            // Most cards in a multi-card hand
+  // How memo entries are stored
+  BlackjackGame::MemoStorage memoStorage = BlackjackGame::MemoStorage::Full;
+  bool printStats = false;     // Print search statistics at the end
+  bool infiniteDeck = false;   // Use the fixed-probability engine
+  bool validateMemo = false;   // Solve memo hits again and compare
+  bool hwCounters = false;     // Count CPU events for each engine phase
+  int dealerTableCards = 0;    // Cards covered by the dealer table (0 = none)
+  std::string dealerTableFile;  // Where the dealer table is loaded or saved
+  std::string traceFile;        // Chrome trace output (empty for none)
+  int shardIndex = 0;  // Shard to solve, from 1 to shardCount
+  int shardCount = 0;  // Number of shards (0 to solve the whole chart)
+  bool resume = false;  // Continue from the journal of an unfinished run
 };
 
 class StrategyGenerator {
@@ -22,20 +67,88 @@ class StrategyGenerator {
   static int run(int argc, char* argv[]);
 
  private:
+  // Combines shard files written with --shard into one strategy chart
+  static int runMerge(int argc, char* argv[]);
+
   // Generates a strategy based on the given game rules
   static int generateStrategy(const BlackjackGame::GameRules& rules,
                               const std::string& outputFileName,
-                              int threadCount);
+                              int threadCount, const StrategyOptions& options);
 
-  // Calculates the optimal strategy for a chunk of hands
+  // Calculates the optimal strategy for rows of the chart taken from the
+  // queue, appending each result to the journal
   static void calculateChunk(
-      const BlackjackGame::GameRules& rules,
-      std::queue<std::tuple<std::string, std::string, int>>& workQueue,
-      std::vector<StrategyResult>& results, std::mutex& workQueueMutex,
-      std::atomic<int>& tasksCompleted);
+      const BlackjackGame::GameRules& rules, const StrategyOptions& options,
+      std::queue<StrategyRow>& workQueue, std::vector<StrategyResult>& results,
+      std::ostream& journal, std::mutex& workQueueMutex,
+      std::atomic<int>& tasksCompleted, BlackjackGame::SearchStats& stats,
+      std::shared_ptr<const DealerTable> dealerTable);
+
+  // Generates the chart with every two-card holding solved, each hard total
+  // playing the action that is best over its holdings weighted by how likely
+  // they are, and reports the holdings that play differently
+  static int generateCompositionStrategy(const BlackjackGame::GameRules& rules,
+                                         const std::string& outputFileName,
+                                         int threadCount,
+                                         const StrategyOptions& options);
 
-  // Writes the strategy results to a CSV file
+  // Solves every multi-card hand against each upcard and writes the table
+  static int generateMulticardTable(const BlackjackGame::GameRules& rules,
+                                    const std::string& outputFileName,
+                                    int threadCount,
+                                    const StrategyOptions& options);
+
+  // Solves rows of holdings taken from the queue against every upcard,
+  // storing the full result of each holding and upcard
+  static void calculateCompositionChunk(
+      const BlackjackGame::GameRules& rules, const StrategyOptions& options,
+      const std::vector<std::string>& holdings,
+      const std::vector<std::string>& dealerUpcards,
+      std::queue<std::vector<int>>& workQueue,
+      std::vector<BlackjackGame::EVResult>& results, std::mutex& workQueueMutex,
+      std::atomic<int>& tasksCompleted, BlackjackGame::SearchStats& stats,
+      std::shared_ptr<const DealerTable> dealerTable);
+
+  // Gets the probability of being dealt a holding (card values, aces as 11)
+  // from a full shoe once the upcard is showing, given no dealer blackjack
+  // if the dealer has checked
+  static double getHoldingWeight(int firstValue, int secondValue,
+                                 int upcardValue, int numDecks,
+                                 bool dealerChecked);
+
+  // Estimates the relative time to solve a hand against an upcard, used to
+  // order the work queue and give each shard an equal share of the work
+  static double estimateTaskCost(const std::string& playerHand,
+                                 const std::string& dealerUpcard,
+                                 const BlackjackGame::GameRules& rules);
+
+  // Splits the rows between shards, most expensive first, each going to the
+  // shard with the least estimated work so far. Returns the shard (0-based)
+  // of each row.
+  static std::vector<int> assignShards(const std::vector<double>& rowCosts,
+                                       int shardCount);
+
+  // Loads the dealer table from its file, or builds it (and saves it if a
+  // file was given). Returns nullptr if no table was requested.
+  static std::shared_ptr<const DealerTable> getDealerTable(
+      const BlackjackGame::GameRules& rules, const StrategyOptions& options,
+      int threadCount);
+
+  // Gets the comment lines describing the rules at the top of the CSV files
+  static std::string getRulesHeader(const BlackjackGame::GameRules& rules,
+                                    const StrategyOptions& options);
+
+  // Writes the strategy results to a CSV file, adding the largest error bound
+  // to the header and the variance and skewness columns if requested
   static int writeToCSV(const std::string& filename,
+                        const std::string& rulesHeader,
                         const std::vector<StrategyResult>& results,
-                        const BlackjackGame::GameRules& rules);
+                        bool writeErrorBound, bool writeMoments);
+
+  // Writes the results of one shard's tasks for 'strategy merge'
+  static int writeShardFile(const std::string& filename,
+                            const std::string& rulesHeader,
+                            const std::vector<StrategyResult>& results,
+                            const std::vector<int>& taskIndices,
+                            const StrategyOptions& options);
 };
\ No newline at end of file
@@ -0,0 +1,58 @@
+// StrategyTable.h
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "BlackjackGame.h"
+
+// Total-dependent playing strategy in the same shape as the strategy chart
+// CSV (hard totals, soft totals and pairs vs each dealer upcard), stored as
+// flat arrays so a simulated decision is a single lookup.
+class StrategyTable {
+ public:
+  using PlayerAction = BlackjackGame::PlayerAction;
+
+  // Constructor: every cell defaults to standing
+  StrategyTable();
+
+  // Returns the built-in multi-deck basic strategy (dealer hits soft 17,
+  // double after split, late surrender)
+  static StrategyTable basic();
+
+  // Loads a strategy chart CSV written by the strategy command. Throws
+  // std::runtime_error if the file cannot be read or a row is malformed.
+  static StrategyTable fromCSV(const std::string& filename);
+
+  // Sets the action for a chart cell using the chart's labels (e.g. "16",
+  // "A,7" or "8,8" vs "10" or "A")
+  void set(const std::string& playerHand, const std::string& dealerUpcard,
+           PlayerAction action);
+
+  // Returns the charted action for a hard or soft total vs an upcard value
+  // (1 or 11 = Ace, 2-10)
+  PlayerAction totalAction(int total, bool isSoft, int upcardValue) const {
+    return static_cast<PlayerAction>(
+        isSoft ? soft[total][upcardIndex(upcardValue)]
+               : hard[total][upcardIndex(upcardValue)]);
+  }
+
+  // Returns the charted action for a pair of the given card value
+  PlayerAction pairAction(int cardValue, int upcardValue) const {
+    return static_cast<PlayerAction>(
+        pairs[upcardIndex(cardValue)][upcardIndex(upcardValue)]);
+  }
+
+ private:
+  // Rows are indexed by total (0-21), columns by upcard (2-9, 10, A)
+  std::array<std::array<uint8_t, 10>, 22> hard;
+  std::array<std::array<uint8_t, 10>, 22> soft;
+  // Rows are indexed by pair card (2-9, 10, A)
+  std::array<std::array<uint8_t, 10>, 10> pairs;
+
+  // Maps a card value (1 or 11 = Ace) to its column index
+  static int upcardIndex(int value) {
+    return (value == 1 || value == 11) ? 9 : value - 2;
+  }
+};
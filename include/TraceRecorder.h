@@ -0,0 +1,43 @@
+// TraceRecorder.h
+#pragma once
+
+#include <chrono>
+#include <string>
+
+// Records timed spans from any number of threads and writes them as a Chrome
+// trace event file, which Perfetto (ui.perfetto.dev) and chrome://tracing
+// can open. Each thread appends to its own buffer without locking, so
+// recording costs a clock read and a vector append; nothing is recorded
+// until start() is called.
+namespace TraceRecorder {
+// Starts recording. Timestamps in the file are relative to this call.
+void start();
+
+// Returns whether spans are being recorded
+bool isEnabled();
+
+// Names the calling thread in the trace
+void setThreadName(const std::string& name);
+
+// Writes every recorded span to a JSON file. Call once the recording threads
+// have finished. Throws std::runtime_error if the file cannot be written.
+void write(const std::string& filename);
+
+// Records the time from its construction to its destruction as a span on the
+// calling thread. The name and category must be string literals.
+class Span {
+ public:
+  Span(const char* name, const char* category, std::string label = "");
+  ~Span();
+
+  Span(const Span&) = delete;
+  Span& operator=(const Span&) = delete;
+
+ private:
+  bool enabled;
+  const char* name;
+  const char* category;
+  std::string label;
+  std::chrono::steady_clock::time_point startTime;
+};
+}  // namespace TraceRecorder
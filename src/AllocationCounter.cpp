@@ -0,0 +1,100 @@
+// AllocationCounter.cpp
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+// Constant-initialized, so reading it from operator new never allocates
+thread_local AllocationCounter::PhaseCounts threadCounts;
+
+#ifdef BLACKJACKLAB_COUNT_ALLOCATIONS
+// Counts an allocation against the thread's current phase
+void count(std::size_t size) {
+  AllocationCounter::Counts& counts =
+      threadCounts[static_cast<int>(EnginePhase::current())];
+  counts.allocations++;
+  counts.bytes += size;
+}
+
+// Counts an allocation and takes it from malloc
+void* countedAllocate(std::size_t size) {
+  count(size);
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+// Counts an over-aligned allocation, such as a pmr arena block
+void* countedAllocate(std::size_t size, std::align_val_t alignment) {
+  count(size);
+  size_t align = static_cast<size_t>(alignment);
+  // aligned_alloc needs a size that is a multiple of the alignment
+  return std::aligned_alloc(align, (size + align - 1) / align * align);
+}
+#endif
+}  // namespace
+
+AllocationCounter::Counts AllocationCounter::getThreadCounts() {
+  Counts total;
+  for (const auto& counts : threadCounts) {
+    total.merge(counts);
+  }
+  return total;
+}
+
+AllocationCounter::PhaseCounts AllocationCounter::getThreadPhaseCounts() {
+  return threadCounts;
+}
+
+#ifdef BLACKJACKLAB_COUNT_ALLOCATIONS
+
+// Replacements for the global allocation functions
+void* operator new(std::size_t size) {
+  void* p = countedAllocate(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](std::size_t size) {
+  void* p = countedAllocate(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return countedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return countedAllocate(size);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+  std::free(p);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  void* p = countedAllocate(size, alignment);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  void* p = countedAllocate(size, alignment);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+#endif
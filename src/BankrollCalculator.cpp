@@ -0,0 +1,654 @@
+#include "BankrollCalculator.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "BlackjackUtils.h"
+#include "Rng.h"
+
+namespace {
+// Number of sessions advanced together in one block of the Monte Carlo
+constexpr int kBlockSize = 1024;
+
+// Value classes used to enumerate starting hands: 2-9, ten-valued, Ace
+const Card::Rank kClassRanks[10] = {
+    Card::Rank::Two,   Card::Rank::Three, Card::Rank::Four, Card::Rank::Five,
+    Card::Rank::Six,   Card::Rank::Seven, Card::Rank::Eight, Card::Rank::Nine,
+    Card::Rank::Ten,   Card::Rank::Ace};
+constexpr int kTenClass = 8;
+constexpr int kAceClass = 9;
+
+// Walker alias table for O(1) sampling of the true count rows
+struct AliasTable {
+  std::vector<double> probability;
+  std::vector<int> alias;
+
+  explicit AliasTable(const std::vector<double>& weights) {
+    int n = static_cast<int>(weights.size());
+    probability.assign(n, 0.0);
+    alias.assign(n, 0);
+    double total = 0.0;
+    for (double w : weights) total += w;
+
+    std::vector<double> scaled(n);
+    std::vector<int> small, large;
+    for (int i = 0; i < n; ++i) {
+      scaled[i] = weights[i] * n / total;
+      (scaled[i] < 1.0 ? small : large).push_back(i);
+    }
+    while (!small.empty() && !large.empty()) {
+      int s = small.back();
+      small.pop_back();
+      int l = large.back();
+      probability[s] = scaled[s];
+      alias[s] = l;
+      scaled[l] -= 1.0 - scaled[s];
+      if (scaled[l] < 1.0) {
+        large.pop_back();
+        small.push_back(l);
+      }
+    }
+    for (int i : large) probability[i] = 1.0;
+    for (int i : small) probability[i] = 1.0;
+  }
+};
+
+// Picks the ten-valued rank with the most cards left so that hands can be
+// dealt from any composition
+Card::Rank takeClassRank(int valueClass, std::map<Card::Rank, int>& counts) {
+  if (valueClass != kTenClass) {
+    counts[kClassRanks[valueClass]]--;
+    return kClassRanks[valueClass];
+  }
+  Card::Rank best = Card::Rank::Ten;
+  for (Card::Rank rank : {Card::Rank::Jack, Card::Rank::Queen,
+                          Card::Rank::King}) {
+    if (counts[rank] > counts[best]) best = rank;
+  }
+  counts[best]--;
+  return best;
+}
+
+// Helper function to print bankroll usage information
+void print_bankroll_help() {
+  std::cout
+      << "Usage: ./BlackjackLab bankroll --tc-table <file.csv> [options]\n"
+      << "Computes risk of ruin, N0 and the Kelly bet ramp for a bet spread, "
+         "and runs a Monte Carlo\n"
+      << "of bankroll trajectories. The true count table comes from "
+         "'simulate --tc-output'.\n"
+      << "\nOptions:\n"
+      << "  --tc-table <file.csv>     Frequency, EV and variance per true "
+         "count (required).\n"
+      << "  --spread <ramp>           Units bet at true count 1, 2, 3... "
+         "separated by '/', 'flat',\n"
+      << "                            or 'kelly' to use the Kelly ramp "
+         "(default: flat).\n"
+      << "  --bankroll <units>        Starting bankroll in units (default: "
+         "1000).\n"
+      << "  --kelly-fraction <num>    Fraction of full Kelly for the Kelly "
+         "ramp (default: 1.0).\n"
+      << "  --min-bet <units>         Smallest bet of the Kelly ramp "
+         "(default: 1).\n"
+      << "  --max-bet <units>         Largest bet of the Kelly ramp "
+         "(default: largest bet of the spread).\n"
+      << "  --rounds <num>            Rounds per simulated session (default: "
+         "1000).\n"
+      << "  --sessions <num>          Number of simulated sessions (default: "
+         "1000000).\n"
+      << "  --seed <num>              Seed for reproducible runs (default: "
+         "random).\n"
+      << "  --threads <num>           Number of threads to use (default: "
+         "max (recommended)).\n"
+      << "  --trajectory-output <file.csv>\n"
+      << "                            Write bankroll percentiles at each "
+         "checkpoint to a CSV file.\n"
+      << "  --exact <bool>            Replace the table's EVs with exact "
+         "engine EVs for a shoe at each\n"
+      << "                            true count ('true' or 'false', default: "
+         "false). Slow for many decks.\n"
+      << "  --exact-decks <num>       Decks remaining in the shoe used for "
+         "exact EVs (default: half\n"
+      << "                            the shoe, at least 1).\n"
+      << "  --tc-output <file.csv>    Write the (possibly exact) true count "
+         "table to a CSV file.\n"
+      << "  Game rule flags (--decks, --s17, --das, --surrender, ...) are the "
+         "same as for 'strategy'\n"
+      << "  and are only used with --exact.\n";
+}
+}  // namespace
+
+int BankrollCalculator::run(int argc, char* argv[]) {
+  // Print help message if requested
+  if (argc > 2 && argv[2] == std::string("--help")) {
+    print_bankroll_help();
+    return 0;
+  }
+
+  std::map<std::string, std::string> args;
+  if (!BlackjackUtils::parseArguments(argc, argv, args)) {
+    return 1;
+  }
+
+  BlackjackGame::GameRules rules;
+  SessionConfig config;
+  if (!BlackjackUtils::parseGameRules(args, rules) ||
+      !BlackjackUtils::parseThreadCount(args, config.threadCount)) {
+    return 1;
+  }
+
+  if (args.find("tc-table") == args.end()) {
+    std::cerr << "Error: Required flag '--tc-table' is missing." << std::endl;
+    return 1;
+  }
+
+  std::vector<TrueCountRow> rows;
+  try {
+    rows = readTrueCountCSV(args["tc-table"]);
+  } catch (const std::runtime_error& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+
+  double kellyFraction = 1.0;
+  double minBet = 1.0;
+  double maxBet = -1.0;
+  int exactDecks = std::max(1, (rules.numDecks + 1) / 2);
+  try {
+    if (args.count("bankroll")) config.bankroll = std::stod(args["bankroll"]);
+    if (args.count("kelly-fraction")) {
+      kellyFraction = std::stod(args["kelly-fraction"]);
+    }
+    if (args.count("min-bet")) minBet = std::stod(args["min-bet"]);
+    if (args.count("max-bet")) maxBet = std::stod(args["max-bet"]);
+    if (args.count("rounds")) {
+      config.roundsPerSession = std::stoll(args["rounds"]);
+    }
+    if (args.count("sessions")) config.numSessions = std::stoll(args["sessions"]);
+    if (args.count("exact-decks")) exactDecks = std::stoi(args["exact-decks"]);
+    if (config.bankroll <= 0.0 || kellyFraction <= 0.0 || minBet <= 0.0 ||
+        config.roundsPerSession < 1 || config.numSessions < 1 ||
+        exactDecks < 1 || exactDecks > rules.numDecks) {
+      throw std::out_of_range("Values must be positive.");
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Error: Invalid numeric option. Bankroll, bets, rounds, "
+                 "sessions and Kelly fraction must be positive, and "
+                 "'--exact-decks' must be at most '--decks'."
+              << std::endl;
+    return 1;
+  }
+
+  if (args.count("seed")) {
+    try {
+      config.seed = std::stoull(args["seed"]);
+    } catch (const std::exception& e) {
+      std::cerr << "Error: Invalid value for '--seed'. Must be a non-negative "
+                   "integer."
+                << std::endl;
+      return 1;
+    }
+  } else {
+    std::random_device rd;
+    config.seed = (static_cast<unsigned long long>(rd()) << 32) | rd();
+  }
+
+  if (args.count("exact") && args["exact"] == "true") {
+    fillExactEVs(rules, rows, exactDecks, config.threadCount);
+  }
+  if (args.count("tc-output") &&
+      writeTrueCountCSV(args["tc-output"], rows) != 0) {
+    return 1;
+  }
+
+  std::string spread = args.count("spread") ? args["spread"] : "flat";
+  std::vector<double> spreadRamp = {1.0};
+  if (spread != "kelly") {
+    try {
+      spreadRamp = BlackjackUtils::parseBetRamp(spread);
+    } catch (const std::exception& e) {
+      std::cerr << "Error: Invalid value for '--spread'. Must be 'flat', "
+                   "'kelly' or positive bets separated by '/'."
+                << std::endl;
+      return 1;
+    }
+  }
+  if (maxBet < 0.0) {
+    maxBet = std::max(minBet, *std::max_element(spreadRamp.begin(),
+                                                spreadRamp.end()));
+  }
+
+  std::vector<double> spreadBets;
+  for (const auto& row : rows) {
+    spreadBets.push_back(BlackjackUtils::betForTrueCount(spreadRamp,
+                                                         row.trueCount));
+  }
+  std::vector<double> kelly =
+      kellyBets(rows, config.bankroll, kellyFraction, minBet, maxBet);
+
+  std::cout << std::fixed << std::setprecision(4);
+  std::cout << "True Count  Frequency        EV  Variance  Spread  Kelly\n";
+  for (size_t i = 0; i < rows.size(); ++i) {
+    std::cout << std::setw(10) << rows[i].trueCount << std::setw(11)
+              << rows[i].frequency << std::setw(10) << rows[i].ev
+              << std::setw(10) << rows[i].variance << std::setw(8)
+              << std::setprecision(1) << spreadBets[i] << std::setw(7)
+              << kelly[i] << std::setprecision(4) << "\n";
+  }
+
+  auto printSummary = [&config](const std::string& label,
+                                const BankrollSummary& summary) {
+    std::cout << "\n" << label << ":\n";
+    std::cout << "EV per round: " << summary.evPerRound << " units ("
+              << summary.evPerRound / summary.averageBet * 100.0
+              << "% of average bet)\n";
+    std::cout << "Standard deviation per round: "
+              << std::sqrt(summary.variancePerRound) << " units\n";
+    std::cout << "Average bet: " << summary.averageBet << " units\n";
+    std::cout << "Risk of ruin (bankroll " << config.bankroll
+              << " units): " << summary.riskOfRuin * 100.0 << "%\n";
+    if (summary.evPerRound > 0.0) {
+      std::cout << "N0: " << std::setprecision(0) << summary.n0
+                << std::setprecision(4) << " rounds\n";
+    } else {
+      std::cout << "N0: infinite (no player edge)\n";
+    }
+  };
+  BankrollSummary spreadSummary = summarize(rows, spreadBets, config.bankroll);
+  BankrollSummary kellySummary = summarize(rows, kelly, config.bankroll);
+  printSummary(spread == "kelly" ? "Kelly ramp" : "Spread " + spread,
+               spread == "kelly" ? kellySummary : spreadSummary);
+  if (spread != "kelly") {
+    printSummary("Kelly ramp (fraction " + std::to_string(kellyFraction) + ")",
+                 kellySummary);
+  }
+
+  std::string trajectoryFile =
+      args.count("trajectory-output") ? args["trajectory-output"] : "";
+  return simulateSessions(rows, spread == "kelly" ? kelly : spreadBets, config,
+                          trajectoryFile);
+}
+
+std::vector<TrueCountRow> BankrollCalculator::readTrueCountCSV(
+    const std::string& filename) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open true count table " + filename);
+  }
+
+  std::vector<TrueCountRow> rows;
+  std::string line;
+  bool headerSeen = false;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    if (!headerSeen) {
+      headerSeen = true;
+      continue;
+    }
+    std::stringstream ss(line);
+    std::string trueCount, frequency, ev, variance;
+    std::getline(ss, trueCount, ',');
+    std::getline(ss, frequency, ',');
+    std::getline(ss, ev, ',');
+    std::getline(ss, variance, ',');
+    try {
+      rows.push_back({std::stoi(trueCount), std::stod(frequency),
+                      std::stod(ev), std::stod(variance)});
+    } catch (const std::exception& e) {
+      throw std::runtime_error("Malformed true count row: " + line);
+    }
+    if (rows.back().frequency < 0.0 || rows.back().variance < 0.0) {
+      throw std::runtime_error("Negative frequency or variance: " + line);
+    }
+  }
+  if (rows.empty()) {
+    throw std::runtime_error("No true count rows found in " + filename);
+  }
+
+  // Normalize frequencies in case the table was trimmed
+  double total = 0.0;
+  for (const auto& row : rows) total += row.frequency;
+  if (total <= 0.0) {
+    throw std::runtime_error("True count frequencies sum to zero in " +
+                             filename);
+  }
+  for (auto& row : rows) row.frequency /= total;
+  return rows;
+}
+
+int BankrollCalculator::writeTrueCountCSV(
+    const std::string& filename, const std::vector<TrueCountRow>& rows) {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Error: Could not open file " << filename << " for writing."
+              << std::endl;
+    return 1;
+  }
+  file << "True Count,Frequency,EV,Variance\n";
+  file << std::setprecision(10);
+  for (const auto& row : rows) {
+    file << row.trueCount << "," << row.frequency << "," << row.ev << ","
+         << row.variance << "\n";
+  }
+  std::cout << "True count table written to " << filename << "\n";
+  return 0;
+}
+
+void BankrollCalculator::fillExactEVs(const BlackjackGame::GameRules& rules,
+                                      std::vector<TrueCountRow>& rows,
+                                      int decksRemaining, int threadCount) {
+  std::cout << "Calculating exact round EVs at " << rows.size()
+            << " true counts using " << threadCount
+            << " threads... (this may take a while)\n";
+
+  std::atomic<size_t> nextRow = 0;
+  std::atomic<int> rowsCompleted = 0;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < threadCount; ++i) {
+    threads.emplace_back([&] {
+      BlackjackGame game(rules);
+      size_t index;
+      while ((index = nextRow++) < rows.size()) {
+        game.clearMemos();
+        rows[index].ev = calculateRoundEV(
+            game, rules,
+            compositionForTrueCount(decksRemaining, rows[index].trueCount));
+        rowsCompleted++;
+      }
+    });
+  }
+
+  // Print a progress meter as the program runs
+  while (rowsCompleted < static_cast<int>(rows.size())) {
+    std::cout << "\rProgress: " << rowsCompleted * 100 / rows.size() << "%"
+              << std::flush;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+  }
+  std::cout << "\rProgress: 100%\n";
+
+  for (auto& t : threads) {
+    if (t.joinable()) {
+      t.join();
+    }
+  }
+}
+
+std::map<Card::Rank, int> BankrollCalculator::compositionForTrueCount(
+    int decksRemaining, int trueCount) {
+  std::map<Card::Rank, int> counts;
+  for (int r = static_cast<int>(Card::Rank::Ace);
+       r <= static_cast<int>(Card::Rank::King); ++r) {
+    counts[static_cast<Card::Rank>(r)] = 4 * decksRemaining;
+  }
+
+  // Positive counts mean low cards (2-6) have left the shoe, negative counts
+  // mean high cards (10-K, A) have. Remove them round-robin by rank.
+  int runningCount = trueCount * decksRemaining;
+  std::vector<Card::Rank> removable;
+  if (runningCount > 0) {
+    removable = {Card::Rank::Two, Card::Rank::Three, Card::Rank::Four,
+                 Card::Rank::Five, Card::Rank::Six};
+  } else {
+    removable = {Card::Rank::Ten, Card::Rank::Jack, Card::Rank::Queen,
+                 Card::Rank::King, Card::Rank::Ace};
+  }
+  int toRemove = std::min(std::abs(runningCount),
+                          static_cast<int>(removable.size()) * 4 *
+                              decksRemaining);
+  for (int i = 0; i < toRemove; ++i) {
+    counts[removable[i % removable.size()]]--;
+  }
+  return counts;
+}
+
+double BankrollCalculator::calculateRoundEV(
+    const BlackjackGame& game, const BlackjackGame::GameRules& rules,
+    const std::map<Card::Rank, int>& composition) {
+  std::array<int, 10> classCounts = {};
+  for (const auto& pair : composition) {
+    int value = Card(pair.first, Card::Suit::Hearts).getValue();
+    classCounts[value == 11 ? kAceClass : value - 2] += pair.second;
+  }
+  double total = 0;
+  for (int count : classCounts) total += count;
+
+  double roundEV = 0.0;
+  for (int up = 0; up < 10; ++up) {
+    if (classCounts[up] == 0) continue;
+    double probUpcard = classCounts[up] / total;
+    classCounts[up]--;
+
+    for (int a = 0; a < 10; ++a) {
+      for (int b = a; b < 10; ++b) {
+        // Probability of the two player cards in either order
+        double probHand =
+            a == b ? classCounts[a] / (total - 1) * (classCounts[a] - 1) /
+                         (total - 2)
+                   : 2.0 * classCounts[a] / (total - 1) * classCounts[b] /
+                         (total - 2);
+        if (probHand <= 0.0) continue;
+
+        // Probability that the hole card gives the dealer blackjack
+        double remaining = total - 3;
+        int tensLeft = classCounts[kTenClass] - (a == kTenClass) -
+                       (b == kTenClass);
+        int acesLeft = classCounts[kAceClass] - (a == kAceClass) -
+                       (b == kAceClass);
+        double probDealerBJ = 0.0;
+        if (up == kAceClass) probDealerBJ = tensLeft / remaining;
+        if (up == kTenClass) probDealerBJ = acesLeft / remaining;
+
+        double handEV;
+        if ((a == kTenClass && b == kAceClass)) {
+          handEV = (1.0 - probDealerBJ) * rules.blackjackPayout;
+        } else {
+          std::map<Card::Rank, int> counts = composition;
+          Card::Rank upRank = takeClassRank(up, counts);
+          Card::Rank firstRank = takeClassRank(a, counts);
+          Card::Rank secondRank = takeClassRank(b, counts);
+          BlackjackGame::GameState state =
+              BlackjackGame::getGameStateForComposition(
+                  {firstRank, secondRank}, upRank, composition,
+                  rules.numDecks, true);
+          handEV = -probDealerBJ +
+                   (1.0 - probDealerBJ) *
+                       game.calculateEVForOptimalStrategy(state).optimalEV;
+        }
+        roundEV += probUpcard * probHand * handEV;
+      }
+    }
+    classCounts[up]++;
+  }
+  return roundEV;
+}
+
+BankrollSummary BankrollCalculator::summarize(
+    const std::vector<TrueCountRow>& rows, const std::vector<double>& bets,
+    double bankroll) {
+  BankrollSummary summary;
+  double secondMoment = 0.0;
+  for (size_t i = 0; i < rows.size(); ++i) {
+    const TrueCountRow& row = rows[i];
+    summary.averageBet += row.frequency * bets[i];
+    summary.evPerRound += row.frequency * bets[i] * row.ev;
+    secondMoment += row.frequency * bets[i] * bets[i] *
+                    (row.variance + row.ev * row.ev);
+  }
+  summary.variancePerRound =
+      secondMoment - summary.evPerRound * summary.evPerRound;
+
+  // Diffusion approximation of the probability of ever going broke
+  if (summary.evPerRound > 0.0) {
+    summary.riskOfRuin = std::exp(-2.0 * summary.evPerRound * bankroll /
+                                  summary.variancePerRound);
+    summary.n0 = summary.variancePerRound /
+                 (summary.evPerRound * summary.evPerRound);
+  }
+  return summary;
+}
+
+std::vector<double> BankrollCalculator::kellyBets(
+    const std::vector<TrueCountRow>& rows, double bankroll,
+    double kellyFraction, double minBet, double maxBet) {
+  std::vector<double> bets;
+  for (const auto& row : rows) {
+    double bet = minBet;
+    if (row.ev > 0.0 && row.variance > 0.0) {
+      bet = std::round(kellyFraction * bankroll * row.ev / row.variance);
+    }
+    bets.push_back(std::clamp(bet, minBet, std::max(minBet, maxBet)));
+  }
+  return bets;
+}
+
+int BankrollCalculator::simulateSessions(const std::vector<TrueCountRow>& rows,
+                                         const std::vector<double>& bets,
+                                         const SessionConfig& config,
+                                         const std::string& trajectoryFile) {
+  std::cout << "\nSimulating " << config.numSessions << " sessions of "
+            << config.roundsPerSession << " rounds using "
+            << config.threadCount << " threads (seed " << config.seed
+            << ")...\n";
+  auto startTime = std::chrono::steady_clock::now();
+
+  // Each round's result at a count is drawn from the two-point distribution
+  // bet * (EV +/- SD), which matches the count's mean and variance
+  std::vector<double> weights, means, deviations;
+  for (size_t i = 0; i < rows.size(); ++i) {
+    weights.push_back(rows[i].frequency);
+    means.push_back(bets[i] * rows[i].ev);
+    deviations.push_back(bets[i] * std::sqrt(rows[i].variance));
+  }
+  const AliasTable table(weights);
+  const uint32_t numRows = static_cast<uint32_t>(rows.size());
+
+  // Bankroll of every session at each checkpoint
+  std::vector<long long> checkpointRounds;
+  for (int k = 1; k <= config.numCheckpoints; ++k) {
+    checkpointRounds.push_back(std::max<long long>(
+        1, config.roundsPerSession * k / config.numCheckpoints));
+  }
+  checkpointRounds.erase(
+      std::unique(checkpointRounds.begin(), checkpointRounds.end()),
+      checkpointRounds.end());
+  std::vector<std::vector<float>> trajectories(
+      checkpointRounds.size(), std::vector<float>(config.numSessions));
+
+  // Sessions are processed in fixed blocks, each with an RNG stream derived
+  // from the seed and block index, so results don't depend on thread count
+  const long long numBlocks =
+      (config.numSessions + kBlockSize - 1) / kBlockSize;
+  std::atomic<long long> nextBlock = 0;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < config.threadCount; ++t) {
+    threads.emplace_back([&] {
+      std::array<double, kBlockSize> bankroll;
+      std::array<uint64_t, kBlockSize> randomBits;
+      long long block;
+      while ((block = nextBlock++) < numBlocks) {
+        Rng rng(config.seed + 0xD1B54A32D192ED03ULL * (block + 1));
+        long long first = block * kBlockSize;
+        int lanes = static_cast<int>(
+            std::min<long long>(kBlockSize, config.numSessions - first));
+        bankroll.fill(config.bankroll);
+
+        size_t checkpoint = 0;
+        for (long long round = 1; round <= config.roundsPerSession; ++round) {
+          for (int i = 0; i < lanes; ++i) {
+            randomBits[i] = rng.next();
+          }
+          // Branch-free update of every lane in the block
+          for (int i = 0; i < lanes; ++i) {
+            uint64_t bits = randomBits[i];
+            uint32_t slot = static_cast<uint32_t>(
+                ((bits >> 32) * numRows) >> 32);
+            double coin = (bits & 0xFFFFFF) * 0x1.0p-24;
+            int row = coin < table.probability[slot] ? slot : table.alias[slot];
+            double sign = (bits & 0x1000000) ? 1.0 : -1.0;
+            double result = means[row] + sign * deviations[row];
+            // Ruined sessions stay at zero
+            double alive = bankroll[i] > 0.0 ? 1.0 : 0.0;
+            bankroll[i] = std::max(0.0, bankroll[i] + alive * result);
+          }
+          if (round == checkpointRounds[checkpoint]) {
+            for (int i = 0; i < lanes; ++i) {
+              trajectories[checkpoint][first + i] =
+                  static_cast<float>(bankroll[i]);
+            }
+            checkpoint++;
+          }
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    if (t.joinable()) {
+      t.join();
+    }
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - startTime)
+                       .count();
+
+  std::ofstream file;
+  if (!trajectoryFile.empty()) {
+    file.open(trajectoryFile);
+    if (!file.is_open()) {
+      std::cerr << "Error: Could not open file " << trajectoryFile
+                << " for writing." << std::endl;
+      return 1;
+    }
+    file << "Round,Ruined,Mean,P5,P25,P50,P75,P95\n";
+  }
+
+  std::cout << "     Round  Ruined      Mean        P5       P25       P50"
+               "       P75       P95\n";
+  const double quantiles[] = {0.05, 0.25, 0.5, 0.75, 0.95};
+  for (size_t k = 0; k < checkpointRounds.size(); ++k) {
+    std::vector<float>& values = trajectories[k];
+    double mean = 0.0;
+    long long ruined = 0;
+    for (float v : values) {
+      mean += v;
+      ruined += v <= 0.0f;
+    }
+    mean /= values.size();
+    double ruinedFraction = static_cast<double>(ruined) / values.size();
+
+    std::array<double, 5> percentiles;
+    for (int q = 0; q < 5; ++q) {
+      size_t index = static_cast<size_t>(quantiles[q] * (values.size() - 1));
+      std::nth_element(values.begin(), values.begin() + index, values.end());
+      percentiles[q] = values[index];
+    }
+
+    std::cout << std::setprecision(4) << std::setw(10) << checkpointRounds[k]
+              << std::setw(8) << ruinedFraction << std::setprecision(1)
+              << std::setw(10) << mean;
+    for (double p : percentiles) std::cout << std::setw(10) << p;
+    std::cout << "\n";
+    if (file.is_open()) {
+      file << checkpointRounds[k] << "," << ruinedFraction << "," << mean;
+      for (double p : percentiles) file << "," << p;
+      file << "\n";
+    }
+  }
+  std::cout << std::setprecision(2) << "Monte Carlo time: " << seconds << " s"
+            << std::endl;
+  if (file.is_open()) {
+    std::cout << "Trajectories written to " << trajectoryFile << "\n";
+  }
+  return 0;
+}
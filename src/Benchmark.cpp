@@ -0,0 +1,340 @@
+#include "Benchmark.h"
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+
+#include "BlackjackUtils.h"
+
+namespace {
+// Helper function to print benchmark usage information
+void print_benchmark_help() {
+  std::cout
+      << "Usage: ./BlackjackLab benchmark [options]\n"
+      << "Solves strategy chart matchups with the exact engine and reports "
+         "the time taken, the\n"
+      << "states expanded and the heap allocations made by the worker "
+         "threads.\n"
+      << "\nOptions:\n"
+      << "  --matchups <num>          Number of chart matchups to solve, "
+         "spread evenly over the\n"
+      << "                            chart (default: 330, the whole "
+         "chart).\n"
+      << "  --threads <num>           Number of threads to use (default: "
+         "max).\n"
+      << "  --stats <bool>            Also print memo hit rates ('true' or "
+         "'false', default: false).\n"
+      << "  --hw-counters <bool>      Count CPU events per engine phase with "
+         "perf_event_open ('true'\n"
+      << "                            or 'false', default: false).\n"
+      << "  --interleave <num>        Solve each row as a batch, calculating "
+         "its dealer\n"
+      << "                            distributions this many at a time per "
+         "thread to hide memo\n"
+      << "                            cache misses (default: 0, solve the "
+         "matchups one by one).\n"
+      << "  --verify <bool>           With --interleave, solve every row "
+         "again one matchup at a\n"
+      << "                            time and fail if any result differs "
+         "('true' or 'false',\n"
+      << "                            default: false). Slows the run.\n"
+      << "  --memo-storage <mode>     'full', 'compact' or 'float' memo "
+         "entries (default: full).\n"
+      << "  --alloc-budget <num>      Fail if the search makes more heap "
+         "allocations per state\n"
+      << "                            expanded than this. Needs a build "
+         "configured with\n"
+      << "                            -DBLACKJACKLAB_COUNT_ALLOCATIONS=ON.\n"
+      << "  Game rule flags (--decks, --s17, --das, --surrender, ...) are the "
+         "same as for 'strategy'.\n";
+}
+}  // namespace
+
+int Benchmark::run(int argc, char* argv[]) {
+  // Print help message if requested
+  if (argc > 2 && argv[2] == std::string("--help")) {
+    print_benchmark_help();
+    return 0;
+  }
+
+  std::map<std::string, std::string> args;
+  if (!BlackjackUtils::parseArguments(argc, argv, args)) {
+    return 1;
+  }
+
+  BlackjackGame::GameRules rules;
+  int threadCount;
+  BlackjackGame::MemoStorage memoStorage;
+  if (!BlackjackUtils::parseGameRules(args, rules) ||
+      !BlackjackUtils::parseThreadCount(args, threadCount) ||
+      !BlackjackUtils::parseMemoStorage(args, memoStorage)) {
+    return 1;
+  }
+
+  std::vector<BenchmarkMatchup> chart = getChartMatchups();
+  size_t numMatchups = chart.size();
+  if (args.count("matchups")) {
+    try {
+      int value = std::stoi(args["matchups"]);
+      if (value < 1 || value > static_cast<int>(chart.size())) {
+        throw std::out_of_range("Invalid matchup count.");
+      }
+      numMatchups = value;
+    } catch (const std::exception& e) {
+      std::cerr << "Error: Invalid value for '--matchups'. Must be an "
+                   "integer (1-"
+                << chart.size() << ")." << std::endl;
+      return 1;
+    }
+  }
+  int interleave = 0;
+  if (args.count("interleave")) {
+    try {
+      interleave = std::stoi(args["interleave"]);
+      if (interleave < 0) {
+        throw std::out_of_range("Invalid interleave count.");
+      }
+    } catch (const std::exception& e) {
+      std::cerr << "Error: Invalid value for '--interleave'. Must be a "
+                   "non-negative integer."
+                << std::endl;
+      return 1;
+    }
+  }
+  bool verify = args.count("verify") && args["verify"] == "true";
+  if (verify && interleave == 0) {
+    std::cerr << "Error: '--verify' needs '--interleave'." << std::endl;
+    return 1;
+  }
+  double allocBudget = -1;
+  if (args.count("alloc-budget")) {
+    if (!AllocationCounter::kEnabled) {
+      std::cerr << "Error: '--alloc-budget' needs a build configured with "
+                   "-DBLACKJACKLAB_COUNT_ALLOCATIONS=ON."
+                << std::endl;
+      return 1;
+    }
+    try {
+      allocBudget = std::stod(args["alloc-budget"]);
+      if (allocBudget < 0) {
+        throw std::out_of_range("Invalid allocation budget.");
+      }
+    } catch (const std::exception& e) {
+      std::cerr << "Error: Invalid value for '--alloc-budget'. Must be a "
+                   "non-negative number."
+                << std::endl;
+      return 1;
+    }
+  }
+  bool printStats = args.count("stats") && args["stats"] == "true";
+  bool hwCounters =
+      args.count("hw-counters") && args["hw-counters"] == "true";
+  if (hwCounters) {
+    // Check once up front so an unavailable PMU is reported a single time
+    std::string error;
+    if (HardwareCounters::startThread(error)) {
+      HardwareCounters::stopThread();
+    } else {
+      std::cout << "Hardware counters unavailable: " << error << "\n";
+      hwCounters = false;
+    }
+  }
+
+  // Take matchups evenly across the chart so a short run still mixes hard,
+  // soft and pair hands. Matchups of the same hand form a row.
+  std::vector<std::vector<BenchmarkMatchup>> rows;
+  for (size_t i = 0; i < numMatchups; ++i) {
+    const BenchmarkMatchup& matchup = chart[i * chart.size() / numMatchups];
+    if (rows.empty() || rows.back()[0].playerRanks != matchup.playerRanks) {
+      rows.emplace_back();
+    }
+    rows.back().push_back(matchup);
+  }
+
+  std::cout << "Solving " << numMatchups << " matchups with "
+            << rules.numDecks << " decks on " << threadCount
+            << " threads";
+  if (interleave > 0) {
+    std::cout << ", " << interleave << " dealer searches interleaved";
+  }
+  std::cout << "...\n";
+
+  std::atomic<size_t> nextRow = 0;
+  std::vector<BenchmarkThreadResult> threadResults(threadCount);
+  std::vector<std::thread> threads;
+  auto startTime = std::chrono::steady_clock::now();
+  for (int i = 0; i < threadCount; ++i) {
+    threads.emplace_back([&, i] {
+      solveMatchups(rules, rows, nextRow, memoStorage, interleave, verify,
+                    hwCounters, threadResults[i]);
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - startTime)
+                       .count();
+
+  BlackjackGame::SearchStats totals;
+  uint64_t mismatches = 0;
+  AllocationCounter::PhaseCounts phaseAllocations = {};
+  AllocationCounter::Counts allocations;
+  HardwareCounters::Counts counters;
+  for (const auto& result : threadResults) {
+    totals.merge(result.stats);
+    mismatches += result.mismatches;
+    counters.merge(result.counters);
+    for (int p = 0; p < EnginePhase::kNumPhases; ++p) {
+      phaseAllocations[p].merge(result.allocations[p]);
+      allocations.merge(result.allocations[p]);
+    }
+  }
+  uint64_t nodes = totals.playerNodes + totals.dealerNodes;
+
+  std::cout << "Time: " << seconds << " s (" << numMatchups / seconds
+            << " matchups/s)\n";
+  std::cout << "States expanded: " << nodes << " (" << totals.playerNodes
+            << " player, " << totals.dealerNodes << " dealer), "
+            << nodes / seconds << " per second\n";
+  double allocationsPerState =
+      nodes > 0 ? static_cast<double>(allocations.allocations) / nodes : 0.0;
+  if (AllocationCounter::kEnabled) {
+    std::cout << "Heap allocations: " << allocations.allocations << " ("
+              << allocations.bytes << " bytes), " << allocationsPerState
+              << " per state expanded\n";
+    for (int p = 0; p < EnginePhase::kNumPhases; ++p) {
+      std::cout << "  " << std::left << std::setw(21)
+                << EnginePhase::name(static_cast<EnginePhase::Phase>(p))
+                << std::right << phaseAllocations[p].allocations << " ("
+                << phaseAllocations[p].bytes << " bytes)\n";
+    }
+  } else {
+    std::cout << "Heap allocations: not counted (configure with "
+                 "-DBLACKJACKLAB_COUNT_ALLOCATIONS=ON)\n";
+  }
+  if (printStats) {
+    BlackjackUtils::printSearchStats(totals);
+  }
+  if (hwCounters) {
+    for (int i = 0; i < threadCount; ++i) {
+      HardwareCounters::print("thread " + std::to_string(i + 1),
+                              threadResults[i].counters);
+    }
+    HardwareCounters::print("all threads", counters);
+  }
+  if (verify) {
+    std::cout << "Interleaved results verified: " << mismatches
+              << " mismatches\n";
+    if (mismatches > 0) {
+      std::cerr << "Error: " << mismatches
+                << " interleaved results differ from solving the matchups "
+                   "one by one."
+                << std::endl;
+      return 1;
+    }
+  }
+  if (allocBudget >= 0 && allocationsPerState > allocBudget) {
+    std::cerr << "Error: " << allocationsPerState
+              << " heap allocations per state expanded exceeds the budget of "
+              << allocBudget << "." << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+std::vector<BenchmarkMatchup> Benchmark::getChartMatchups() {
+  using Rank = Card::Rank;
+  const Rank upcards[] = {Rank::Two,   Rank::Three, Rank::Four, Rank::Five,
+                          Rank::Six,   Rank::Seven, Rank::Eight, Rank::Nine,
+                          Rank::Ten,   Rank::Ace};
+
+  // Same hands as the strategy chart: hard 5-19, soft 13-20 and pairs
+  std::vector<std::vector<Rank>> hands;
+  for (int i = 3; i <= 10; ++i) {
+    hands.push_back({static_cast<Rank>(i), Rank::Two});
+  }
+  for (int i = 3; i <= 9; ++i) {
+    hands.push_back({static_cast<Rank>(i), Rank::Ten});
+  }
+  for (int i = 2; i <= 9; ++i) {
+    hands.push_back({Rank::Ace, static_cast<Rank>(i)});
+  }
+  for (int i = 2; i <= 10; ++i) {
+    hands.push_back({static_cast<Rank>(i), static_cast<Rank>(i)});
+  }
+  hands.push_back({Rank::Ace, Rank::Ace});
+
+  std::vector<BenchmarkMatchup> matchups;
+  for (const auto& hand : hands) {
+    for (Rank upcard : upcards) {
+      matchups.push_back({hand, upcard});
+    }
+  }
+  return matchups;
+}
+
+void Benchmark::solveMatchups(
+    const BlackjackGame::GameRules& rules,
+    const std::vector<std::vector<BenchmarkMatchup>>& rows,
+    std::atomic<size_t>& nextRow, BlackjackGame::MemoStorage memoStorage,
+    int interleave, bool verify, bool hwCounters,
+    BenchmarkThreadResult& result) {
+  std::string counterError;
+  bool counting = hwCounters && HardwareCounters::startThread(counterError);
+  AllocationCounter::PhaseCounts startCounts =
+      AllocationCounter::getThreadPhaseCounts();
+  BlackjackGame game(rules);
+  game.setMemoStorage(memoStorage);
+  bool dealerChecked =
+      rules.surrenderType != BlackjackGame::SurrenderType::Early;
+  while (true) {
+    size_t index = nextRow.fetch_add(1);
+    if (index >= rows.size()) {
+      break;
+    }
+    game.clearMemos();
+    std::vector<BlackjackGame::GameState> states;
+    for (const auto& matchup : rows[index]) {
+      states.push_back(BlackjackGame::getGameStateForCalculation(
+          matchup.playerRanks, matchup.dealerUpcard, rules.numDecks,
+          dealerChecked));
+    }
+    if (interleave > 0) {
+      std::vector<BlackjackGame::EVResult> results =
+          game.calculateEVsInterleaved(states, interleave);
+      // A fresh game per row, so the check shares no memo entries with the
+      // interleaved search
+      if (verify) {
+        BlackjackGame plainGame(rules);
+        plainGame.setMemoStorage(memoStorage);
+        for (size_t i = 0; i < states.size(); ++i) {
+          if (!BlackjackGame::isSameResult(
+                  results[i],
+                  plainGame.calculateEVForOptimalStrategy(states[i]))) {
+            result.mismatches++;
+          }
+        }
+      }
+    } else {
+      for (const auto& state : states) {
+        game.calculateEVForOptimalStrategy(state);
+      }
+    }
+  }
+  result.stats = game.getSearchStats();
+  AllocationCounter::PhaseCounts endCounts =
+      AllocationCounter::getThreadPhaseCounts();
+  for (int p = 0; p < EnginePhase::kNumPhases; ++p) {
+    result.allocations[p].allocations =
+        endCounts[p].allocations - startCounts[p].allocations;
+    result.allocations[p].bytes = endCounts[p].bytes - startCounts[p].bytes;
+  }
+  if (counting) {
+    result.counters = HardwareCounters::stopThread();
+  }
+}
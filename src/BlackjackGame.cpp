@@ -3,16 +3,23 @@
 
 #include <algorithm>
 #include <array>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <numeric>
+#include <set>
 #include <stdexcept>
 #include <string>
 
+#include "AllocationCounter.h"
 #include "BlackjackUtils.h"
 #include "Card.h"
+#include "DealerTable.h"
 #include "Deck.h"
 #include "Hand.h"
+#include "EnginePhase.h"
+#include "TraceRecorder.h"
 
 double BlackjackGame::calculatePayout(int playerHandScore, int dealerHandScore,
                                       bool isPlayerBlackjack,
@@ -43,32 +50,58 @@ double BlackjackGame::calculatePayout(int playerHandScore, int dealerHandScore,
   return basePayout;
 }
 
-BlackjackGame::DeckCounts BlackjackGame::convertMapToDeckCount(
-    const std::map<Card::Rank, int>& remainingCardCounts) const {
+BlackjackGame::DeckCounts BlackjackGame::convertToDeckCounts(
+    const RankCounts& remainingCardCounts) const {
   DeckCounts arrayCounts = {};
-  arrayCounts[0] = remainingCardCounts.at(Card::Rank::Two);
-  arrayCounts[1] = remainingCardCounts.at(Card::Rank::Three);
-  arrayCounts[2] = remainingCardCounts.at(Card::Rank::Four);
-  arrayCounts[3] = remainingCardCounts.at(Card::Rank::Five);
-  arrayCounts[4] = remainingCardCounts.at(Card::Rank::Six);
-  arrayCounts[5] = remainingCardCounts.at(Card::Rank::Seven);
-  arrayCounts[6] = remainingCardCounts.at(Card::Rank::Eight);
-  arrayCounts[7] = remainingCardCounts.at(Card::Rank::Nine);
-  arrayCounts[8] = remainingCardCounts.at(Card::Rank::Ten) +
-                   remainingCardCounts.at(Card::Rank::Jack) +
-                   remainingCardCounts.at(Card::Rank::Queen) +
-                   remainingCardCounts.at(Card::Rank::King);
-  arrayCounts[9] = remainingCardCounts.at(Card::Rank::Ace);
+  // Two through nine are at rank indices 2-9
+  for (int rank = 2; rank <= 9; ++rank) {
+    arrayCounts[rank - 2] = remainingCardCounts[rank];
+  }
+  arrayCounts[8] = remainingCardCounts[static_cast<int>(Card::Rank::Ten)] +
+                   remainingCardCounts[static_cast<int>(Card::Rank::Jack)] +
+                   remainingCardCounts[static_cast<int>(Card::Rank::Queen)] +
+                   remainingCardCounts[static_cast<int>(Card::Rank::King)];
+  arrayCounts[9] = remainingCardCounts[static_cast<int>(Card::Rank::Ace)];
   return arrayCounts;
 }
 
+BlackjackGame::RankCounts BlackjackGame::convertMapToRankCounts(
+    const std::map<Card::Rank, int>& remainingCardCounts) {
+  RankCounts rankCounts = {};
+  for (const auto& pair : remainingCardCounts) {
+    rankCounts[static_cast<int>(pair.first)] = pair.second;
+  }
+  return rankCounts;
+}
+
+BlackjackGame::DealerMemoKey BlackjackGame::getDealerMemoKey(
+    const GameState& state, const DeckCounts& remainingCounts) const {
+  int holeCardState = getHoleCardState(
+      state.dealerHand.getCards().size(), state.dealerHand.getValue(),
+      state.dealerChecked && state.dealerUpcard.getValue() >= 10);
+  return DealerMemoKey(state.dealerHand.getValue(), state.dealerHand.isSoft(),
+                       holeCardState, remainingCounts);
+}
+
+int BlackjackGame::getHoleCardState(size_t cardCount, int total,
+                                    bool checkedUnderTenOrAce) {
+  // The hole card state keeps entries valid when the memo is shared by
+  // queries that start from different shoes. The peek only matters under a
+  // 10 or Ace. A two-card 21 is a blackjack, so it can't share the entry of
+  // a longer soft 21 left with the same counts.
+  if (cardCount == 1) {
+    return checkedUnderTenOrAce ? 2 : 1;
+  }
+  return cardCount == 2 && total == 21 ? 3 : 0;
+}
+
 BlackjackGame::GameState BlackjackGame::getGameStateMinusCardToDealer(
     const GameState& oldState, Card::Rank rankToDealer) const {
   GameState newState = oldState;
   // Only for calculation purposes so suit doesn't matter, defaulted to hearts
   newState.dealerHand.addCard(Card(rankToDealer, Card::Suit::Hearts));
   newState.totalCardsRemaining = oldState.totalCardsRemaining - 1;
-  newState.remainingCardCounts[rankToDealer]--;
+  newState.remainingCardCounts[static_cast<int>(rankToDealer)]--;
   // The dealer is taking a card, so they have not checked for BJ on this new
   // state.
   newState.dealerChecked = false;
@@ -81,7 +114,7 @@ BlackjackGame::GameState BlackjackGame::getGameStateMinusCardToPlayer(
   // Only for calculation purposes so suit doesn't matter, defaulted to hearts
   newState.playerHand.addCard(Card(rankToPlayer, Card::Suit::Hearts));
   newState.totalCardsRemaining = oldState.totalCardsRemaining - 1;
-  newState.remainingCardCounts[rankToPlayer]--;
+  newState.remainingCardCounts[static_cast<int>(rankToPlayer)]--;
   return newState;
 }
 
@@ -102,12 +135,12 @@ double BlackjackGame::getCardDrawProbability(const GameState& state,
     return 0.0;
   }
 
-  if (state.remainingCardCounts.count(cardRank) == 0 ||
-      state.remainingCardCounts.at(cardRank) == 0) {
+  const RankCounts& counts = state.remainingCardCounts;
+  if (counts[static_cast<int>(cardRank)] == 0) {
     return 0.0;
   }
 
-  double countOfRank = state.remainingCardCounts.at(cardRank);
+  double countOfRank = counts[static_cast<int>(cardRank)];
   double totalCards = state.totalCardsRemaining;
 
   // If dealer checked for blackjack and doesn't have it, we can adjust
@@ -118,17 +151,17 @@ double BlackjackGame::getCardDrawProbability(const GameState& state,
       if (cardRank == Card::Rank::Ace) {
         return 0.0;
       }
-      totalCards -= state.remainingCardCounts.at(Card::Rank::Ace);
+      totalCards -= counts[static_cast<int>(Card::Rank::Ace)];
     }
     // If dealer upcard is an Ace, the hole card cannot be a 10-value card.
     else if (state.dealerUpcard.getRank() == Card::Rank::Ace) {
       if (Card(cardRank, Card::Suit::Hearts).getValue() == 10) {
         return 0.0;
       }
-      totalCards -= (state.remainingCardCounts.at(Card::Rank::Ten) +
-                     state.remainingCardCounts.at(Card::Rank::Jack) +
-                     state.remainingCardCounts.at(Card::Rank::Queen) +
-                     state.remainingCardCounts.at(Card::Rank::King));
+      totalCards -= (counts[static_cast<int>(Card::Rank::Ten)] +
+                     counts[static_cast<int>(Card::Rank::Jack)] +
+                     counts[static_cast<int>(Card::Rank::Queen)] +
+                     counts[static_cast<int>(Card::Rank::King)]);
     }
   }
 
@@ -145,11 +178,170 @@ BlackjackGame::BlackjackGame(const GameRules& rules)
       canDoubleAfterSplit(rules.canDoubleAfterSplit),
       surrenderType(rules.surrenderType),
       canSplitAces(rules.canSplitAces),
-      maxSplits(rules.maxSplits) {}
+      maxSplits(rules.maxSplits),
+      memoArena(std::make_unique<std::pmr::monotonic_buffer_resource>(
+          kMemoArenaInitialBytes)),
+      memos(createMemos()) {}
+
+BlackjackGame::Memos* BlackjackGame::createMemos() const {
+  std::pmr::polymorphic_allocator<> allocator(memoArena.get());
+  return allocator.new_object<Memos>(memoArena.get());
+}
 
 void BlackjackGame::clearMemos() const {
-  DealerMemo_.clear();
-  PlayerMemo_.clear();
+  // Dropping the memos without destroying them skips walking their nodes
+  memos = nullptr;
+  memoArena->release();
+  memos = createMemos();
+  referenceDealerOutcomes.clear();
+}
+
+size_t BlackjackGame::getMemoEntryCount() const {
+  return memos->dealer.size() + memos->player.size() + memos->stand.size() +
+         memos->compactDealer.size() + memos->floatDealer.size() +
+         memos->compactPlayer.size();
+}
+
+void BlackjackGame::setEpsilon(double newEpsilon) { epsilon = newEpsilon; }
+
+void BlackjackGame::setDeadline(
+    std::chrono::steady_clock::time_point newDeadline) {
+  deadline = newDeadline;
+  hasDeadline = true;
+}
+
+void BlackjackGame::clearDeadline() { hasDeadline = false; }
+
+void BlackjackGame::setDecisionsOnly(bool newDecisionsOnly) {
+  // Entries from decision-only mode have unfinished action EVs
+  if (newDecisionsOnly != decisionsOnly) {
+    clearMemos();
+  }
+  decisionsOnly = newDecisionsOnly;
+}
+
+void BlackjackGame::setMemoStorage(MemoStorage newMemoStorage) {
+  // The packed key has a byte per card value, and a deck has 16 ten-values
+  if (newMemoStorage != MemoStorage::Full && numDecks > 15) {
+    throw std::runtime_error(
+        "Compact memo storage supports at most 15 decks.");
+  }
+  if (newMemoStorage != memoStorage) {
+    clearMemos();
+  }
+  memoStorage = newMemoStorage;
+}
+
+void BlackjackGame::setPayoutMoments(bool newPayoutMoments) {
+  // Entries solved without moments leave them NaN
+  if (newPayoutMoments && !payoutMoments) {
+    clearMemos();
+  }
+  payoutMoments = newPayoutMoments;
+}
+
+void BlackjackGame::setValidateMemoKeys(bool newValidateMemoKeys) {
+  validateMemoKeys = newValidateMemoKeys;
+}
+
+void BlackjackGame::setDealerTable(std::shared_ptr<const DealerTable> table) {
+  if (table && !table->matches(numDecks, dealerHitsSoft17)) {
+    throw std::runtime_error(
+        "Dealer table was built for a different shoe or soft 17 rule.");
+  }
+  dealerTable = std::move(table);
+}
+
+void BlackjackGame::SearchStats::merge(const SearchStats& other) {
+  playerNodes += other.playerNodes;
+  dealerNodes += other.dealerNodes;
+  playerMemoLookups += other.playerMemoLookups;
+  playerMemoHits += other.playerMemoHits;
+  dealerMemoLookups += other.dealerMemoLookups;
+  dealerMemoHits += other.dealerMemoHits;
+  dealerTableHits += other.dealerTableHits;
+  memoValidations += other.memoValidations;
+  memoMismatches += other.memoMismatches;
+  heapAllocations += other.heapAllocations;
+  heapBytes += other.heapBytes;
+  standMemoLookups += other.standMemoLookups;
+  standMemoHits += other.standMemoHits;
+  actionsPruned += other.actionsPruned;
+}
+
+double BlackjackGame::getMaxEV(const Hand& hand, int numPlayerHands) const {
+  // Hitting and standing win at most one unit. A two-card hand can win two by
+  // doubling (or the blackjack payout), and each split still allowed can
+  // double that.
+  double maxEV = 1.0;
+  if (hand.getCards().size() == 2) {
+    maxEV = std::max(2.0, blackjackPayout);
+    if (canSplitHand(hand, numPlayerHands)) {
+      for (int hands = numPlayerHands; hands <= maxSplits; ++hands) {
+        maxEV *= 2.0;
+      }
+    }
+  }
+  return maxEV;
+}
+
+double BlackjackGame::getUpperBoundAfterCard(const GameState& state,
+                                             Card::Rank rankToPlayer) const {
+  Hand hand = state.playerHand;
+  hand.addCard(Card(rankToPlayer, Card::Suit::Hearts));
+  if (hand.isBust()) {
+    return -1.0;
+  }
+  return getMaxEV(hand, state.numPlayerHands);
+}
+
+double BlackjackGame::getTolerance(const GameState& state) const {
+  return epsilon > 0.0 ? epsilon / state.reachProbability : 0.0;
+}
+
+void BlackjackGame::checkDeadline() const {
+  // Reading the clock on every node would be noticeable, so only check
+  // every few hundred nodes
+  if (hasDeadline && ++deadlineCheckCounter % 256 == 0 &&
+      std::chrono::steady_clock::now() >= deadline) {
+    throw DeadlineExceeded("Deadline passed before the calculation finished.");
+  }
+}
+
+BlackjackGame::EVResult BlackjackGame::calculateEVBeforeDeadline(
+    const GameState& state, std::chrono::steady_clock::time_point deadline,
+    double startEpsilon, double& epsilonUsed) {
+  double previousEpsilon = epsilon;
+  setDeadline(deadline);
+
+  EVResult result;
+  bool haveResult = false;
+  double passEpsilon = startEpsilon;
+  while (true) {
+    setEpsilon(passEpsilon);
+    try {
+      // Memo entries from looser passes are kept; their tolerance stops them
+      // from being reused where this pass needs more accuracy
+      result = calculateEVForOptimalStrategy(state);
+      haveResult = true;
+      epsilonUsed = passEpsilon;
+    } catch (const DeadlineExceeded& e) {
+      break;
+    }
+    if (passEpsilon == 0.0 || result.errorBound == 0.0) {
+      break;
+    }
+    // Finish with an exact pass once the threshold is below any reachable
+    // state's probability
+    passEpsilon = passEpsilon > 1e-15 ? passEpsilon / 10.0 : 0.0;
+  }
+
+  clearDeadline();
+  setEpsilon(previousEpsilon);
+  if (!haveResult) {
+    throw DeadlineExceeded("No pass finished before the deadline.");
+  }
+  return result;
 }
 
 BlackjackGame::GameState BlackjackGame::getGameStateForCalculation(
@@ -202,9 +394,9 @@ BlackjackGame::GameState BlackjackGame::getGameStateForCalculation(
 
   GameState state{
       playerHand,
-      dealerHand.getCards().at(0),
+      dealerHand.getCards()[0],
       dealerHand,
-      deck.getRemainingCardCounts(),
+      convertMapToRankCounts(deck.getRemainingCardCounts()),
       deck.getRemainingCardsCount(),
       num_decks,
       dealerCheckedForBJ,
@@ -215,106 +407,337 @@ BlackjackGame::GameState BlackjackGame::getGameStateForCalculation(
   return state;
 }
 
+BlackjackGame::GameState BlackjackGame::getGameStateForComposition(
+    const std::vector<Card::Rank>& player_ranks, const Card::Rank& dealer_rank,
+    std::map<Card::Rank, int> remainingCardCounts, const int num_decks,
+    const bool dealerCheckedForBJ) {
+  // The engine expects every rank to be present in the counts
+  for (int r = static_cast<int>(Card::Rank::Ace);
+       r <= static_cast<int>(Card::Rank::King); ++r) {
+    remainingCardCounts[static_cast<Card::Rank>(r)] += 0;
+  }
+
+  auto takeCard = [&remainingCardCounts](Card::Rank rank) {
+    if (remainingCardCounts[rank] <= 0) {
+      throw std::runtime_error("Too many cards of rank " +
+                               BlackjackUtils::rankToString(rank) +
+                               " requested.");
+    }
+    remainingCardCounts[rank]--;
+    // Only for calculation purposes so suit doesn't matter
+    return Card(rank, Card::Suit::Hearts);
+  };
+
+  Hand playerHand;
+  Hand dealerHand;
+  for (const auto& rank : player_ranks) {
+    playerHand.addCard(takeCard(rank));
+  }
+  dealerHand.addCard(takeCard(dealer_rank));
+
+  int totalCardsRemaining = 0;
+  for (const auto& pair : remainingCardCounts) {
+    totalCardsRemaining += pair.second;
+  }
+
+  GameState state{
+      playerHand,
+      dealerHand.getCards()[0],
+      dealerHand,
+      convertMapToRankCounts(remainingCardCounts),
+      totalCardsRemaining,
+      num_decks,
+      dealerCheckedForBJ,
+      false,  // wasSplit
+      1       // numPlayerHands
+  };
+
+  return state;
+}
+
 double BlackjackGame::calculateEVForHit(const GameState& state) const {
+  double errorBound;
+  return calculateEVForHit(state, errorBound);
+}
+
+double BlackjackGame::calculateEVForHit(const GameState& state,
+                                        double& errorBound, double mustBeat,
+                                        PayoutMoments* moments) const {
+  errorBound = 0.0;
   // If player hand is already 21+, hitting is an invalid action
   if (state.playerHand.getValue() >= 21) {
     return std::nan("");
   }
 
+  // Upper bound on the cards not expanded yet, used to give up early
+  bool pruning = mustBeat > kNoTarget;
+  double pendingBound = 0.0;
+  if (pruning) {
+    for (int r = 1; r <= 13; ++r) {
+      Card::Rank rank = static_cast<Card::Rank>(r);
+      if (state.remainingCardCounts[r] > 0) {
+        pendingBound += getCardDrawProbability(state, rank) *
+                        getUpperBoundAfterCard(state, rank);
+      }
+    }
+    if (pendingBound + kPruneMargin < mustBeat) {
+      stats.actionsPruned++;
+      return std::nan("");
+    }
+  }
+
   double hitEV = 0.0;
+  if (moments) {
+    *moments = {0.0, 0.0};
+  }
   // Iterate through all ranks for the next possible card
-  for (const auto& pair : state.remainingCardCounts) {
-    if (pair.second > 0) {
-      double probDrawCard = getCardDrawProbability(state, pair.first);
+  for (int r = 1; r <= 13; ++r) {
+    Card::Rank rank = static_cast<Card::Rank>(r);
+    if (state.remainingCardCounts[r] > 0) {
+      double probDrawCard = getCardDrawProbability(state, rank);
 
       if (probDrawCard == 0.0) {
         continue;
       }
 
       // Get new GameState for after card is dealt
-      GameState newState = getGameStateMinusCardToPlayer(state, pair.first);
+      GameState newState = getGameStateMinusCardToPlayer(state, rank);
+      newState.reachProbability = state.reachProbability * probDrawCard;
 
       // Add P(drawing this card) * EV of optimal play from this point
-      hitEV += probDrawCard * calculateEVForOptimalStrategy(newState).optimalEV;
+      EVResult subResult = calculateEVForOptimalStrategy(newState);
+      hitEV += probDrawCard * subResult.optimalEV;
+      errorBound += probDrawCard * subResult.errorBound;
+      if (moments) {
+        moments->second += probDrawCard * subResult.optimalMoments.second;
+        moments->third += probDrawCard * subResult.optimalMoments.third;
+      }
+
+      if (pruning) {
+        pendingBound -=
+            probDrawCard * getUpperBoundAfterCard(state, rank);
+        if (hitEV + pendingBound + kPruneMargin < mustBeat) {
+          stats.actionsPruned++;
+          return std::nan("");
+        }
+      }
     }
   }
   return hitEV;
 }
 
 double BlackjackGame::calculateEVForStand(const GameState& state) const {
-  DealerOutcomeProbabilities outcomeProbs = calcDealerOutcomeProbs(state);
+  double errorBound;
+  return calculateEVForStand(state, errorBound);
+}
 
+double BlackjackGame::calculateEVForStand(const GameState& state,
+                                          double& errorBound,
+                                          PayoutMoments* moments) const {
+  errorBound = 0.0;
   if (state.playerHand.isBust()) {
+    if (moments) {
+      *moments = {1.0, -1.0};
+    }
     return -1.0;
   }
 
+  const StandMemoEntry& stand = getStandEVs(state);
+  // Every total below 17 loses to the same dealer outcomes
+  int index = state.playerHand.isBlackjack()
+                  ? 6
+                  : std::max(state.playerHand.getValue(), 16) - 16;
+  if (moments) {
+    *moments = {stand.standSecondMoments[index],
+                stand.standThirdMoments[index]};
+    // An estimated dealer distribution has no moments to give
+    if (stand.truncatedMass > 0.0) {
+      *moments = PayoutMoments{};
+    }
+  }
   if (state.playerHand.isBlackjack()) {
-    // Win with blackjack payout unless dealer also has blackjack (push).
-    return outcomeProbs.prob_blackjack * 0.0 +
-           (1 - outcomeProbs.prob_blackjack) * blackjackPayout;
+    // Estimated dealer outcomes can only move the EV within the payout range
+    errorBound = blackjackPayout * stand.truncatedMass;
+  } else {
+    errorBound = 2.0 * stand.truncatedMass;
+  }
+  return stand.standEVs[index];
+}
+
+const BlackjackGame::StandMemoEntry& BlackjackGame::getStandEVs(
+    const GameState& state) const {
+  DealerMemoKey key = getDealerMemoKey(
+      state, convertToDeckCounts(state.remainingCardCounts));
+
+  // Check if cache contains result
+  double tolerance = getTolerance(state);
+  stats.standMemoLookups++;
+  const StandMemoEntry* cached = memos->stand.find(key);
+  if (cached && cached->tolerance <= tolerance) {
+    stats.standMemoHits++;
+    validateStandHit(state, *cached);
+    return *cached;
+  }
+  if (!sharedMemos.empty()) {
+    const Memos* shard = sharedMemos[getMemoShard(
+        std::get<DeckCounts>(key), sharedMemos.size())];
+    const StandMemoEntry* shared = shard->stand.find(key);
+    if (shared && shared->tolerance <= tolerance) {
+      stats.standMemoHits++;
+      validateStandHit(state, *shared);
+      return *shared;
+    }
+  }
+
+  DealerOutcomeProbabilities outcomeProbs;
+  {
+    EnginePhase::Scope phase(EnginePhase::Phase::DealerDistribution);
+    outcomeProbs = calcDealerOutcomeProbs(state);
   }
+  StandMemoEntry& stored = memos->stand[key];
+  stored = makeStandMemoEntry(outcomeProbs, tolerance);
+  return stored;
+}
 
-  double standEV = 0.0;
-  int playerScore = state.playerHand.getValue();
+BlackjackGame::StandMemoEntry BlackjackGame::makeStandMemoEntry(
+    const DealerOutcomeProbabilities& outcomeProbs, double tolerance) const {
+  StandMemoEntry entry;
+  entry.truncatedMass = outcomeProbs.truncatedMass;
+  entry.tolerance = tolerance;
 
   // Sum the EV by weighting the payout of each possible dealer outcome by its
   // probability. The calculatePayout function handles win/loss/push logic.
-  standEV +=
-      outcomeProbs.prob_17 * calculatePayout(playerScore, 17, false, false);
-  standEV +=
-      outcomeProbs.prob_18 * calculatePayout(playerScore, 18, false, false);
-  standEV +=
-      outcomeProbs.prob_19 * calculatePayout(playerScore, 19, false, false);
-  standEV +=
-      outcomeProbs.prob_20 * calculatePayout(playerScore, 20, false, false);
-  standEV +=
-      outcomeProbs.prob_21 * calculatePayout(playerScore, 21, false, false);
-  standEV += outcomeProbs.prob_blackjack *
-             calculatePayout(playerScore, 21, false, true);
-  standEV +=
-      outcomeProbs.prob_bust * calculatePayout(playerScore, 22, false, false);
-
-  return standEV;
+  // The second and third moments weight the squared and cubed payouts the
+  // same way, so they come from the same outcomes at little extra cost.
+  for (int playerScore = 16; playerScore <= 21; ++playerScore) {
+    double standEV = 0.0;
+    double secondMoment = 0.0;
+    double thirdMoment = 0.0;
+    auto addOutcome = [&](double probability, double payout) {
+      standEV += probability * payout;
+      secondMoment += probability * payout * payout;
+      thirdMoment += probability * payout * payout * payout;
+    };
+    addOutcome(outcomeProbs.prob_17,
+               calculatePayout(playerScore, 17, false, false));
+    addOutcome(outcomeProbs.prob_18,
+               calculatePayout(playerScore, 18, false, false));
+    addOutcome(outcomeProbs.prob_19,
+               calculatePayout(playerScore, 19, false, false));
+    addOutcome(outcomeProbs.prob_20,
+               calculatePayout(playerScore, 20, false, false));
+    addOutcome(outcomeProbs.prob_21,
+               calculatePayout(playerScore, 21, false, false));
+    addOutcome(outcomeProbs.prob_blackjack,
+               calculatePayout(playerScore, 21, false, true));
+    addOutcome(outcomeProbs.prob_bust,
+               calculatePayout(playerScore, 22, false, false));
+    entry.standEVs[playerScore - 16] = standEV;
+    entry.standSecondMoments[playerScore - 16] = secondMoment;
+    entry.standThirdMoments[playerScore - 16] = thirdMoment;
+  }
+  // Win with blackjack payout unless dealer also has blackjack (push).
+  double blackjackWin = 1 - outcomeProbs.prob_blackjack;
+  entry.standEVs[6] =
+      outcomeProbs.prob_blackjack * 0.0 + blackjackWin * blackjackPayout;
+  entry.standSecondMoments[6] = blackjackWin * blackjackPayout * blackjackPayout;
+  entry.standThirdMoments[6] =
+      entry.standSecondMoments[6] * blackjackPayout;
+  return entry;
 }
 
 double BlackjackGame::calculateEVForSplit(const GameState& state) const {
-  if (!state.playerHand.canSplit() || state.numPlayerHands >= maxSplits + 1) {
-    return std::nan("");
-  }
+  double errorBound;
+  return calculateEVForSplit(state, errorBound);
+}
 
-  // If player hand is a soft 12 (Ace + Ace) and splitting aces is not allowed
-  if (state.playerHand.getValue() == 12 && state.playerHand.isSoft() &&
-      !canSplitAces) {
+double BlackjackGame::calculateEVForSplit(const GameState& state,
+                                          double& errorBound, double mustBeat,
+                                          PayoutMoments* moments) const {
+  errorBound = 0.0;
+  if (!canSplitHand(state.playerHand, state.numPlayerHands)) {
     return std::nan("");
   }
+  EnginePhase::Scope phase(EnginePhase::Phase::SplitEvaluation);
 
   GameState singleHandState =
-      getGameStateAfterSplit(state, state.playerHand.getCards().at(0));
-  double singleHandEV = 0.0;
+      getGameStateAfterSplit(state, state.playerHand.getCards()[0]);
+
+  // Upper bound on the cards not expanded yet, used to give up early
+  bool pruning = mustBeat > kNoTarget;
+  double pendingBound = 0.0;
+  if (pruning) {
+    for (int r = 1; r <= 13; ++r) {
+      Card::Rank rank = static_cast<Card::Rank>(r);
+      if (singleHandState.remainingCardCounts[r] > 0) {
+        pendingBound += getCardDrawProbability(singleHandState, rank) *
+                        getUpperBoundAfterCard(singleHandState, rank);
+      }
+    }
+    if (2 * pendingBound + kPruneMargin < mustBeat) {
+      stats.actionsPruned++;
+      return std::nan("");
+    }
+  }
 
-  for (const auto& pair : singleHandState.remainingCardCounts) {
-    if (pair.second > 0) {
-      double probDrawCard = getCardDrawProbability(singleHandState, pair.first);
+  double singleHandEV = 0.0;
+  PayoutMoments singleHandMoments{0.0, 0.0};
+  for (int r = 1; r <= 13; ++r) {
+    Card::Rank rank = static_cast<Card::Rank>(r);
+    if (singleHandState.remainingCardCounts[r] > 0) {
+      double probDrawCard = getCardDrawProbability(singleHandState, rank);
 
       if (probDrawCard == 0.0) {
         continue;
       }
 
       GameState newState =
-          getGameStateMinusCardToPlayer(singleHandState, pair.first);
+          getGameStateMinusCardToPlayer(singleHandState, rank);
+      newState.reachProbability = state.reachProbability * probDrawCard;
+
+      EVResult subResult = calculateEVForOptimalStrategy(newState);
+      singleHandEV += probDrawCard * subResult.optimalEV;
+      errorBound += 2 * probDrawCard * subResult.errorBound;
+      if (moments) {
+        singleHandMoments.second +=
+            probDrawCard * subResult.optimalMoments.second;
+        singleHandMoments.third +=
+            probDrawCard * subResult.optimalMoments.third;
+      }
 
-      singleHandEV +=
-          probDrawCard * calculateEVForOptimalStrategy(newState).optimalEV;
+      if (pruning) {
+        pendingBound -=
+            probDrawCard * getUpperBoundAfterCard(singleHandState, rank);
+        if (2 * (singleHandEV + pendingBound) + kPruneMargin < mustBeat) {
+          stats.actionsPruned++;
+          return std::nan("");
+        }
+      }
     }
   }
   // Since splitting creates two hands, we multiply the single hand EV by 2.
   // This is not perfectly accurate, but it gives a very close approximation and
   // runs in a reasonable time frame (calculating exact EV would be extremely
   // computationally expensive).
+  if (moments) {
+    // Moments of the sum of two independent copies of the single hand
+    double mean = singleHandEV;
+    moments->second = 2 * singleHandMoments.second + 2 * mean * mean;
+    moments->third =
+        2 * singleHandMoments.third + 6 * mean * singleHandMoments.second;
+  }
   return 2 * singleHandEV;
 }
 
 double BlackjackGame::calculateEVForDouble(const GameState& state) const {
+  double errorBound;
+  return calculateEVForDouble(state, errorBound);
+}
+
+double BlackjackGame::calculateEVForDouble(const GameState& state,
+                                           double& errorBound, double mustBeat,
+                                           PayoutMoments* moments) const {
+  errorBound = 0.0;
   if (state.playerHand.getCards().size() != 2 ||
       state.playerHand.getValue() == 21) {
     return std::nan("");
@@ -324,20 +747,61 @@ double BlackjackGame::calculateEVForDouble(const GameState& state) const {
     return std::nan("");
   }
 
+  // Upper bound on the cards not expanded yet, used to give up early
+  bool pruning = mustBeat > kNoTarget;
+  double pendingBound = 0.0;
+  if (pruning) {
+    for (int r = 1; r <= 13; ++r) {
+      Card::Rank rank = static_cast<Card::Rank>(r);
+      if (state.remainingCardCounts[r] > 0) {
+        pendingBound += 2 * getCardDrawProbability(state, rank) *
+                        getUpperBoundAfterCard(state, rank);
+      }
+    }
+    if (pendingBound + kPruneMargin < mustBeat) {
+      stats.actionsPruned++;
+      return std::nan("");
+    }
+  }
+
   double doubleEV = 0.0;
+  if (moments) {
+    *moments = {0.0, 0.0};
+  }
   // Iterate through all ranks for the next possible card
-  for (const auto& pair : state.remainingCardCounts) {
-    if (pair.second > 0) {
-      double probDrawCard = getCardDrawProbability(state, pair.first);
+  for (int r = 1; r <= 13; ++r) {
+    Card::Rank rank = static_cast<Card::Rank>(r);
+    if (state.remainingCardCounts[r] > 0) {
+      double probDrawCard = getCardDrawProbability(state, rank);
 
       if (probDrawCard == 0.0) {
         continue;
       }
 
       // Get new GameState for after card is dealt
-      GameState newState = getGameStateMinusCardToPlayer(state, pair.first);
+      GameState newState = getGameStateMinusCardToPlayer(state, rank);
+      newState.reachProbability = state.reachProbability * probDrawCard;
+
+      double standError;
+      PayoutMoments standMoments;
+      doubleEV += 2 * probDrawCard *
+                  calculateEVForStand(newState, standError,
+                                      moments ? &standMoments : nullptr);
+      errorBound += 2 * probDrawCard * standError;
+      if (moments) {
+        // The doubled bet scales the payout by 2
+        moments->second += 4 * probDrawCard * standMoments.second;
+        moments->third += 8 * probDrawCard * standMoments.third;
+      }
 
-      doubleEV += 2 * probDrawCard * calculateEVForStand(newState);
+      if (pruning) {
+        pendingBound -=
+            2 * probDrawCard * getUpperBoundAfterCard(state, rank);
+        if (doubleEV + pendingBound + kPruneMargin < mustBeat) {
+          stats.actionsPruned++;
+          return std::nan("");
+        }
+      }
     }
   }
   return doubleEV;
@@ -390,129 +854,1026 @@ BlackjackGame::EVResult BlackjackGame::calculateEVForOptimalStrategy(
     const GameState& state) const {
   // If player hand is busted, EV is always -1
   if (state.playerHand.isBust()) {
-    return EVResult{-1.0, -1.0, -1.0, -1.0, -1.0, PlayerAction::None, -1.0};
+    EVResult bust;
+    bust.hitEV = bust.standEV = bust.splitEV = bust.doubleEV =
+        bust.surrenderEV = bust.optimalEV = -1.0;
+    bust.optimalAction = PlayerAction::None;
+    bust.optimalMoments = {1.0, -1.0};
+    return bust;
   }
-  // Create a unique player key for the player's hand
-  PlayerMemoKey playerKey(
-      state.playerHand.getValue(), state.playerHand.isSoft(),
-      state.playerHand.canSplit(), state.dealerUpcard.getValue(),
-      state.wasSplit, state.dealerChecked, state.numPlayerHands,
-      convertMapToDeckCount(state.remainingCardCounts));
+  // Create a key shared by every state with the same sub-tree
+  PlayerMemoKey playerKey = getPlayerMemoKey(state);
 
-  // Check if cache contains result
-  if (PlayerMemo_.count(playerKey)) {
-    return PlayerMemo_[playerKey];
+  // Check if cache contains result. Compact entries only hold what a parent
+  // state reads, so the state a query starts from is always expanded.
+  double tolerance = getTolerance(state);
+  EVResult result;
+  double entryTolerance;
+  if (memoStorage == MemoStorage::Full || expandDepth > 0) {
+    stats.playerMemoLookups++;
+    if (findPlayerResult(playerKey, tolerance, result, entryTolerance)) {
+      stats.playerMemoHits++;
+      if (validateMemoKeys && entryTolerance == tolerance) {
+        // The entry may come from a state that differs in dropped fields, so
+        // solve this one again and compare what the entry kept
+        stats.memoValidations++;
+        EVResult expanded = expandPlayerState(state);
+        if (memoStorage != MemoStorage::Full) {
+          expanded = unpackPlayerResult(packPlayerResult(expanded, tolerance));
+        }
+        if (!isSameResult(result, expanded)) {
+          stats.memoMismatches++;
+        }
+      }
+      return result;
+    }
   }
 
+  result = expandPlayerState(state);
+  storePlayerResult(playerKey, result, tolerance);
+  return result;
+}
+
+BlackjackGame::EVResult BlackjackGame::expandPlayerState(
+    const GameState& state) const {
+  checkDeadline();
+  stats.playerNodes++;
+
+  // Replace sub-trees that are too unlikely to matter with an estimate
+  if (state.reachProbability < epsilon) {
+    return estimateEVForOptimalStrategy(state);
+  }
+
+  // Only the actions of the state a query starts from are traced
+  struct DepthGuard {
+    int& depth;
+    explicit DepthGuard(int& counter) : depth(++counter) {}
+    ~DepthGuard() { --depth; }
+  } depthGuard(expandDepth);
+  bool traceActions = expandDepth == 1 && TraceRecorder::isEnabled();
+  // Allocations are counted over the whole search of a query
+  bool countAllocations = AllocationCounter::kEnabled && expandDepth == 1;
+  AllocationCounter::Counts allocationsBefore;
+  if (countAllocations) {
+    allocationsBefore = AllocationCounter::getThreadCounts();
+  }
+  auto traced = [traceActions](const char* action, auto calculate) {
+    if (!traceActions) {
+      return calculate();
+    }
+    TraceRecorder::Span span(action, "action");
+    return calculate();
+  };
+
   EVResult result;
-  result.standEV = calculateEVForStand(state);
-  result.hitEV = calculateEVForHit(state);
-  result.doubleEV = calculateEVForDouble(state);
-  result.surrenderEV = calculateEVForSurrender(state);
-  result.splitEV = calculateEVForSplit(state);
+  double standError, hitError, doubleError, splitError;
+  auto momentsOf = [this](PayoutMoments& moments) {
+    return payoutMoments ? &moments : nullptr;
+  };
+  result.standEV = traced("stand", [&] {
+    return calculateEVForStand(state, standError,
+                               momentsOf(result.standMoments));
+  });
+  if (decisionsOnly) {
+    // Evaluate in the order actions are compared below, each against the
+    // best so far, so a skipped action could never have been chosen
+    double bestEV = result.standEV;
+    result.hitEV = traced(
+        "hit", [&] { return calculateEVForHit(state, hitError, bestEV); });
+    if (!std::isnan(result.hitEV)) bestEV = std::max(bestEV, result.hitEV);
+    result.doubleEV = traced("double", [&] {
+      return calculateEVForDouble(state, doubleError, bestEV);
+    });
+    if (!std::isnan(result.doubleEV)) {
+      bestEV = std::max(bestEV, result.doubleEV);
+    }
+    result.surrenderEV = calculateEVForSurrender(state);
+    result.splitEV = traced(
+        "split", [&] { return calculateEVForSplit(state, splitError, bestEV); });
+  } else {
+    result.hitEV = traced("hit", [&] {
+      return calculateEVForHit(state, hitError, kNoTarget,
+                               momentsOf(result.hitMoments));
+    });
+    result.doubleEV = traced("double", [&] {
+      return calculateEVForDouble(state, doubleError, kNoTarget,
+                                  momentsOf(result.doubleMoments));
+    });
+    result.surrenderEV = calculateEVForSurrender(state);
+    result.splitEV = traced("split", [&] {
+      return calculateEVForSplit(state, splitError, kNoTarget,
+                                 momentsOf(result.splitMoments));
+    });
+  }
+  if (payoutMoments) {
+    // Surrender always pays -0.5
+    result.surrenderMoments = {0.25, -0.125};
+    // Actions that aren't allowed have no moments
+    if (std::isnan(result.hitEV)) result.hitMoments = PayoutMoments{};
+    if (std::isnan(result.doubleEV)) result.doubleMoments = PayoutMoments{};
+    if (std::isnan(result.splitEV)) result.splitMoments = PayoutMoments{};
+    if (std::isnan(result.surrenderEV)) {
+      result.surrenderMoments = PayoutMoments{};
+    }
+  }
+
+  // The optimal EV is off by at most the largest error of any action, so
+  // that bound holds for every EV in the result
+  result.errorBound = standError;
+  if (!std::isnan(result.hitEV)) {
+    result.errorBound = std::max(result.errorBound, hitError);
+  }
+  if (!std::isnan(result.doubleEV)) {
+    result.errorBound = std::max(result.errorBound, doubleError);
+  }
+  if (!std::isnan(result.splitEV)) {
+    result.errorBound = std::max(result.errorBound, splitError);
+  }
 
   // Record the optimal action and its EV in the result
+  chooseOptimalAction(result);
+
+  if (countAllocations) {
+    AllocationCounter::Counts allocationsAfter =
+        AllocationCounter::getThreadCounts();
+    stats.heapAllocations +=
+        allocationsAfter.allocations - allocationsBefore.allocations;
+    stats.heapBytes += allocationsAfter.bytes - allocationsBefore.bytes;
+  }
+  return result;
+}
+
+void BlackjackGame::chooseOptimalAction(EVResult& result) {
   result.optimalEV = result.standEV;
   result.optimalAction = PlayerAction::Stand;
+  result.optimalMoments = result.standMoments;
 
   if (!std::isnan(result.hitEV) && result.hitEV > result.optimalEV) {
     result.optimalEV = result.hitEV;
     result.optimalAction = PlayerAction::Hit;
+    result.optimalMoments = result.hitMoments;
   }
   if (!std::isnan(result.doubleEV) && result.doubleEV > result.optimalEV) {
     result.optimalEV = result.doubleEV;
     result.optimalAction = PlayerAction::Double;
+    result.optimalMoments = result.doubleMoments;
   }
   if (!std::isnan(result.splitEV) && result.splitEV > result.optimalEV) {
     result.optimalEV = result.splitEV;
     result.optimalAction = PlayerAction::Split;
+    result.optimalMoments = result.splitMoments;
   }
   if (!std::isnan(result.surrenderEV) &&
       result.surrenderEV > result.optimalEV) {
     result.optimalEV = result.surrenderEV;
     result.optimalAction = PlayerAction::Surrender;
+    result.optimalMoments = result.surrenderMoments;
   }
-  PlayerMemo_[playerKey] = result;
+}
 
-  return result;
+BlackjackGame::PlayerMemoKey BlackjackGame::getPlayerMemoKey(
+    const GameState& state) const {
+  // Fields that can't change any option left in the sub-tree get a fixed
+  // value: the hand count only limits splitting this hand, wasSplit only
+  // limits doubling it without double after split, and the peek only
+  // changes the hole card odds and the surrender window under a 10 or Ace
+  bool isTwoCardHand = state.playerHand.getCards().size() == 2;
+  bool canSplit = canSplitHand(state.playerHand, state.numPlayerHands);
+  bool dealerCanHaveBlackjack = state.dealerUpcard.getValue() >= 10;
+  return PlayerMemoKey(
+      state.playerHand.getValue(), state.playerHand.isSoft(), canSplit,
+      isTwoCardHand, state.dealerUpcard.getValue(),
+      state.wasSplit && isTwoCardHand && !canDoubleAfterSplit,
+      state.dealerChecked && dealerCanHaveBlackjack,
+      canSplit ? state.numPlayerHands : 0,
+      convertToDeckCounts(state.remainingCardCounts));
+}
+
+bool BlackjackGame::canSplitHand(const Hand& hand, int numPlayerHands) const {
+  if (!hand.canSplit() || numPlayerHands >= maxSplits + 1) {
+    return false;
+  }
+  // A pair of aces can only be split if the rules allow it
+  return hand.getCards()[0].getRank() != Card::Rank::Ace || canSplitAces;
+}
+
+bool BlackjackGame::isSameResult(const EVResult& a, const EVResult& b) {
+  // The memo key counts 10s, jacks, queens and kings together, so equal
+  // states can still sum their draws in a different order
+  auto same = [](double x, double y) {
+    return (std::isnan(x) && std::isnan(y)) || std::abs(x - y) <= 1e-12;
+  };
+  return same(a.hitEV, b.hitEV) && same(a.standEV, b.standEV) &&
+         same(a.splitEV, b.splitEV) && same(a.doubleEV, b.doubleEV) &&
+         same(a.surrenderEV, b.surrenderEV) &&
+         same(a.optimalEV, b.optimalEV) && same(a.errorBound, b.errorBound) &&
+         same(a.optimalMoments.second, b.optimalMoments.second) &&
+         same(a.optimalMoments.third, b.optimalMoments.third);
 }
 
 BlackjackGame::DealerOutcomeProbabilities BlackjackGame::calcDealerOutcomeProbs(
     const GameState& state) const {
   // Key used for memo
-  DealerMemoKey key(state.dealerHand.getValue(), state.dealerHand.isSoft(),
-                    convertMapToDeckCount(state.remainingCardCounts));
+  DeckCounts remainingCounts = convertToDeckCounts(state.remainingCardCounts);
+
+  // The upcard alone is looked up in the precomputed table when it covers
+  // this shoe
+  if (dealerTable && state.dealerHand.getCards().size() == 1) {
+    const DealerOutcomeProbabilities* outcomes = dealerTable->find(
+        state.dealerUpcard.getValue(), state.dealerChecked, remainingCounts);
+    if (outcomes) {
+      stats.dealerTableHits++;
+      return *outcomes;
+    }
+  }
+
+  DealerMemoKey key = getDealerMemoKey(state, remainingCounts);
 
   // Check if cache contains result
-  if (DealerMemo_.count(key)) {
-    return DealerMemo_[key];
+  double tolerance = getTolerance(state);
+  stats.dealerMemoLookups++;
+  DealerOutcomeProbabilities outcomes;
+  if (findDealerOutcomes(key, tolerance, outcomes)) {
+    stats.dealerMemoHits++;
+    validateDealerHit(state, outcomes);
+    return outcomes;
+  }
+  checkDeadline();
+  stats.dealerNodes++;
+
+  // The dealer stands or has busted
+  if (getFinalDealerOutcomes(state.dealerHand, outcomes)) {
+    storeDealerOutcomes(key, outcomes, tolerance);
+    return outcomes;
+  }
+
+  // Replace sub-trees that are too unlikely to matter with an estimate
+  if (state.reachProbability < epsilon) {
+    outcomes = estimateDealerOutcomeProbs(state);
+    outcomes.truncatedMass = 1.0;
+    storeDealerOutcomes(key, outcomes, tolerance);
+    return outcomes;
+  }
+
+  // Iterate through all ranks for the next possible card
+  for (int r = 1; r <= 13; ++r) {
+    Card::Rank rank = static_cast<Card::Rank>(r);
+    if (state.remainingCardCounts[r] > 0) {
+      double probDrawCard = getCardDrawProbability(state, rank, true);
+
+      if (probDrawCard == 0.0) {
+        continue;
+      }
+
+      // Get new GameState for after card is dealt
+      GameState newState = getGameStateMinusCardToDealer(state, rank);
+      newState.reachProbability = state.reachProbability * probDrawCard;
+
+      // Recursively call this method with the new GameState
+      DealerOutcomeProbabilities subOutcomes = calcDealerOutcomeProbs(newState);
+
+      addWeightedOutcomes(outcomes, probDrawCard, subOutcomes);
+    }
+  }
+  // Add situation to memo and return outcomes
+  storeDealerOutcomes(key, outcomes, tolerance);
+  return outcomes;
+}
+
+BlackjackGame::DealerOutcomeProbabilities
+BlackjackGame::solveDealerWithoutMemo(const GameState& state) const {
+  ReferenceDealerKey key = {};
+  for (const Card& card : state.dealerHand.getCards()) {
+    key[card.getValue() == 11 ? 0 : card.getValue() - 1]++;
+  }
+  DeckCounts remainingCounts = convertToDeckCounts(state.remainingCardCounts);
+  std::copy(remainingCounts.begin(), remainingCounts.end(), key.begin() + 10);
+  key[20] = state.dealerUpcard.getValue();
+  key[21] = state.dealerChecked;
+  auto found = referenceDealerOutcomes.find(key);
+  if (found != referenceDealerOutcomes.end()) {
+    return found->second;
   }
 
   DealerOutcomeProbabilities outcomes;
+  if (getFinalDealerOutcomes(state.dealerHand, outcomes)) {
+    referenceDealerOutcomes.emplace(key, outcomes);
+    return outcomes;
+  }
+  for (int r = 1; r <= 13; ++r) {
+    Card::Rank rank = static_cast<Card::Rank>(r);
+    if (state.remainingCardCounts[r] > 0) {
+      double probDrawCard = getCardDrawProbability(state, rank, true);
+      if (probDrawCard == 0.0) {
+        continue;
+      }
+      addWeightedOutcomes(
+          outcomes, probDrawCard,
+          solveDealerWithoutMemo(getGameStateMinusCardToDealer(state, rank)));
+    }
+  }
+  referenceDealerOutcomes.emplace(key, outcomes);
+  return outcomes;
+}
+
+BlackjackGame::DealerOutcomeProbabilities BlackjackGame::getStoredOutcomes(
+    const DealerOutcomeProbabilities& outcomes, double& maxDifference) const {
+  maxDifference = 1e-12;
+  switch (memoStorage) {
+    case MemoStorage::Compact:
+      return unpackDealerOutcomes(packDealerOutcomes<double>(outcomes, 0.0));
+    case MemoStorage::Float:
+      maxDifference = 1e-6;
+      return unpackDealerOutcomes(packDealerOutcomes<float>(outcomes, 0.0));
+    case MemoStorage::Full:
+      break;
+  }
+  return outcomes;
+}
+
+void BlackjackGame::validateDealerHit(
+    const GameState& state, const DealerOutcomeProbabilities& cached) const {
+  if (!validateMemoKeys || epsilon > 0.0) {
+    return;
+  }
+  stats.memoValidations++;
+  double maxDifference;
+  DealerOutcomeProbabilities solved =
+      getStoredOutcomes(solveDealerWithoutMemo(state), maxDifference);
+  const double solvedProbs[] = {solved.prob_17,        solved.prob_18,
+                                solved.prob_19,        solved.prob_20,
+                                solved.prob_21,        solved.prob_blackjack,
+                                solved.prob_bust};
+  const double cachedProbs[] = {cached.prob_17,        cached.prob_18,
+                                cached.prob_19,        cached.prob_20,
+                                cached.prob_21,        cached.prob_blackjack,
+                                cached.prob_bust};
+  for (int i = 0; i < 7; ++i) {
+    if (std::abs(solvedProbs[i] - cachedProbs[i]) > maxDifference) {
+      stats.memoMismatches++;
+      return;
+    }
+  }
+}
+
+void BlackjackGame::validateStandHit(const GameState& state,
+                                     const StandMemoEntry& cached) const {
+  if (!validateMemoKeys || epsilon > 0.0) {
+    return;
+  }
+  stats.memoValidations++;
+  // The entry may have been made from a dealer memo hit, so it's only as
+  // precise as the stored outcomes
+  double maxDifference;
+  StandMemoEntry solved = makeStandMemoEntry(
+      getStoredOutcomes(solveDealerWithoutMemo(state), maxDifference), 0.0);
+  for (size_t i = 0; i < solved.standEVs.size(); ++i) {
+    if (std::abs(solved.standEVs[i] - cached.standEVs[i]) > maxDifference ||
+        std::abs(solved.standSecondMoments[i] -
+                 cached.standSecondMoments[i]) > maxDifference ||
+        std::abs(solved.standThirdMoments[i] - cached.standThirdMoments[i]) >
+            maxDifference) {
+      stats.memoMismatches++;
+      return;
+    }
+  }
+}
+
+bool BlackjackGame::findDealerOutcomes(
+    const DealerMemoKey& key, double tolerance,
+    DealerOutcomeProbabilities& outcomes) const {
+  auto findCompact = [&](const auto& memo) {
+    const auto* entry = memo.find(packDealerMemoKey(key));
+    if (entry && entry->tolerance <= tolerance) {
+      outcomes = unpackDealerOutcomes(*entry);
+      return true;
+    }
+    return false;
+  };
+  switch (memoStorage) {
+    case MemoStorage::Compact:
+      return findCompact(memos->compactDealer);
+    case MemoStorage::Float:
+      return findCompact(memos->floatDealer);
+    case MemoStorage::Full:
+      break;
+  }
+
+  const DealerMemoEntry* cached = memos->dealer.find(key);
+  if (cached && cached->tolerance <= tolerance) {
+    outcomes = cached->outcomes;
+    return true;
+  }
+  if (!sharedMemos.empty()) {
+    const Memos* shard = sharedMemos[getMemoShard(
+        std::get<DeckCounts>(key), sharedMemos.size())];
+    const DealerMemoEntry* shared = shard->dealer.find(key);
+    if (shared && shared->tolerance <= tolerance) {
+      outcomes = shared->outcomes;
+      return true;
+    }
+  }
+  return false;
+}
+
+void BlackjackGame::storeDealerOutcomes(
+    const DealerMemoKey& key, const DealerOutcomeProbabilities& outcomes,
+    double tolerance) const {
+  auto store = [tolerance](auto& memo, const auto& memoKey,
+                           const auto& entry) {
+    auto [stored, added] = memo.try_emplace(memoKey, entry);
+    if (!added && stored->tolerance > tolerance) {
+      *stored = entry;
+    }
+  };
+  switch (memoStorage) {
+    case MemoStorage::Full:
+      store(memos->dealer, key, DealerMemoEntry{outcomes, tolerance});
+      break;
+    case MemoStorage::Compact:
+      store(memos->compactDealer, packDealerMemoKey(key),
+            packDealerOutcomes<double>(outcomes, tolerance));
+      break;
+    case MemoStorage::Float:
+      store(memos->floatDealer, packDealerMemoKey(key),
+            packDealerOutcomes<float>(outcomes, tolerance));
+      break;
+  }
+}
+
+bool BlackjackGame::findPlayerResult(const PlayerMemoKey& key,
+                                     double tolerance, EVResult& result,
+                                     double& entryTolerance) const {
+  if (memoStorage == MemoStorage::Full) {
+    auto cached = memos->player.find(key);
+    if (cached == memos->player.end() || cached->second.tolerance > tolerance) {
+      return false;
+    }
+    result = cached->second.result;
+    entryTolerance = cached->second.tolerance;
+    return true;
+  }
+  auto cached = memos->compactPlayer.find(key);
+  if (cached == memos->compactPlayer.end() ||
+      cached->second.tolerance > tolerance) {
+    return false;
+  }
+  result = unpackPlayerResult(cached->second);
+  entryTolerance = cached->second.tolerance;
+  return true;
+}
+
+void BlackjackGame::storePlayerResult(const PlayerMemoKey& key,
+                                      const EVResult& result,
+                                      double tolerance) const {
+  if (memoStorage == MemoStorage::Full) {
+    memos->player[key] = {result, tolerance};
+  } else {
+    memos->compactPlayer[key] = packPlayerResult(result, tolerance);
+  }
+}
+
+bool BlackjackGame::hasPlayerResult(const PlayerMemoKey& key) const {
+  return memoStorage == MemoStorage::Full ? memos->player.count(key) > 0
+                                          : memos->compactPlayer.count(key) > 0;
+}
+
+void BlackjackGame::prefetchDealerSlot(const DealerMemoKey& key) const {
+  switch (memoStorage) {
+    case MemoStorage::Full:
+      memos->dealer.prefetch(key);
+      break;
+    case MemoStorage::Compact:
+      memos->compactDealer.prefetch(packDealerMemoKey(key));
+      break;
+    case MemoStorage::Float:
+      memos->floatDealer.prefetch(packDealerMemoKey(key));
+      break;
+  }
+}
+
+void BlackjackGame::prefetchDealerEntry(const DealerMemoKey& key) const {
+  switch (memoStorage) {
+    case MemoStorage::Full:
+      memos->dealer.prefetchEntry(key);
+      break;
+    case MemoStorage::Compact:
+      memos->compactDealer.prefetchEntry(packDealerMemoKey(key));
+      break;
+    case MemoStorage::Float:
+      memos->floatDealer.prefetchEntry(packDealerMemoKey(key));
+      break;
+  }
+}
+
+BlackjackGame::CompactDealerMemoKey BlackjackGame::packDealerMemoKey(
+    const DealerMemoKey& key) {
+  CompactDealerMemoKey packed;
+  const DeckCounts& counts = std::get<DeckCounts>(key);
+  for (size_t i = 0; i < counts.size(); ++i) {
+    packed.counts[i] = static_cast<uint8_t>(counts[i]);
+  }
+  packed.score = static_cast<uint8_t>(std::get<0>(key));
+  packed.flags = static_cast<uint8_t>(std::get<1>(key) | std::get<2>(key) << 1);
+  return packed;
+}
+
+template <typename Probability>
+BlackjackGame::CompactDealerMemoEntry<Probability>
+BlackjackGame::packDealerOutcomes(const DealerOutcomeProbabilities& outcomes,
+                                  double tolerance) {
+  CompactDealerMemoEntry<Probability> entry;
+  entry.outcomes = {static_cast<Probability>(outcomes.prob_17),
+                    static_cast<Probability>(outcomes.prob_18),
+                    static_cast<Probability>(outcomes.prob_19),
+                    static_cast<Probability>(outcomes.prob_20),
+                    static_cast<Probability>(outcomes.prob_21),
+                    static_cast<Probability>(outcomes.prob_blackjack)};
+  entry.truncatedMass = static_cast<Probability>(outcomes.truncatedMass);
+  if (entry.truncatedMass < outcomes.truncatedMass) {
+    entry.truncatedMass = std::nextafter(
+        entry.truncatedMass, std::numeric_limits<Probability>::infinity());
+  }
+  entry.tolerance = tolerance;
+  return entry;
+}
+
+template <typename Probability>
+BlackjackGame::DealerOutcomeProbabilities BlackjackGame::unpackDealerOutcomes(
+    const CompactDealerMemoEntry<Probability>& entry) {
+  DealerOutcomeProbabilities outcomes;
+  outcomes.prob_17 = entry.outcomes[0];
+  outcomes.prob_18 = entry.outcomes[1];
+  outcomes.prob_19 = entry.outcomes[2];
+  outcomes.prob_20 = entry.outcomes[3];
+  outcomes.prob_21 = entry.outcomes[4];
+  outcomes.prob_blackjack = entry.outcomes[5];
+  outcomes.prob_bust =
+      1.0 - (outcomes.prob_17 + outcomes.prob_18 + outcomes.prob_19 +
+             outcomes.prob_20 + outcomes.prob_21 + outcomes.prob_blackjack);
+  outcomes.truncatedMass = entry.truncatedMass;
+  return outcomes;
+}
+
+BlackjackGame::CompactPlayerMemoEntry BlackjackGame::packPlayerResult(
+    const EVResult& result, double tolerance) {
+  return {result.optimalEV, result.errorBound, tolerance,
+          result.optimalAction, result.optimalMoments};
+}
+
+BlackjackGame::EVResult BlackjackGame::unpackPlayerResult(
+    const CompactPlayerMemoEntry& entry) {
+  EVResult result;
+  result.hitEV = result.standEV = result.splitEV = result.doubleEV =
+      result.surrenderEV = std::nan("");
+  result.optimalAction = entry.optimalAction;
+  result.optimalEV = entry.optimalEV;
+  result.errorBound = entry.errorBound;
+  result.optimalMoments = entry.optimalMoments;
+  return result;
+}
 
+bool BlackjackGame::getFinalDealerOutcomes(
+    const Hand& dealerHand, DealerOutcomeProbabilities& outcomes) const {
   // If dealer busted
-  if (state.dealerHand.getValue() > 21) {
+  if (dealerHand.getValue() > 21) {
     outcomes.prob_bust = 1.0;
-    DealerMemo_[key] = outcomes;
-    return outcomes;
+    return true;
   }
 
   // If dealer has hard 17 or soft 17 with dealer standing soft 17s
-  if (state.dealerHand.getValue() == 17 &&
-      (!state.dealerHand.isSoft() ||
-       (state.dealerHand.isSoft() && !dealerHitsSoft17))) {
+  if (dealerHand.getValue() == 17 &&
+      (!dealerHand.isSoft() || (dealerHand.isSoft() && !dealerHitsSoft17))) {
     outcomes.prob_17 = 1.0;
-    DealerMemo_[key] = outcomes;
-    return outcomes;
+    return true;
   }
   // If dealer has 18-21
-  else if (state.dealerHand.getValue() >= 18) {
-    if (state.dealerHand.getValue() == 18) {
+  else if (dealerHand.getValue() >= 18) {
+    if (dealerHand.getValue() == 18) {
       outcomes.prob_18 = 1.0;
-    } else if (state.dealerHand.getValue() == 19) {
+    } else if (dealerHand.getValue() == 19) {
       outcomes.prob_19 = 1.0;
-    } else if (state.dealerHand.getValue() == 20) {
+    } else if (dealerHand.getValue() == 20) {
       outcomes.prob_20 = 1.0;
-    } else if (state.dealerHand.getValue() == 21) {
-      if (state.dealerHand.isBlackjack()) {
+    } else if (dealerHand.getValue() == 21) {
+      if (dealerHand.isBlackjack()) {
         outcomes.prob_blackjack = 1.0;
       } else {
         outcomes.prob_21 = 1.0;
       }
     }
-    DealerMemo_[key] = outcomes;
-    return outcomes;
+    return true;
   }
+  return false;
+}
 
-  // Iterate through all ranks for the next possible card
-  for (const auto& pair : state.remainingCardCounts) {
-    if (pair.second > 0) {
-      double probDrawCard = getCardDrawProbability(state, pair.first, true);
+void BlackjackGame::addWeightedOutcomes(
+    DealerOutcomeProbabilities& outcomes, double weight,
+    const DealerOutcomeProbabilities& subOutcomes) {
+  outcomes.prob_17 += weight * subOutcomes.prob_17;
+  outcomes.prob_18 += weight * subOutcomes.prob_18;
+  outcomes.prob_19 += weight * subOutcomes.prob_19;
+  outcomes.prob_20 += weight * subOutcomes.prob_20;
+  outcomes.prob_21 += weight * subOutcomes.prob_21;
+  outcomes.prob_bust += weight * subOutcomes.prob_bust;
+  outcomes.prob_blackjack += weight * subOutcomes.prob_blackjack;
+  outcomes.truncatedMass += weight * subOutcomes.truncatedMass;
+}
 
-      if (probDrawCard == 0.0) {
-        continue;
+namespace {
+// Adds a card value (1 for an Ace) to a hand total, counting an Ace as 11
+// when that doesn't bust the hand
+std::pair<int, bool> addCardValue(int total, bool isSoft, int value) {
+  int newTotal = total + value;
+  bool newIsSoft = isSoft;
+  if (value == 1 && newTotal + 10 <= 21) {
+    newTotal += 10;
+    newIsSoft = true;
+  }
+  if (newTotal > 21 && newIsSoft) {
+    newTotal -= 10;
+    newIsSoft = false;
+  }
+  return {newTotal, newIsSoft};
+}
+
+// Gets the probability of drawing each card value (index 1 for an Ace) from
+// a composition
+std::array<double, 11> getValueDrawProbabilities(
+    const BlackjackGame::RankCounts& remainingCardCounts,
+    int totalCardsRemaining) {
+  std::array<double, 11> probs = {};
+  if (totalCardsRemaining <= 0) {
+    return probs;
+  }
+  for (int r = 1; r <= 13; ++r) {
+    int value = Card(static_cast<Card::Rank>(r), Card::Suit::Hearts).getValue();
+    probs[value == 11 ? 1 : value] +=
+        static_cast<double>(remainingCardCounts[r]) / totalCardsRemaining;
+  }
+  return probs;
+}
+}  // namespace
+
+std::vector<BlackjackGame::EVResult> BlackjackGame::calculateEVsInterleaved(
+    const std::vector<GameState>& states, int interleave) const {
+  if (interleave > 0 && epsilon == 0.0 && !decisionsOnly && !hasDeadline) {
+    // Find the dealer distributions the searches will stand against
+    std::set<PlayerMemoKey> visited;
+    std::set<DealerMemoKey> standKeys;
+    std::vector<GameState> standStates;
+    for (const GameState& state : states) {
+      collectStandStates(state, visited, standKeys, standStates);
+    }
+
+    // Calculate them with up to `interleave` in flight, starting the next
+    // as soon as one finishes
+    EnginePhase::Scope phase(EnginePhase::Phase::DealerDistribution);
+    Interleaving::Scheduler scheduler;
+    Interleaving::Scheduler::current() = &scheduler;
+    std::vector<Interleaving::Task<bool>> inFlight;
+    size_t nextState = 0;
+    try {
+      while (nextState < standStates.size() || !inFlight.empty()) {
+        while (inFlight.size() < static_cast<size_t>(interleave) &&
+               nextState < standStates.size()) {
+          inFlight.push_back(prepareStandEVs(standStates[nextState++]));
+          inFlight.back().start();
+        }
+        scheduler.resumeNext();
+        for (size_t i = 0; i < inFlight.size();) {
+          if (inFlight[i].done()) {
+            inFlight[i].result();
+            inFlight[i] = std::move(inFlight.back());
+            inFlight.pop_back();
+          } else {
+            ++i;
+          }
+        }
       }
+    } catch (...) {
+      Interleaving::Scheduler::current() = nullptr;
+      throw;
+    }
+    Interleaving::Scheduler::current() = nullptr;
+  }
 
-      // Get new GameState for after card is dealt
-      GameState newState = getGameStateMinusCardToDealer(state, pair.first);
+  // Every stand lookup of the searches now hits the memo
+  std::vector<EVResult> results;
+  results.reserve(states.size());
+  for (const GameState& state : states) {
+    results.push_back(calculateEVForOptimalStrategy(state));
+  }
+  return results;
+}
 
-      // Recursively call this method with the new GameState
-      DealerOutcomeProbabilities subOutcomes = calcDealerOutcomeProbs(newState);
+void BlackjackGame::collectStandStates(
+    const GameState& state, std::set<PlayerMemoKey>& visited,
+    std::set<DealerMemoKey>& standKeys,
+    std::vector<GameState>& standStates) const {
+  // Skip the states the search won't expand
+  if (state.playerHand.isBust()) {
+    return;
+  }
+  PlayerMemoKey playerKey = getPlayerMemoKey(state);
+  if (hasPlayerResult(playerKey) || !visited.insert(playerKey).second) {
+    return;
+  }
+
+  DealerMemoKey standKey = getDealerMemoKey(
+      state, convertToDeckCounts(state.remainingCardCounts));
+  if (!memos->stand.find(standKey) && standKeys.insert(standKey).second) {
+    standStates.push_back(state);
+  }
 
-      outcomes.prob_17 += probDrawCard * subOutcomes.prob_17;
-      outcomes.prob_18 += probDrawCard * subOutcomes.prob_18;
-      outcomes.prob_19 += probDrawCard * subOutcomes.prob_19;
-      outcomes.prob_20 += probDrawCard * subOutcomes.prob_20;
-      outcomes.prob_21 += probDrawCard * subOutcomes.prob_21;
-      outcomes.prob_bust += probDrawCard * subOutcomes.prob_bust;
-      outcomes.prob_blackjack += probDrawCard * subOutcomes.prob_blackjack;
+  // Doubling stands on the same hands as hitting
+  if (state.playerHand.getValue() < 21) {
+    for (int r = 1; r <= 13; ++r) {
+      Card::Rank rank = static_cast<Card::Rank>(r);
+      if (state.remainingCardCounts[r] > 0 &&
+          getCardDrawProbability(state, rank) != 0.0) {
+        collectStandStates(getGameStateMinusCardToPlayer(state, rank), visited,
+                           standKeys, standStates);
+      }
     }
   }
-  // Add situation to memo and return outcomes
-  DealerMemo_[key] = outcomes;
+  if (canSplitHand(state.playerHand, state.numPlayerHands)) {
+    GameState singleHandState =
+        getGameStateAfterSplit(state, state.playerHand.getCards()[0]);
+    for (int r = 1; r <= 13; ++r) {
+      Card::Rank rank = static_cast<Card::Rank>(r);
+      if (singleHandState.remainingCardCounts[r] > 0 &&
+          getCardDrawProbability(singleHandState, rank) != 0.0) {
+        collectStandStates(
+            getGameStateMinusCardToPlayer(singleHandState, rank), visited,
+            standKeys, standStates);
+      }
+    }
+  }
+}
+
+Interleaving::Task<bool> BlackjackGame::prepareStandEVs(GameState state) const {
+  DeckCounts remainingCounts = convertToDeckCounts(state.remainingCardCounts);
+  DealerMemoKey key = getDealerMemoKey(state, remainingCounts);
+  double tolerance = getTolerance(state);
+
+  DealerOutcomeProbabilities outcomeProbs;
+  const DealerOutcomeProbabilities* tableOutcomes = nullptr;
+  if (dealerTable) {
+    tableOutcomes = dealerTable->find(state.dealerUpcard.getValue(),
+                                      state.dealerChecked, remainingCounts);
+  }
+  if (tableOutcomes) {
+    stats.dealerTableHits++;
+    outcomeProbs = *tableOutcomes;
+  } else {
+    stats.dealerMemoLookups++;
+    if (findDealerOutcomes(key, tolerance, outcomeProbs)) {
+      stats.dealerMemoHits++;
+      validateDealerHit(state, outcomeProbs);
+    } else {
+      outcomeProbs = co_await calcDealerOutcomeProbsInterleaved(state, key);
+    }
+  }
+  co_return memos->stand
+      .try_emplace(key, makeStandMemoEntry(outcomeProbs, tolerance))
+      .second;
+}
+
+Interleaving::Task<BlackjackGame::DealerOutcomeProbabilities>
+BlackjackGame::calcDealerOutcomeProbsInterleaved(GameState state,
+                                                 DealerMemoKey key) const {
+  stats.dealerNodes++;
+  double tolerance = getTolerance(state);
+  DealerOutcomeProbabilities outcomes;
+  if (getFinalDealerOutcomes(state.dealerHand, outcomes)) {
+    storeDealerOutcomes(key, outcomes, tolerance);
+    co_return outcomes;
+  }
+
+  // Start loading the memo entries of every card the dealer can draw, and
+  // let the other searches run while the index lines and then the entries
+  // arrive
+  DeckCounts remainingCounts = convertToDeckCounts(state.remainingCardCounts);
+  std::array<DealerMemoKey, 13> childKeys;
+  std::array<double, 13> probDrawCards = {};
+  for (int r = 1; r <= 13; ++r) {
+    Card::Rank rank = static_cast<Card::Rank>(r);
+    if (state.remainingCardCounts[r] > 0) {
+      probDrawCards[r - 1] = getCardDrawProbability(state, rank, true);
+      if (probDrawCards[r - 1] != 0.0) {
+        // The key of the hand after the draw, without building its state
+        int value = Card(rank, Card::Suit::Hearts).getValue();
+        auto [newTotal, newIsSoft] =
+            addCardValue(state.dealerHand.getValue(), state.dealerHand.isSoft(),
+                         value == 11 ? 1 : value);
+        DeckCounts childCounts = remainingCounts;
+        childCounts[r >= 10 ? 8 : (r == 1 ? 9 : r - 2)]--;
+        childKeys[r - 1] = DealerMemoKey(
+            newTotal, newIsSoft,
+            getHoleCardState(state.dealerHand.getCards().size() + 1, newTotal,
+                             false),
+            childCounts);
+        prefetchDealerSlot(childKeys[r - 1]);
+      }
+    }
+  }
+  co_await Interleaving::Yield();
+  for (int r = 1; r <= 13; ++r) {
+    if (probDrawCards[r - 1] != 0.0) {
+      prefetchDealerEntry(childKeys[r - 1]);
+    }
+  }
+  co_await Interleaving::Yield();
+
+  // Read the entries in draw order, as calcDealerOutcomeProbs does, so a
+  // card's sub-tree can reuse what the cards before it calculated
+  for (int r = 1; r <= 13; ++r) {
+    double probDrawCard = probDrawCards[r - 1];
+    if (probDrawCard == 0.0) {
+      continue;
+    }
+    stats.dealerMemoLookups++;
+    DealerOutcomeProbabilities cached;
+    if (findDealerOutcomes(childKeys[r - 1], tolerance, cached)) {
+      stats.dealerMemoHits++;
+      if (validateMemoKeys) {
+        validateDealerHit(
+            getGameStateMinusCardToDealer(state, static_cast<Card::Rank>(r)),
+            cached);
+      }
+      addWeightedOutcomes(outcomes, probDrawCard, cached);
+      continue;
+    }
+    GameState newState =
+        getGameStateMinusCardToDealer(state, static_cast<Card::Rank>(r));
+    newState.reachProbability = state.reachProbability * probDrawCard;
+    addWeightedOutcomes(outcomes, probDrawCard,
+                        co_await calcDealerOutcomeProbsInterleaved(
+                            newState, childKeys[r - 1]));
+  }
+  // Another search may have finished the same distribution in the meantime;
+  // keep its entry so every reader sees the same one
+  storeDealerOutcomes(key, outcomes, tolerance);
+  co_return outcomes;
+}
+
+BlackjackGame::DealerOutcomeProbabilities
+BlackjackGame::estimateDealerOutcomeProbs(const GameState& state) const {
+  std::array<double, 11> drawProbs = getValueDrawProbabilities(
+      state.remainingCardCounts, state.totalCardsRemaining);
+
+  // Outcomes from every (total, isSoft) the dealer can hold, filled on demand
+  std::array<std::array<DealerOutcomeProbabilities, 2>, 32> table;
+  std::array<std::array<bool, 2>, 32> filled = {};
+  auto outcomesFrom = [&](auto& self, int total,
+                          bool isSoft) -> DealerOutcomeProbabilities {
+    DealerOutcomeProbabilities outcomes;
+    if (total > 21) {
+      outcomes.prob_bust = 1.0;
+      return outcomes;
+    }
+    if (total >= 18 || (total == 17 && (!isSoft || !dealerHitsSoft17))) {
+      double* finalTotals[] = {&outcomes.prob_17, &outcomes.prob_18,
+                               &outcomes.prob_19, &outcomes.prob_20,
+                               &outcomes.prob_21};
+      *finalTotals[total - 17] = 1.0;
+      return outcomes;
+    }
+    if (filled[total][isSoft]) {
+      return table[total][isSoft];
+    }
+    for (int value = 1; value <= 10; ++value) {
+      if (drawProbs[value] == 0.0) continue;
+      auto [newTotal, newIsSoft] = addCardValue(total, isSoft, value);
+      DealerOutcomeProbabilities sub = self(self, newTotal, newIsSoft);
+      outcomes.prob_17 += drawProbs[value] * sub.prob_17;
+      outcomes.prob_18 += drawProbs[value] * sub.prob_18;
+      outcomes.prob_19 += drawProbs[value] * sub.prob_19;
+      outcomes.prob_20 += drawProbs[value] * sub.prob_20;
+      outcomes.prob_21 += drawProbs[value] * sub.prob_21;
+      outcomes.prob_bust += drawProbs[value] * sub.prob_bust;
+    }
+    filled[total][isSoft] = true;
+    table[total][isSoft] = outcomes;
+    return outcomes;
+  };
+
+  if (state.dealerHand.getCards().size() != 1) {
+    return outcomesFrom(outcomesFrom, state.dealerHand.getValue(),
+                        state.dealerHand.isSoft());
+  }
+
+  // With only the upcard, the hole card can complete a blackjack, which is
+  // ruled out once the dealer has checked
+  int upcardValue = state.dealerUpcard.getValue();
+  int blackjackValue = upcardValue == 10 ? 1 : (upcardValue == 11 ? 10 : 0);
+  DealerOutcomeProbabilities outcomes;
+  double holeCardMass = 0.0;
+  for (int value = 1; value <= 10; ++value) {
+    if (drawProbs[value] == 0.0) continue;
+    if (value == blackjackValue) {
+      if (!state.dealerChecked) {
+        outcomes.prob_blackjack += drawProbs[value];
+        holeCardMass += drawProbs[value];
+      }
+      continue;
+    }
+    holeCardMass += drawProbs[value];
+    auto [newTotal, newIsSoft] = addCardValue(state.dealerHand.getValue(),
+                                              state.dealerHand.isSoft(), value);
+    DealerOutcomeProbabilities sub =
+        outcomesFrom(outcomesFrom, newTotal, newIsSoft);
+    outcomes.prob_17 += drawProbs[value] * sub.prob_17;
+    outcomes.prob_18 += drawProbs[value] * sub.prob_18;
+    outcomes.prob_19 += drawProbs[value] * sub.prob_19;
+    outcomes.prob_20 += drawProbs[value] * sub.prob_20;
+    outcomes.prob_21 += drawProbs[value] * sub.prob_21;
+    outcomes.prob_bust += drawProbs[value] * sub.prob_bust;
+  }
+  if (holeCardMass > 0.0) {
+    outcomes.prob_17 /= holeCardMass;
+    outcomes.prob_18 /= holeCardMass;
+    outcomes.prob_19 /= holeCardMass;
+    outcomes.prob_20 /= holeCardMass;
+    outcomes.prob_21 /= holeCardMass;
+    outcomes.prob_bust /= holeCardMass;
+    outcomes.prob_blackjack /= holeCardMass;
+  }
   return outcomes;
 }
 
+BlackjackGame::EVResult BlackjackGame::estimateEVForOptimalStrategy(
+    const GameState& state) const {
+  DealerOutcomeProbabilities dealer = estimateDealerOutcomeProbs(state);
+  std::array<double, 11> drawProbs = getValueDrawProbabilities(
+      state.remainingCardCounts, state.totalCardsRemaining);
+
+  // EV of standing on each total against the estimated dealer outcomes
+  auto standOn = [&dealer](int total) {
+    if (total > 21) return -1.0;
+    const double dealerTotals[] = {dealer.prob_17, dealer.prob_18,
+                                   dealer.prob_19, dealer.prob_20,
+                                   dealer.prob_21};
+    double ev = dealer.prob_bust - dealer.prob_blackjack;
+    for (int dealerTotal = 17; dealerTotal <= 21; ++dealerTotal) {
+      if (total > dealerTotal) ev += dealerTotals[dealerTotal - 17];
+      if (total < dealerTotal) ev -= dealerTotals[dealerTotal - 17];
+    }
+    return ev;
+  };
+
+  // Best of hitting and standing from every (total, isSoft), filled on demand
+  std::array<std::array<double, 2>, 32> table;
+  std::array<std::array<bool, 2>, 32> filled = {};
+  auto hitFrom = [&](auto& self, int total, bool isSoft) -> double {
+    double hitEV = 0.0;
+    for (int value = 1; value <= 10; ++value) {
+      if (drawProbs[value] == 0.0) continue;
+      auto [newTotal, newIsSoft] = addCardValue(total, isSoft, value);
+      double bestEV = standOn(newTotal);
+      if (newTotal < 21) {
+        if (!filled[newTotal][newIsSoft]) {
+          table[newTotal][newIsSoft] = self(self, newTotal, newIsSoft);
+          filled[newTotal][newIsSoft] = true;
+        }
+        bestEV = std::max(bestEV, table[newTotal][newIsSoft]);
+      }
+      hitEV += drawProbs[value] * bestEV;
+    }
+    return hitEV;
+  };
+
+  int total = state.playerHand.getValue();
+  EVResult result;
+  result.standEV = standOn(total);
+  if (state.playerHand.isBlackjack()) {
+    result.standEV = (1 - dealer.prob_blackjack) * blackjackPayout;
+  }
+  result.hitEV = total < 21 ? hitFrom(hitFrom, total, state.playerHand.isSoft())
+                            : std::nan("");
+  result.doubleEV = std::nan("");
+  result.splitEV = std::nan("");
+  result.surrenderEV = std::nan("");
+  result.optimalAction = PlayerAction::Stand;
+  result.optimalEV = result.standEV;
+  if (!std::isnan(result.hitEV) && result.hitEV > result.optimalEV) {
+    result.optimalAction = PlayerAction::Hit;
+    result.optimalEV = result.hitEV;
+  }
+
+  // Every EV here lies in [-1, maxEV] since standing never loses more than
+  // one unit
+  double maxEV = getMaxEV(state.playerHand, state.numPlayerHands);
+  for (double ev : {result.standEV, result.hitEV}) {
+    if (!std::isnan(ev)) {
+      result.errorBound =
+          std::max({result.errorBound, ev + 1.0, maxEV - ev});
+    }
+  }
+  return result;
+}
+
 std::string BlackjackGame::getDealerOutcomesAsString(const GameState& state) {
   DealerOutcomeProbabilities outcomeProbs = calcDealerOutcomeProbs(state);
   std::string str;
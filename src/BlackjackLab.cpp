@@ -4,7 +4,12 @@
 #include <iostream>
 #include <string>
 
+#include "BankrollCalculator.h"
+#include "Benchmark.h"
+#include "DealerCalculator.h"
 #include "EVCalculator.h"
+#include "HandAnalyzer.h"
+#include "Simulator.h"
 #include "StrategyGenerator.h"
 
 void print_main_help() {
@@ -14,6 +19,16 @@ void print_main_help() {
       << "  ev-calc         Calculates the expected value of each action for "
          "a specific hand.\n"
       << "  strategy        Generates a basic or customized strategy chart.\n"
+      << "  simulate        Plays simulated rounds from a shoe to measure "
+         "EV.\n"
+      << "  bankroll        Computes risk of ruin and bet ramps for a "
+         "counting system.\n"
+      << "  analyze         Scores the decisions in a hand-history log "
+         "against optimal play.\n"
+      << "  benchmark       Times the engine on strategy chart hands and "
+         "counts its allocations.\n"
+      << "  dealer          Computes dealer outcome distributions for every "
+         "upcard and rule.\n"
       << "  help            Displays this help message.\n"
       << "  Type a command followed by --help for details on how to use that "
          "command.\n";
@@ -36,6 +51,21 @@ int main(int argc, char* argv[]) {
   } else if (command == "strategy") {
     int result = StrategyGenerator::run(argc, argv);
     return result;
+  } else if (command == "simulate") {
+    int result = Simulator::run(argc, argv);
+    return result;
+  } else if (command == "bankroll") {
+    int result = BankrollCalculator::run(argc, argv);
+    return result;
+  } else if (command == "analyze") {
+    int result = HandAnalyzer::run(argc, argv);
+    return result;
+  } else if (command == "benchmark") {
+    int result = Benchmark::run(argc, argv);
+    return result;
+  } else if (command == "dealer") {
+    int result = DealerCalculator::run(argc, argv);
+    return result;
   } else {
     std::cerr << "Unknown command: " << command << "\n";
     print_main_help();
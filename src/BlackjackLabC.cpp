@@ -0,0 +1,184 @@
+// BlackjackLabC.cpp
+#include "BlackjackLabC.h"
+
+#include <exception>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Engine.h"
+
+struct bjl_engine {
+  Engine engine;
+};
+
+namespace {
+static_assert(static_cast<int>(BlackjackGame::PlayerAction::Surrender) ==
+                  BJL_ACTION_SURRENDER &&
+              static_cast<int>(BlackjackGame::PlayerAction::None) ==
+                  BJL_ACTION_NONE,
+              "bjl_action must match BlackjackGame::PlayerAction");
+
+thread_local std::string lastError;
+
+// Records the error of a failed call and returns the failure code
+int fail(const std::string& message) {
+  lastError = message;
+  return -1;
+}
+
+// Builds the engine's state for a query. Throws std::runtime_error if the
+// query isn't a valid hand.
+BlackjackGame::GameState toGameState(const bjl_query& query, int numDecks) {
+  auto toRank = [](int rank) {
+    if (rank < 1 || rank > 13) {
+      throw std::runtime_error("Invalid rank " + std::to_string(rank) +
+                               " (ranks run from 1 to 13).");
+    }
+    return static_cast<Card::Rank>(rank);
+  };
+
+  if (query.num_player_cards > 0 && query.player_ranks == nullptr) {
+    throw std::runtime_error("player_ranks is NULL.");
+  }
+  std::vector<Card::Rank> playerRanks;
+  for (size_t i = 0; i < query.num_player_cards; ++i) {
+    playerRanks.push_back(toRank(query.player_ranks[i]));
+  }
+  Card::Rank dealerUpcard = toRank(query.dealer_upcard);
+
+  if (query.remaining_counts == nullptr) {
+    return BlackjackGame::getGameStateForCalculation(
+        playerRanks, dealerUpcard, numDecks, query.dealer_checked != 0);
+  }
+  std::map<Card::Rank, int> remainingCounts;
+  for (int r = 1; r <= 13; ++r) {
+    if (query.remaining_counts[r - 1] < 0) {
+      throw std::runtime_error("Negative count in remaining_counts.");
+    }
+    remainingCounts[static_cast<Card::Rank>(r)] =
+        query.remaining_counts[r - 1];
+  }
+  return BlackjackGame::getGameStateForComposition(
+      playerRanks, dealerUpcard, remainingCounts, numDecks,
+      query.dealer_checked != 0);
+}
+
+// Copies an engine result into the C struct
+void toResult(const BlackjackGame::EVResult& evResult, bjl_result* result) {
+  *result = {.hit_ev = evResult.hitEV,
+             .stand_ev = evResult.standEV,
+             .split_ev = evResult.splitEV,
+             .double_ev = evResult.doubleEV,
+             .surrender_ev = evResult.surrenderEV,
+             .optimal_ev = evResult.optimalEV,
+             .error_bound = evResult.errorBound,
+             .optimal_action =
+                 static_cast<bjl_action>(evResult.optimalAction)};
+}
+}  // namespace
+
+void bjl_rules_init(bjl_rules* rules) {
+  BlackjackGame::GameRules defaults;
+  *rules = {.num_decks = defaults.numDecks,
+            .dealer_hits_soft17 = defaults.dealerHitsSoft17,
+            .can_double_after_split = defaults.canDoubleAfterSplit,
+            .surrender_type = BJL_SURRENDER_LATE,
+            .blackjack_payout = defaults.blackjackPayout,
+            .insurance_payout = defaults.insurancePayout,
+            .can_split_aces = defaults.canSplitAces,
+            .max_splits = defaults.maxSplits};
+}
+
+void bjl_options_init(bjl_options* options) {
+  EngineOptions defaults;
+  *options = {.thread_count = defaults.threadCount,
+              .epsilon = defaults.epsilon,
+              .decisions_only = defaults.decisionsOnly,
+              .dealer_table_cards = defaults.dealerTableCards};
+}
+
+bjl_engine* bjl_engine_create(const bjl_rules* rules,
+                              const bjl_options* options) {
+  if (rules == nullptr) {
+    fail("rules is NULL.");
+    return nullptr;
+  }
+  if (rules->num_decks < 1 || rules->num_decks > 8 || rules->max_splits < 0 ||
+      rules->max_splits > 3) {
+    fail("Invalid rules: decks must be 1-8 and max splits 0-3.");
+    return nullptr;
+  }
+
+  BlackjackGame::SurrenderType surrenderType;
+  switch (rules->surrender_type) {
+    case BJL_SURRENDER_NONE:
+      surrenderType = BlackjackGame::SurrenderType::None;
+      break;
+    case BJL_SURRENDER_LATE:
+      surrenderType = BlackjackGame::SurrenderType::Late;
+      break;
+    case BJL_SURRENDER_EARLY:
+      surrenderType = BlackjackGame::SurrenderType::Early;
+      break;
+    default:
+      fail("Invalid surrender type.");
+      return nullptr;
+  }
+  BlackjackGame::GameRules gameRules{
+      .numDecks = rules->num_decks,
+      .dealerHitsSoft17 = rules->dealer_hits_soft17 != 0,
+      .canDoubleAfterSplit = rules->can_double_after_split != 0,
+      .surrenderType = surrenderType,
+      .blackjackPayout = rules->blackjack_payout,
+      .insurancePayout = rules->insurance_payout,
+      .canSplitAces = rules->can_split_aces != 0,
+      .maxSplits = rules->max_splits};
+
+  EngineOptions engineOptions;
+  if (options != nullptr) {
+    engineOptions.threadCount = options->thread_count;
+    engineOptions.epsilon = options->epsilon;
+    engineOptions.decisionsOnly = options->decisions_only != 0;
+    engineOptions.dealerTableCards = options->dealer_table_cards;
+  }
+  try {
+    return new bjl_engine{Engine(gameRules, engineOptions)};
+  } catch (const std::exception& e) {
+    fail(e.what());
+    return nullptr;
+  }
+}
+
+void bjl_engine_destroy(bjl_engine* engine) { delete engine; }
+
+int bjl_engine_evaluate(bjl_engine* engine, const bjl_query* query,
+                        bjl_result* result) {
+  return bjl_engine_evaluate_batch(engine, query, 1, result);
+}
+
+int bjl_engine_evaluate_batch(bjl_engine* engine, const bjl_query* queries,
+                              size_t count, bjl_result* results) {
+  if (engine == nullptr || queries == nullptr || results == nullptr) {
+    return fail("engine, queries and results must not be NULL.");
+  }
+  try {
+    int numDecks = engine->engine.getRules().numDecks;
+    std::vector<BlackjackGame::GameState> states;
+    states.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      states.push_back(toGameState(queries[i], numDecks));
+    }
+    std::vector<BlackjackGame::EVResult> evResults =
+        engine->engine.evaluateBatch(states);
+    for (size_t i = 0; i < count; ++i) {
+      toResult(evResults[i], &results[i]);
+    }
+  } catch (const std::exception& e) {
+    return fail(e.what());
+  }
+  return 0;
+}
+
+const char* bjl_last_error(void) { return lastError.c_str(); }
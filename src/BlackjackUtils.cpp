@@ -1,6 +1,12 @@
 #include <BlackjackUtils.h>
 
+#include <algorithm>
+#include <iostream>
+#include <sstream>
 #include <stdexcept>
+#include <thread>
+
+#include "AllocationCounter.h"
 
 Card::Rank BlackjackUtils::stringToRank(const std::string& str) {
   if (str == "2") return Card::Rank::Two;
@@ -82,10 +88,239 @@ std::string BlackjackUtils::playerActionToString(
   throw std::invalid_argument("Invalid player action");
 }
 
+BlackjackGame::PlayerAction BlackjackUtils::stringToPlayerAction(
+    const std::string& str) {
+  if (str == "Hit") return BlackjackGame::PlayerAction::Hit;
+  if (str == "Stand") return BlackjackGame::PlayerAction::Stand;
+  if (str == "Split") return BlackjackGame::PlayerAction::Split;
+  if (str == "Double") return BlackjackGame::PlayerAction::Double;
+  if (str == "Surrender") return BlackjackGame::PlayerAction::Surrender;
+  if (str == "None") return BlackjackGame::PlayerAction::None;
+  throw std::invalid_argument("Invalid player action string");
+}
+
 std::string BlackjackUtils::surrenderTypeToString(
     BlackjackGame::SurrenderType type) {
   if (type == BlackjackGame::SurrenderType::Early) return "Early";
   if (type == BlackjackGame::SurrenderType::Late) return "Late";
   if (type == BlackjackGame::SurrenderType::None) return "None";
   throw std::invalid_argument("Invalid surrender type");
-}
\ No newline at end of file
+}
+
+bool BlackjackUtils::parseArguments(int argc, char* argv[],
+                                    std::map<std::string, std::string>& args) {
+  for (int i = 2; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.rfind("--", 0) == 0) {
+      if (i + 1 < argc) {
+        std::string key = arg.substr(2);
+        std::string value = argv[++i];
+        args[key] = value;
+      } else {
+        std::cerr << "Error: Missing value for argument " << arg << "\n";
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool BlackjackUtils::parseGameRules(
+    const std::map<std::string, std::string>& args,
+    BlackjackGame::GameRules& rules) {
+  auto find = [&args](const std::string& key) -> const std::string* {
+    auto it = args.find(key);
+    return it == args.end() ? nullptr : &it->second;
+  };
+
+  if (const std::string* value = find("decks")) {
+    try {
+      rules.numDecks = std::stoi(*value);
+      if (rules.numDecks < 1 || rules.numDecks > 8) {
+        throw std::out_of_range("Invalid deck count. Must be between 1 and 8.");
+      }
+    } catch (const std::exception& e) {
+      std::cerr
+          << "Error: Invalid value for '--decks'. Must be an integer (1-8)."
+          << std::endl;
+      return false;
+    }
+  }
+
+  if (const std::string* value = find("s17")) {
+    rules.dealerHitsSoft17 = *value != "false";
+  }
+
+  if (const std::string* value = find("das")) {
+    rules.canDoubleAfterSplit = *value != "false";
+  }
+
+  if (const std::string* value = find("surrender")) {
+    if (*value == "none") {
+      rules.surrenderType = BlackjackGame::SurrenderType::None;
+    } else if (*value == "late") {
+      rules.surrenderType = BlackjackGame::SurrenderType::Late;
+    } else if (*value == "early") {
+      rules.surrenderType = BlackjackGame::SurrenderType::Early;
+    } else {
+      std::cerr << "Error: Invalid value for '--surrender'. Must be "
+                   "'none', 'late', or 'early'."
+                << std::endl;
+      return false;
+    }
+  }
+
+  if (const std::string* value = find("blackjack-payout")) {
+    try {
+      rules.blackjackPayout = std::stod(*value);
+      if (rules.blackjackPayout < 1.0) {
+        throw std::out_of_range(
+            "Invalid blackjack payout. Must be at least 1.0.");
+      }
+    } catch (const std::exception& e) {
+      std::cerr
+          << "Error: Invalid value for '--blackjack-payout'. Must be a number."
+          << std::endl;
+      return false;
+    }
+  }
+
+  if (const std::string* value = find("insurance-payout")) {
+    try {
+      rules.insurancePayout = std::stod(*value);
+      if (rules.insurancePayout < 1.0) {
+        throw std::out_of_range(
+            "Invalid insurance payout. Must be at least 1.0.");
+      }
+    } catch (const std::exception& e) {
+      std::cerr
+          << "Error: Invalid value for '--insurance-payout'. Must be a number."
+          << std::endl;
+      return false;
+    }
+  }
+
+  if (const std::string* value = find("can-split-aces")) {
+    rules.canSplitAces = *value != "false";
+  }
+
+  if (const std::string* value = find("max-splits")) {
+    try {
+      rules.maxSplits = std::stoi(*value);
+      if (rules.maxSplits < 0 || rules.maxSplits > 3) {
+        throw std::out_of_range(
+            "Invalid max splits. Must be between 0 (splitting not allowed) and "
+            "3.");
+      }
+    } catch (const std::exception& e) {
+      std::cerr << "Error: Invalid value for '--max-splits'. Must be an "
+                   "integer (0-3)."
+                << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool BlackjackUtils::parseThreadCount(
+    const std::map<std::string, std::string>& args, int& threadCount) {
+  threadCount = std::max(1u, std::thread::hardware_concurrency());
+  auto it = args.find("threads");
+  if (it == args.end() || it->second == "all" || it->second == "max") {
+    return true;
+  }
+  try {
+    threadCount = std::stoi(it->second);
+    if (threadCount < 1) {
+      throw std::out_of_range("Invalid thread count. Must be at least 1.");
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Error: Invalid value for '--threads'. Must be a positive "
+                 "integer."
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool BlackjackUtils::parseMemoStorage(
+    const std::map<std::string, std::string>& args,
+    BlackjackGame::MemoStorage& memoStorage) {
+  memoStorage = BlackjackGame::MemoStorage::Full;
+  auto it = args.find("memo-storage");
+  if (it == args.end() || it->second == "full") {
+    return true;
+  }
+  if (it->second == "compact") {
+    memoStorage = BlackjackGame::MemoStorage::Compact;
+  } else if (it->second == "float") {
+    memoStorage = BlackjackGame::MemoStorage::Float;
+  } else {
+    std::cerr << "Error: Invalid value for '--memo-storage'. Must be "
+                 "'full', 'compact', or 'float'."
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+std::vector<double> BlackjackUtils::parseBetRamp(const std::string& ramp) {
+  if (ramp == "flat") {
+    return {1.0};
+  }
+  std::vector<double> bets;
+  std::stringstream ss(ramp);
+  std::string entry;
+  while (std::getline(ss, entry, '/')) {
+    double bet = std::stod(entry);
+    if (bet <= 0.0) {
+      throw std::out_of_range("Bets must be positive.");
+    }
+    bets.push_back(bet);
+  }
+  if (bets.empty()) {
+    throw std::invalid_argument("Empty bet ramp.");
+  }
+  return bets;
+}
+
+double BlackjackUtils::betForTrueCount(const std::vector<double>& betRamp,
+                                       int trueCount) {
+  int index = std::clamp(trueCount - 1, 0, static_cast<int>(betRamp.size()) - 1);
+  return betRamp[index];
+}
+
+void BlackjackUtils::printSearchStats(const BlackjackGame::SearchStats& stats) {
+  auto hitRate = [](uint64_t hits, uint64_t lookups) {
+    return lookups > 0 ? 100.0 * hits / lookups : 0.0;
+  };
+  std::cout << "\nSearch stats:\n";
+  std::cout << "Player states expanded: " << stats.playerNodes << "\n";
+  std::cout << "Dealer states expanded: " << stats.dealerNodes << "\n";
+  std::cout << "Player memo hits: " << stats.playerMemoHits << " of "
+            << stats.playerMemoLookups << " ("
+            << hitRate(stats.playerMemoHits, stats.playerMemoLookups)
+            << "%)\n";
+  std::cout << "Dealer memo hits: " << stats.dealerMemoHits << " of "
+            << stats.dealerMemoLookups << " ("
+            << hitRate(stats.dealerMemoHits, stats.dealerMemoLookups)
+            << "%)\n";
+  std::cout << "Stand EV memo hits: " << stats.standMemoHits << " of "
+            << stats.standMemoLookups << " ("
+            << hitRate(stats.standMemoHits, stats.standMemoLookups) << "%)\n";
+  std::cout << "Dealer table hits: " << stats.dealerTableHits << "\n";
+  std::cout << "Actions pruned: " << stats.actionsPruned << "\n";
+  if (stats.memoValidations > 0) {
+    std::cout << "Memo hits validated: " << stats.memoValidations << " ("
+              << stats.memoMismatches << " mismatches)\n";
+  }
+  if (AllocationCounter::kEnabled) {
+    uint64_t nodes = stats.playerNodes + stats.dealerNodes;
+    std::cout << "Heap allocations in search: " << stats.heapAllocations
+              << " (" << stats.heapBytes << " bytes, "
+              << (nodes > 0 ? static_cast<double>(stats.heapAllocations) / nodes
+                            : 0.0)
+              << " per state expanded)\n";
+  }
+}
@@ -0,0 +1,406 @@
+#include "DealerCalculator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "BlackjackUtils.h"
+
+namespace {
+// Number of card values (A, 2-9, 10)
+constexpr int kNumValues = 10;
+constexpr int kTenIndex = 9;
+
+// Shoes read and solved at a time, so a file of any length is streamed
+constexpr size_t kBatchSize = 4096;
+// Neighbouring shoes a worker claims at once
+constexpr size_t kBlockSize = 16;
+// A worker's games clear their memos past this many entries
+constexpr size_t kMaxMemoEntries = 2000000;
+
+// Upcard labels by value index, aces first
+const char* const kUpcardNames[kNumValues] = {"A", "2", "3", "4", "5",
+                                              "6", "7", "8", "9", "10"};
+
+// Helper function to print dealer usage information
+void print_dealer_help() {
+  std::cout
+      << "Usage: ./BlackjackLab dealer [options]\n"
+      << "Calculates the dealer's final total distribution (17-21, blackjack, "
+         "bust) for every upcard,\n"
+      << "with and without a hole card check, when the dealer stands and "
+         "hits on soft 17.\n"
+      << "\nOptions:\n"
+      << "  --decks <num>             Solve a full shoe of this many decks "
+         "(default: 6).\n"
+      << "  --shoe <counts>           Solve this shoe instead, given as the "
+         "number of cards of\n"
+      << "                            each value before the upcard is dealt: "
+         "A,2,3,4,5,6,7,8,9,10\n"
+      << "                            (e.g. '4,4,4,4,4,4,4,4,4,16').\n"
+      << "  --shoe-file <file>        Solve every shoe in a file, one per "
+         "line in the same format\n"
+      << "                            ('-' reads standard input; blank and "
+         "'#' lines are skipped).\n"
+      << "  --format <type>           Output format ('csv' or 'json', "
+         "default: csv).\n"
+      << "  --output <file>           Output file (default: standard "
+         "output).\n"
+      << "  --threads <num>           Number of threads to use (default: "
+         "max).\n"
+      << "\n'Shoe Exhausted' is the probability that the shoe runs out "
+         "before the dealer\n"
+      << "finishes, so the other columns sum to 1 minus it. Rows that can't "
+         "happen are left out:\n"
+      << "upcards the shoe holds no card of, shoes that always run out and "
+         "checks no hole card\n"
+      << "can pass. With a hole card check, the dealer is known not to have "
+         "blackjack, so its\n"
+      << "probability is 0.\n";
+}
+
+// Gets the shoe the engine draws from for counts by value. Tens are spread
+// over the four ten ranks, tens first, so a ten upcard can always be dealt.
+std::map<Card::Rank, int> getRankCounts(const std::array<int, 10>& counts) {
+  std::map<Card::Rank, int> shoe;
+  shoe[Card::Rank::Ace] = counts[0];
+  for (int valueIndex = 1; valueIndex < kTenIndex; ++valueIndex) {
+    shoe[static_cast<Card::Rank>(valueIndex + 1)] = counts[valueIndex];
+  }
+  const Card::Rank tenRanks[] = {Card::Rank::Ten, Card::Rank::Jack,
+                                 Card::Rank::Queen, Card::Rank::King};
+  for (int i = 0; i < 4; ++i) {
+    shoe[tenRanks[i]] = counts[kTenIndex] / 4 + (i < counts[kTenIndex] % 4);
+  }
+  return shoe;
+}
+
+// Gets the probability that the shoe runs out before the dealer finishes,
+// which is the mass missing from the outcomes. Rounding noise counts as 0.
+double getExhaustedProbability(
+    const BlackjackGame::DealerOutcomeProbabilities& outcomes) {
+  double exhausted =
+      1.0 - (outcomes.prob_17 + outcomes.prob_18 + outcomes.prob_19 +
+             outcomes.prob_20 + outcomes.prob_21 + outcomes.prob_blackjack +
+             outcomes.prob_bust);
+  return std::abs(exhausted) < 1e-12 ? 0.0 : exhausted;
+}
+
+// Gets the rank dealt as the upcard of a value index
+Card::Rank upcardRank(int valueIndex) {
+  return valueIndex == kTenIndex ? Card::Rank::Ten
+                                 : static_cast<Card::Rank>(valueIndex + 1);
+}
+}  // namespace
+
+int DealerCalculator::run(int argc, char* argv[]) {
+  // Print help message if requested
+  if (argc > 2 && argv[2] == std::string("--help")) {
+    print_dealer_help();
+    return 0;
+  }
+
+  std::map<std::string, std::string> args;
+  if (!BlackjackUtils::parseArguments(argc, argv, args)) {
+    return 1;
+  }
+
+  BlackjackGame::GameRules rules;
+  int threadCount;
+  if (!BlackjackUtils::parseGameRules(args, rules) ||
+      !BlackjackUtils::parseThreadCount(args, threadCount)) {
+    return 1;
+  }
+
+  bool json = false;
+  if (args.count("format")) {
+    if (args["format"] == "json") {
+      json = true;
+    } else if (args["format"] != "csv") {
+      std::cerr << "Error: Invalid value for '--format'. Must be 'csv' or "
+                   "'json'."
+                << std::endl;
+      return 1;
+    }
+  }
+  if (args.count("shoe") && args.count("shoe-file")) {
+    std::cerr << "Error: '--shoe' can't be combined with '--shoe-file'."
+              << std::endl;
+    return 1;
+  }
+
+  // The shoes come from a file, or are a single given or full shoe
+  std::ifstream shoeFile;
+  std::istringstream singleShoe;
+  std::istream* input = &singleShoe;
+  if (args.count("shoe-file")) {
+    if (args["shoe-file"] == "-") {
+      input = &std::cin;
+    } else {
+      shoeFile.open(args["shoe-file"]);
+      if (!shoeFile.is_open()) {
+        std::cerr << "Error: Could not open file " << args["shoe-file"]
+                  << std::endl;
+        return 1;
+      }
+      input = &shoeFile;
+    }
+  } else if (args.count("shoe")) {
+    try {
+      parseShoe(args["shoe"]);
+    } catch (const std::invalid_argument& e) {
+      std::cerr << "Error: Invalid value for '--shoe'. " << e.what()
+                << std::endl;
+      return 1;
+    }
+    singleShoe.str(args["shoe"]);
+  } else {
+    std::ostringstream fullShoe;
+    for (int valueIndex = 0; valueIndex < kNumValues; ++valueIndex) {
+      fullShoe << (valueIndex > 0 ? "," : "")
+               << (valueIndex == kTenIndex ? 16 : 4) * rules.numDecks;
+    }
+    singleShoe.str(fullShoe.str());
+  }
+
+  std::ofstream outputFile;
+  std::ostream* out = &std::cout;
+  if (args.count("output")) {
+    outputFile.open(args["output"]);
+    if (!outputFile.is_open()) {
+      std::cerr << "Error: Could not open file " << args["output"]
+                << " for writing." << std::endl;
+      return 1;
+    }
+    out = &outputFile;
+  }
+  // Full precision, so the tables can feed other models as they are
+  out->precision(17);
+
+  // Each worker keeps a game per soft 17 rule for the whole run
+  std::vector<WorkerGames> workers(threadCount);
+  for (WorkerGames& games : workers) {
+    BlackjackGame::GameRules gameRules = rules;
+    gameRules.dealerHitsSoft17 = false;
+    games.standsSoft17 = std::make_unique<BlackjackGame>(gameRules);
+    gameRules.dealerHitsSoft17 = true;
+    games.hitsSoft17 = std::make_unique<BlackjackGame>(gameRules);
+  }
+
+  if (json) {
+    *out << "[";
+  } else {
+    *out << "Shoe,Dealer Hits Soft 17,Dealer Checked,Upcard,17,18,19,20,21,"
+            "Blackjack,Bust,Shoe Exhausted\n";
+  }
+  auto startTime = std::chrono::steady_clock::now();
+  long long shoeCount = 0;
+  long long lineNumber = 0;
+  bool firstObject = true;
+  std::vector<ShoeCounts> shoes;
+  std::vector<ShoeResult> results;
+  try {
+    while (readShoes(*input, kBatchSize, shoes, lineNumber)) {
+      results.resize(shoes.size());
+      solveBatch(shoes, workers, results);
+      writeResults(*out, json, results, shoeCount, firstObject);
+      shoeCount += shoes.size();
+    }
+  } catch (const std::invalid_argument& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  if (json) {
+    *out << "\n]\n";
+  }
+  out->flush();
+
+  if (outputFile.is_open()) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime);
+    std::cout << "Solved " << shoeCount << " shoes in " << elapsed.count()
+              << " ms\n";
+    std::cout << "Dealer outcomes written to " << args["output"] << "\n";
+  }
+  return 0;
+}
+
+DealerCalculator::ShoeCounts DealerCalculator::parseShoe(
+    const std::string& text) {
+  ShoeCounts counts;
+  std::stringstream ss(text);
+  std::string count;
+  int valueIndex = 0;
+  while (std::getline(ss, count, ',')) {
+    if (valueIndex == kNumValues) {
+      throw std::invalid_argument("A shoe has more than 10 card counts.");
+    }
+    size_t parsed = 0;
+    try {
+      counts[valueIndex] = std::stoi(count, &parsed);
+    } catch (const std::exception& e) {
+      parsed = 0;
+    }
+    if (parsed == 0 || parsed != count.size() || counts[valueIndex] < 0) {
+      throw std::invalid_argument("Invalid card count '" + count + "'.");
+    }
+    valueIndex++;
+  }
+  if (valueIndex != kNumValues) {
+    throw std::invalid_argument(
+        "A shoe needs 10 card counts (A,2,3,4,5,6,7,8,9,10).");
+  }
+  return counts;
+}
+
+bool DealerCalculator::readShoes(std::istream& input, size_t maxShoes,
+                                 std::vector<ShoeCounts>& shoes,
+                                 long long& lineNumber) {
+  shoes.clear();
+  std::string line;
+  while (shoes.size() < maxShoes && std::getline(input, line)) {
+    lineNumber++;
+    line.erase(std::remove_if(line.begin(), line.end(),
+                              [](char c) { return std::isspace(c); }),
+               line.end());
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    try {
+      shoes.push_back(parseShoe(line));
+    } catch (const std::invalid_argument& e) {
+      throw std::invalid_argument("Line " + std::to_string(lineNumber) +
+                                  ": " + e.what());
+    }
+  }
+  return !shoes.empty();
+}
+
+void DealerCalculator::solveBatch(const std::vector<ShoeCounts>& shoes,
+                                  std::vector<WorkerGames>& workers,
+                                  std::vector<ShoeResult>& results) {
+  std::atomic<size_t> nextShoe = 0;
+  auto solveShoes = [&](WorkerGames& games) {
+    while (true) {
+      size_t start = nextShoe.fetch_add(kBlockSize);
+      if (start >= shoes.size()) {
+        break;
+      }
+      size_t end = std::min(start + kBlockSize, shoes.size());
+      for (size_t index = start; index < end; ++index) {
+        solveShoe(shoes[index], games, results[index]);
+      }
+      for (BlackjackGame* game :
+           {games.standsSoft17.get(), games.hitsSoft17.get()}) {
+        if (game->getMemoEntryCount() > kMaxMemoEntries) {
+          game->clearMemos();
+        }
+      }
+    }
+  };
+
+  // A batch too small to share is solved on this thread
+  size_t threadCount =
+      std::min(workers.size(), (shoes.size() + kBlockSize - 1) / kBlockSize);
+  if (threadCount <= 1) {
+    solveShoes(workers[0]);
+    return;
+  }
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < threadCount; ++i) {
+    threads.emplace_back(solveShoes, std::ref(workers[i]));
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+void DealerCalculator::solveShoe(const ShoeCounts& shoe, WorkerGames& games,
+                                 ShoeResult& result) {
+  std::map<Card::Rank, int> rankCounts = getRankCounts(shoe);
+  result.possible.fill(false);
+  for (int upcardIndex = 0; upcardIndex < kNumValues; ++upcardIndex) {
+    if (shoe[upcardIndex] == 0) {
+      continue;
+    }
+    // Checking for blackjack only changes the odds under a 10 or Ace
+    bool dealerCanHaveBlackjack = upcardIndex == 0 || upcardIndex == kTenIndex;
+    for (bool hitsSoft17 : {false, true}) {
+      BlackjackGame& game =
+          hitsSoft17 ? *games.hitsSoft17 : *games.standsSoft17;
+      for (bool dealerChecked : {false, true}) {
+        int index = getResultIndex(upcardIndex, hitsSoft17, dealerChecked);
+        if (dealerChecked && !dealerCanHaveBlackjack) {
+          int uncheckedIndex =
+              getResultIndex(upcardIndex, hitsSoft17, false);
+          result.outcomes[index] = result.outcomes[uncheckedIndex];
+          result.possible[index] = result.possible[uncheckedIndex];
+          continue;
+        }
+        BlackjackGame::GameState state =
+            BlackjackGame::getGameStateForComposition(
+                {}, upcardRank(upcardIndex), rankCounts, 1, dealerChecked);
+        result.outcomes[index] = game.calcDealerOutcomeProbs(state);
+        // The shoe always runs out before the dealer finishes, or no hole
+        // card passes the check
+        result.possible[index] =
+            getExhaustedProbability(result.outcomes[index]) < 1.0;
+      }
+    }
+  }
+}
+
+void DealerCalculator::writeResults(std::ostream& out, bool json,
+                                    const std::vector<ShoeResult>& results,
+                                    long long firstShoe, bool& firstObject) {
+  // Rows follow the chart's upcard order, 2-10 then A
+  const int upcardOrder[kNumValues] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 0};
+  for (size_t i = 0; i < results.size(); ++i) {
+    long long shoe = firstShoe + i;
+    for (bool hitsSoft17 : {false, true}) {
+      for (bool dealerChecked : {false, true}) {
+        for (int upcardIndex : upcardOrder) {
+          int index = getResultIndex(upcardIndex, hitsSoft17, dealerChecked);
+          if (!results[i].possible[index]) {
+            continue;
+          }
+          const BlackjackGame::DealerOutcomeProbabilities& outcomes =
+              results[i].outcomes[index];
+          if (json) {
+            out << (firstObject ? "\n" : ",\n") << "{\"shoe\":" << shoe
+                << ",\"dealerHitsSoft17\":"
+                << (hitsSoft17 ? "true" : "false")
+                << ",\"dealerChecked\":" << (dealerChecked ? "true" : "false")
+                << ",\"upcard\":\"" << kUpcardNames[upcardIndex]
+                << "\",\"17\":" << outcomes.prob_17
+                << ",\"18\":" << outcomes.prob_18
+                << ",\"19\":" << outcomes.prob_19
+                << ",\"20\":" << outcomes.prob_20
+                << ",\"21\":" << outcomes.prob_21
+                << ",\"blackjack\":" << outcomes.prob_blackjack
+                << ",\"bust\":" << outcomes.prob_bust
+                << ",\"shoeExhausted\":" << getExhaustedProbability(outcomes)
+                << "}";
+            firstObject = false;
+          } else {
+            out << shoe << "," << (hitsSoft17 ? "Yes" : "No") << ","
+                << (dealerChecked ? "Yes" : "No") << ","
+                << kUpcardNames[upcardIndex] << "," << outcomes.prob_17 << ","
+                << outcomes.prob_18 << "," << outcomes.prob_19 << ","
+                << outcomes.prob_20 << "," << outcomes.prob_21 << ","
+                << outcomes.prob_blackjack << "," << outcomes.prob_bust << ","
+                << getExhaustedProbability(outcomes) << "\n";
+          }
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,262 @@
+// DealerTable.cpp
+#include "DealerTable.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+// Identifies dealer table files and their layout
+constexpr char kFileMagic[4] = {'B', 'J', 'D', 'T'};
+constexpr int32_t kFileVersion = 1;
+
+// Number of card values (2-9, 10, A)
+constexpr int kNumValues = 10;
+constexpr int kTenIndex = 8;
+constexpr int kAceIndex = 9;
+
+// Gets the rank used for a card value index when building a shoe
+Card::Rank rankForValueIndex(int valueIndex) {
+  if (valueIndex == kAceIndex) return Card::Rank::Ace;
+  if (valueIndex == kTenIndex) return Card::Rank::Ten;
+  return static_cast<Card::Rank>(valueIndex + 2);
+}
+
+// Builds the shoe left after removing cards from a full shoe. Removed tens
+// are taken from the kings first so a ten upcard can always be dealt.
+std::map<Card::Rank, int> getRemainingShoe(
+    int numDecks, const DealerTable::DeckCounts& removedCounts) {
+  std::map<Card::Rank, int> remaining;
+  for (int r = static_cast<int>(Card::Rank::Ace);
+       r <= static_cast<int>(Card::Rank::King); ++r) {
+    remaining[static_cast<Card::Rank>(r)] = 4 * numDecks;
+  }
+  for (int valueIndex = 0; valueIndex < kNumValues; ++valueIndex) {
+    if (valueIndex != kTenIndex) {
+      remaining[rankForValueIndex(valueIndex)] -= removedCounts[valueIndex];
+    }
+  }
+  const Card::Rank tenRanks[] = {Card::Rank::King, Card::Rank::Queen,
+                                 Card::Rank::Jack, Card::Rank::Ten};
+  for (int i = 0; i < removedCounts[kTenIndex]; ++i) {
+    remaining[tenRanks[i % 4]]--;
+  }
+  return remaining;
+}
+}  // namespace
+
+DealerTable::DealerTable(int numDecks, bool dealerHitsSoft17,
+                         int maxRemovedCards)
+    : numDecks(numDecks),
+      dealerHitsSoft17(dealerHitsSoft17),
+      maxRemovedCards(maxRemovedCards) {
+  for (int valueIndex = 0; valueIndex < kNumValues; ++valueIndex) {
+    fullCounts[valueIndex] = (valueIndex == kTenIndex ? 16 : 4) * numDecks;
+  }
+
+  // Pascal's triangle
+  binomial.resize(maxRemovedCards + kNumValues + 1);
+  for (size_t n = 0; n < binomial.size(); ++n) {
+    binomial[n].assign(n + 1, 1);
+    for (size_t k = 1; k < n; ++k) {
+      binomial[n][k] = binomial[n - 1][k - 1] + binomial[n - 1][k];
+    }
+  }
+
+  // Multisets of up to k cards over 10 values number C(k + 10, 10)
+  numCompositions = choose(maxRemovedCards + kNumValues, kNumValues);
+  entries.resize(numCompositions * kNumValues * 2);
+}
+
+size_t DealerTable::rankComposition(const DeckCounts& removedCounts,
+                                    int numRemoved) const {
+  // Multisets of j cards map to the j-subsets of {0, ..., j + 8} by adding
+  // each card's position to its value index, and those subsets are ranked by
+  // the combinatorial number system. The C(j + 9, 10) smaller multisets come
+  // first.
+  size_t rank = choose(numRemoved + kNumValues - 1, kNumValues);
+  int position = 1;
+  for (int valueIndex = 0; valueIndex < kNumValues; ++valueIndex) {
+    for (int i = 0; i < removedCounts[valueIndex]; ++i) {
+      rank += choose(valueIndex + position - 1, position);
+      position++;
+    }
+  }
+  return rank;
+}
+
+const DealerTable::DealerOutcomeProbabilities* DealerTable::find(
+    int upcardValue, bool dealerChecked,
+    const DeckCounts& remainingCounts) const {
+  int upcardIndex = upcardValue == 11 ? kAceIndex : upcardValue - 2;
+  DeckCounts removedCounts;
+  int numRemoved = 0;
+  for (int valueIndex = 0; valueIndex < kNumValues; ++valueIndex) {
+    removedCounts[valueIndex] = fullCounts[valueIndex] -
+                                remainingCounts[valueIndex] -
+                                (valueIndex == upcardIndex ? 1 : 0);
+    if (removedCounts[valueIndex] < 0) {
+      return nullptr;  // Not dealt from a full shoe of this size
+    }
+    numRemoved += removedCounts[valueIndex];
+  }
+  if (numRemoved > maxRemovedCards) {
+    return nullptr;
+  }
+  return &entries[blockOffset(upcardIndex, dealerChecked) +
+                  rankComposition(removedCounts, numRemoved)];
+}
+
+DealerTable DealerTable::build(const BlackjackGame::GameRules& rules,
+                               int maxRemovedCards, int threadCount) {
+  DealerTable table(rules.numDecks, rules.dealerHitsSoft17, maxRemovedCards);
+
+  // List every removed-cards multiset at its rank
+  std::vector<DeckCounts> compositions(table.numCompositions);
+  DeckCounts removedCounts = {};
+  auto enumerate = [&](auto& self, int valueIndex, int numRemoved) -> void {
+    if (valueIndex == kNumValues) {
+      compositions[table.rankComposition(removedCounts, numRemoved)] =
+          removedCounts;
+      return;
+    }
+    for (int count = 0; numRemoved + count <= maxRemovedCards; ++count) {
+      removedCounts[valueIndex] = count;
+      self(self, valueIndex + 1, numRemoved + count);
+    }
+    removedCounts[valueIndex] = 0;
+  };
+  enumerate(enumerate, 0, 0);
+
+  // Workers claim blocks of neighbouring compositions, which share most of
+  // their dealer sub-trees, and write to disjoint entries
+  constexpr size_t kBlockSize = 32;
+  constexpr size_t kMaxMemoEntries = 2000000;
+  std::atomic<size_t> nextComposition = 0;
+  auto fillEntries = [&] {
+    BlackjackGame game(rules);
+    while (true) {
+      size_t start = nextComposition.fetch_add(kBlockSize);
+      if (start >= table.numCompositions) {
+        break;
+      }
+      size_t end = std::min(start + kBlockSize, table.numCompositions);
+      for (size_t index = start; index < end; ++index) {
+        const DeckCounts& removed = compositions[index];
+        for (int upcardIndex = 0; upcardIndex < kNumValues; ++upcardIndex) {
+          // Skip shoes that can't hold the removed cards and the upcard
+          bool isPossible = true;
+          for (int valueIndex = 0; valueIndex < kNumValues; ++valueIndex) {
+            if (removed[valueIndex] + (valueIndex == upcardIndex ? 1 : 0) >
+                table.fullCounts[valueIndex]) {
+              isPossible = false;
+            }
+          }
+          if (!isPossible) {
+            continue;
+          }
+
+          // Checking for blackjack only changes the odds under a 10 or Ace
+          bool dealerCanHaveBlackjack = upcardIndex >= kTenIndex;
+          std::map<Card::Rank, int> shoe =
+              getRemainingShoe(rules.numDecks, removed);
+          for (bool dealerChecked : {false, true}) {
+            size_t entry =
+                table.blockOffset(upcardIndex, dealerChecked) + index;
+            if (dealerChecked && !dealerCanHaveBlackjack) {
+              table.entries[entry] =
+                  table.entries[table.blockOffset(upcardIndex, false) + index];
+              continue;
+            }
+            BlackjackGame::GameState state =
+                BlackjackGame::getGameStateForComposition(
+                    {}, rankForValueIndex(upcardIndex), shoe, rules.numDecks,
+                    dealerChecked);
+            table.entries[entry] = game.calcDealerOutcomeProbs(state);
+          }
+        }
+      }
+      if (game.getMemoEntryCount() > kMaxMemoEntries) {
+        game.clearMemos();
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < threadCount; ++i) {
+    threads.emplace_back(fillEntries);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  return table;
+}
+
+DealerTable DealerTable::load(const std::string& filename,
+                              const BlackjackGame::GameRules& rules) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open dealer table " + filename);
+  }
+
+  char magic[4];
+  int32_t version, decks, hitsSoft17, maxRemovedCards;
+  uint64_t entryCount;
+  file.read(magic, sizeof(magic));
+  file.read(reinterpret_cast<char*>(&version), sizeof(version));
+  file.read(reinterpret_cast<char*>(&decks), sizeof(decks));
+  file.read(reinterpret_cast<char*>(&hitsSoft17), sizeof(hitsSoft17));
+  file.read(reinterpret_cast<char*>(&maxRemovedCards),
+            sizeof(maxRemovedCards));
+  file.read(reinterpret_cast<char*>(&entryCount), sizeof(entryCount));
+  if (!file || std::memcmp(magic, kFileMagic, sizeof(magic)) != 0 ||
+      version != kFileVersion || maxRemovedCards < 0) {
+    throw std::runtime_error(filename + " is not a dealer table file.");
+  }
+  if (decks != rules.numDecks ||
+      (hitsSoft17 != 0) != rules.dealerHitsSoft17) {
+    throw std::runtime_error("Dealer table " + filename +
+                             " was built for different rules.");
+  }
+
+  DealerTable table(decks, hitsSoft17 != 0, maxRemovedCards);
+  if (entryCount != table.entries.size()) {
+    throw std::runtime_error("Dealer table " + filename + " is corrupt.");
+  }
+  file.read(reinterpret_cast<char*>(table.entries.data()),
+            table.entries.size() * sizeof(DealerOutcomeProbabilities));
+  if (!file) {
+    throw std::runtime_error("Dealer table " + filename + " is truncated.");
+  }
+  return table;
+}
+
+void DealerTable::save(const std::string& filename) const {
+  std::ofstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open " + filename + " for writing.");
+  }
+
+  int32_t version = kFileVersion;
+  int32_t decks = numDecks;
+  int32_t hitsSoft17 = dealerHitsSoft17 ? 1 : 0;
+  int32_t removedCards = maxRemovedCards;
+  uint64_t entryCount = entries.size();
+  file.write(kFileMagic, sizeof(kFileMagic));
+  file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+  file.write(reinterpret_cast<const char*>(&decks), sizeof(decks));
+  file.write(reinterpret_cast<const char*>(&hitsSoft17), sizeof(hitsSoft17));
+  file.write(reinterpret_cast<const char*>(&removedCards),
+             sizeof(removedCards));
+  file.write(reinterpret_cast<const char*>(&entryCount), sizeof(entryCount));
+  file.write(reinterpret_cast<const char*>(entries.data()),
+             entries.size() * sizeof(DealerOutcomeProbabilities));
+  if (!file) {
+    throw std::runtime_error("Could not write dealer table " + filename);
+  }
+}
@@ -1,5 +1,6 @@
 #include "EVCalculator.h"
 
+#include <chrono>
 #include <iostream>
 #include <map>
 #include <sstream>
@@ -8,6 +9,9 @@
 
 #include "BlackjackGame.h"
 #include "BlackjackUtils.h"
+#include "InfiniteDeckGame.h"
+#include "LayeredSolver.h"
+#include "MulticardTable.h"
 
 // A private helper function to print help specific to this command
 static void print_ev_help() {
@@ -36,7 +40,34 @@ static void print_ev_help() {
       << "  --can-split-aces <bool>   Can split aces? ('true' or 'false', "
          "default: true).\n"
       << "  --max-splits <num>        Maximum number of splits allowed "
-         "(default: 3; use 0 for no splitting allowed).\n";
+         "(default: 3; use 0 for no splitting allowed).\n"
+      << "  --epsilon <p>             Replace sub-trees reached with "
+         "probability below p by an\n"
+      << "                            estimate and report a bound on the "
+         "error (default: 0, exact).\n"
+      << "  --deadline <seconds>      Tighten epsilon tenfold each pass "
+         "(starting from --epsilon or\n"
+      << "                            0.01) and report the last pass that "
+         "finished in time.\n"
+      << "  --infinite-deck <bool>    Draw every card with a fixed "
+         "probability instead of from the\n"
+      << "                            shoe; --decks is ignored ('true' or "
+         "'false', default: false).\n"
+      << "  --layered <bool>          Solve the hand layer by layer, in "
+         "parallel within each layer,\n"
+      << "                            instead of by recursion (exact only; "
+         "'true' or 'false',\n"
+      << "                            default: false).\n"
+      << "  --threads <num>           Threads for '--layered' (default: "
+         "all cores).\n"
+      << "  --multicard-table <file>  Look up a hand of 3 or more cards in "
+         "a table written by\n"
+      << "                            'strategy --multicard' instead of "
+         "solving it.\n"
+      << "  --moments <bool>          Also report the variance and skewness "
+         "of each action's payout\n"
+      << "                            (exact only; 'true' or 'false', "
+         "default: false).\n";
 }
 
 int EVCalculator::run(int argc, char* argv[]) {
@@ -46,20 +77,8 @@ int EVCalculator::run(int argc, char* argv[]) {
   }
 
   std::map<std::string, std::string> args;
-
-  // Parse command-line arguments
-  for (int i = 2; i < argc; ++i) {
-    std::string arg = argv[i];
-    if (arg.rfind("--", 0) == 0) {
-      if (i + 1 < argc) {
-        std::string key = arg.substr(2);
-        std::string value = argv[++i];
-        args[key] = value;
-      } else {
-        std::cerr << "Error: Missing value for argument " << arg << "\n";
-        return 1;
-      }
-    }
+  if (!BlackjackUtils::parseArguments(argc, argv, args)) {
+    return 1;
   }
 
   // Check for required arguments
@@ -77,104 +96,68 @@ int EVCalculator::run(int argc, char* argv[]) {
     dealerChecked = false;
   }
 
-  int numDecks = 6;
-  if (args.find("decks") != args.end()) {
-    try {
-      numDecks = std::stoi(args["decks"]);
-      if (numDecks < 1 || numDecks > 8) {
-        throw std::out_of_range("Invalid deck count. Must be between 1 and 8.");
-      }
-    } catch (const std::exception& e) {
-      std::cerr
-          << "Error: Invalid value for '--decks'. Must be an integer (1-8)."
-          << std::endl;
-      return 1;
-    }
-  }
-
-  bool dealerHitsSoft17 = true;
-  if (args.find("s17") != args.end() && args["s17"] == "false") {
-    dealerHitsSoft17 = false;
-  }
-
-  bool canDoubleAfterSplit = true;
-  if (args.find("das") != args.end() && args["das"] == "false") {
-    canDoubleAfterSplit = false;
-  }
-
-  BlackjackGame::SurrenderType surrenderType =
-      BlackjackGame::SurrenderType::Late;
-  if (args.find("surrender") != args.end()) {
-    const std::string& type = args["surrender"];
-    if (type == "none") {
-      surrenderType = BlackjackGame::SurrenderType::None;
-    } else if (type == "late") {
-      surrenderType = BlackjackGame::SurrenderType::Late;
-    } else if (type == "early") {
-      surrenderType = BlackjackGame::SurrenderType::Early;
-    } else {
-      std::cerr << "Error: Invalid value for '--surrender'. Must be "
-                   "'none', 'late', or 'early'."
-                << std::endl;
-      return 1;
-    }
+  BlackjackGame::GameRules rules;
+  int threadCount;
+  if (!BlackjackUtils::parseGameRules(args, rules) ||
+      !BlackjackUtils::parseThreadCount(args, threadCount)) {
+    return 1;
   }
 
-  double blackjackPayout = 1.5;
-  if (args.find("blackjack-payout") != args.end()) {
+  double epsilon = 0.0;
+  if (args.find("epsilon") != args.end()) {
     try {
-      blackjackPayout = std::stod(args["blackjack-payout"]);
-      if (blackjackPayout < 1.0) {
-        throw std::out_of_range(
-            "Invalid blackjack payout. Must be at least 1.0.");
+      epsilon = std::stod(args["epsilon"]);
+      if (epsilon < 0.0 || epsilon >= 1.0) {
+        throw std::out_of_range("Invalid epsilon. Must be in [0, 1).");
       }
     } catch (const std::exception& e) {
-      std::cerr
-          << "Error: Invalid value for '--blackjack-payout'. Must be a number."
-          << std::endl;
+      std::cerr << "Error: Invalid value for '--epsilon'. Must be a number "
+                   "from 0 up to (not including) 1."
+                << std::endl;
       return 1;
     }
   }
 
-  double insurancePayout = 2.0;
-  if (args.find("insurance-payout") != args.end()) {
+  double deadlineSeconds = 0.0;
+  if (args.find("deadline") != args.end()) {
     try {
-      insurancePayout = std::stod(args["insurance-payout"]);
-      if (insurancePayout < 1.0) {
-        throw std::out_of_range(
-            "Invalid insurance payout. Must be at least 1.0.");
+      deadlineSeconds = std::stod(args["deadline"]);
+      if (deadlineSeconds <= 0.0) {
+        throw std::out_of_range("Invalid deadline. Must be positive.");
       }
     } catch (const std::exception& e) {
-      std::cerr
-          << "Error: Invalid value for '--insurance-payout'. Must be a number."
-          << std::endl;
+      std::cerr << "Error: Invalid value for '--deadline'. Must be a positive "
+                   "number of seconds."
+                << std::endl;
       return 1;
     }
   }
 
-  bool canSplitAces = true;
-  if (args.find("can-split-aces") != args.end() &&
-      args["can-split-aces"] == "false") {
-    canSplitAces = false;
+  bool infiniteDeck =
+      args.count("infinite-deck") && args["infinite-deck"] == "true";
+  if (infiniteDeck && (epsilon > 0.0 || deadlineSeconds > 0.0)) {
+    std::cerr << "Error: '--infinite-deck' can't be combined with "
+                 "'--epsilon' or '--deadline'."
+              << std::endl;
+    return 1;
   }
 
-  int maxSplits = 3;
-  if (args.find("max-splits") != args.end()) {
-    try {
-      maxSplits = std::stoi(args["max-splits"]);
-      if (maxSplits < 0 || maxSplits > 3) {
-        throw std::out_of_range(
-            "Invalid max splits. Must be between 0 (splitting not allowed) and "
-            "3.");
-      }
-    } catch (const std::exception& e) {
-      std::cerr << "Error: Invalid value for '--max-splits'. Must be an "
-                   "integer (0-3)."
-                << std::endl;
-      return 1;
-    }
+  bool layered = args.count("layered") && args["layered"] == "true";
+  if (layered && (infiniteDeck || epsilon > 0.0 || deadlineSeconds > 0.0)) {
+    std::cerr << "Error: '--layered' can't be combined with "
+                 "'--infinite-deck', '--epsilon' or '--deadline'."
+              << std::endl;
+    return 1;
+  }
+  bool moments = args.count("moments") && args["moments"] == "true";
+  if (moments &&
+      (infiniteDeck || layered || epsilon > 0.0 || deadlineSeconds > 0.0)) {
+    std::cerr << "Error: '--moments' can't be combined with "
+                 "'--infinite-deck', '--layered', '--epsilon' or "
+                 "'--deadline'."
+              << std::endl;
+    return 1;
   }
-
   std::string playerCardsStr = args["player-cards"];
   std::string dealerUpcardStr = args["dealer-upcard"];
   std::vector<Card::Rank> playerRanks;
@@ -190,20 +173,84 @@ int EVCalculator::run(int argc, char* argv[]) {
   // Parse dealer upcard
   dealerUpcardRank = BlackjackUtils::stringToRank(dealerUpcardStr);
 
+  // A multi-card hand can be read from a table solved ahead of time
+  if (args.count("multicard-table")) {
+    try {
+      MulticardTable table = MulticardTable::load(args["multicard-table"]);
+      if (!table.matches(rules.numDecks, rules.dealerHitsSoft17,
+                         dealerChecked)) {
+        throw std::runtime_error(
+            "The multi-card table was solved for a different shoe, soft 17 "
+            "rule or hole card check.");
+      }
+      MulticardTable::HandCounts counts{};
+      for (Card::Rank rank : playerRanks) {
+        int value = Card(rank, Card::Suit::Spades).getValue();
+        counts[value == 11 ? 0 : value - 1]++;
+      }
+      const MulticardTable::Entry* entry = table.find(
+          Card(dealerUpcardRank, Card::Suit::Spades).getValue(), counts);
+      if (!entry) {
+        throw std::runtime_error(
+            "The multi-card table has no entry for this hand. It covers "
+            "hands of 3 to " +
+            std::to_string(table.getMaxCards()) +
+            " cards that can still act.");
+      }
+      std::cout << "Optimal Action: "
+                << BlackjackUtils::playerActionToString(entry->optimalAction)
+                << std::endl;
+      std::cout << "Optimal EV: " << entry->optimalEV << std::endl;
+      std::cout << "Margin Over Next Best Action: " << entry->margin
+                << std::endl;
+    } catch (const std::runtime_error& e) {
+      std::cerr << "Error: " << e.what() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
   // Set up the game and calculate EV
   BlackjackGame::GameState state = BlackjackGame::getGameStateForCalculation(
-      playerRanks, dealerUpcardRank, numDecks, dealerChecked);
-  BlackjackGame::GameRules rules{.numDecks = numDecks,
-                                 .dealerHitsSoft17 = dealerHitsSoft17,
-                                 .canDoubleAfterSplit = canDoubleAfterSplit,
-                                 .surrenderType = surrenderType,
-                                 .blackjackPayout = blackjackPayout,
-                                 .insurancePayout = insurancePayout,
-                                 .canSplitAces = canSplitAces,
-                                 .maxSplits = maxSplits};
+      playerRanks, dealerUpcardRank, rules.numDecks, dealerChecked);
   BlackjackGame game(rules);
   std::cout << "Calculating EV for optimal strategy..." << std::endl;
-  BlackjackGame::EVResult result = game.calculateEVForOptimalStrategy(state);
+  BlackjackGame::EVResult result;
+  if (infiniteDeck) {
+    try {
+      InfiniteDeckGame infiniteDeckGame(rules);
+      result = infiniteDeckGame.calculateEVForOptimalStrategy(
+          playerRanks, dealerUpcardRank, dealerChecked);
+    } catch (const std::exception& e) {
+      std::cerr << "Error: " << e.what() << std::endl;
+      return 1;
+    }
+  } else if (deadlineSeconds > 0.0) {
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::duration<double>(deadlineSeconds));
+    try {
+      result = game.calculateEVBeforeDeadline(
+          state, deadline, epsilon > 0.0 ? epsilon : 0.01, epsilon);
+    } catch (const BlackjackGame::DeadlineExceeded& e) {
+      std::cerr << "Error: No calculation finished within the deadline. Try "
+                   "a larger '--epsilon' or '--deadline'."
+                << std::endl;
+      return 1;
+    }
+  } else if (layered) {
+    LayeredSolver solver(rules, threadCount);
+    result = solver.calculateEVForOptimalStrategy(state);
+    const LayeredSolver::LayerStats& layerStats = solver.getLayerStats();
+    std::cout << "Solved " << layerStats.states << " player states in "
+              << layerStats.layers << " layers (widest: "
+              << layerStats.widestLayer << ") with " << threadCount
+              << " threads." << std::endl;
+  } else {
+    game.setEpsilon(epsilon);
+    game.setPayoutMoments(moments);
+    result = game.calculateEVForOptimalStrategy(state);
+  }
 
   // Output the results
   std::cout << "Hit EV: " << result.hitEV << std::endl;
@@ -215,6 +262,24 @@ int EVCalculator::run(int argc, char* argv[]) {
             << BlackjackUtils::playerActionToString(result.optimalAction)
             << std::endl;
   std::cout << "Optimal EV: " << result.optimalEV << std::endl;
+  if (epsilon > 0.0 || deadlineSeconds > 0.0) {
+    std::cout << "\nEpsilon: " << epsilon << std::endl;
+    std::cout << "Error Bound: " << result.errorBound << std::endl;
+  }
+  if (moments) {
+    auto printMoments = [](const char* action, double ev,
+                           const BlackjackGame::PayoutMoments& moments) {
+      std::cout << action << " Variance: " << moments.getVariance(ev)
+                << ", Skewness: " << moments.getSkewness(ev) << std::endl;
+    };
+    std::cout << std::endl;
+    printMoments("Hit", result.hitEV, result.hitMoments);
+    printMoments("Stand", result.standEV, result.standMoments);
+    printMoments("Split", result.splitEV, result.splitMoments);
+    printMoments("Double", result.doubleEV, result.doubleMoments);
+    printMoments("Surrender", result.surrenderEV, result.surrenderMoments);
+    printMoments("Optimal", result.optimalEV, result.optimalMoments);
+  }
 
   return 0;
 }
@@ -0,0 +1,105 @@
+// Engine.cpp
+#include "Engine.h"
+
+#include <algorithm>
+
+Engine::Engine(const BlackjackGame::GameRules& rules, const EngineOptions& options)
+    : rules(rules), options(options) {
+  int threadCount = options.threadCount;
+  if (threadCount <= 0) {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // Reject a memo storage mode the rules don't allow before the workers,
+  // which couldn't report it, start
+  BlackjackGame(rules).setMemoStorage(options.memoStorage);
+  if (options.dealerTableCards > 0) {
+    dealerTable = std::make_shared<const DealerTable>(
+        DealerTable::build(rules, options.dealerTableCards, threadCount));
+  }
+  for (int i = 0; i < threadCount; ++i) {
+    workers.emplace_back([this] { runWorker(); });
+  }
+}
+
+Engine::~Engine() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  jobAvailable.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+BlackjackGame::EVResult Engine::evaluate(
+    const BlackjackGame::GameState& state) {
+  return evaluateAsync(state).get();
+}
+
+std::vector<BlackjackGame::EVResult> Engine::evaluateBatch(
+    std::span<const BlackjackGame::GameState> states) {
+  std::vector<std::future<BlackjackGame::EVResult>> futures;
+  futures.reserve(states.size());
+  for (const auto& state : states) {
+    futures.push_back(evaluateAsync(state));
+  }
+  std::vector<BlackjackGame::EVResult> results;
+  results.reserve(states.size());
+  for (auto& future : futures) {
+    results.push_back(future.get());
+  }
+  return results;
+}
+
+std::future<BlackjackGame::EVResult> Engine::evaluateAsync(
+    const BlackjackGame::GameState& state) {
+  Job job{.state = state, .result = {}};
+  std::future<BlackjackGame::EVResult> future = job.result.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push(std::move(job));
+  }
+  jobAvailable.notify_one();
+  return future;
+}
+
+BlackjackGame::SearchStats Engine::getSearchStats() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return stats;
+}
+
+void Engine::runWorker() {
+  BlackjackGame game(rules);
+  game.setEpsilon(options.epsilon);
+  game.setDecisionsOnly(options.decisionsOnly);
+  game.setMemoStorage(options.memoStorage);
+  game.setPayoutMoments(options.payoutMoments);
+  game.setDealerTable(dealerTable);
+
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+      if (jobs.empty()) {
+        break;  // Stopping and every query has been answered
+      }
+      job = std::move(jobs.front());
+      jobs.pop();
+    }
+
+    try {
+      job.result.set_value(game.calculateEVForOptimalStrategy(job.state));
+    } catch (...) {
+      job.result.set_exception(std::current_exception());
+    }
+
+    if (game.getMemoEntryCount() > options.maxMemoEntries) {
+      game.clearMemos();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.merge(game.getSearchStats());
+    game.resetSearchStats();
+  }
+}
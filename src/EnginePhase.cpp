@@ -0,0 +1,37 @@
+// EnginePhase.cpp
+#include "EnginePhase.h"
+
+#include "HardwareCounters.h"
+
+namespace {
+// Constant-initialized, so operator new can read it without allocating
+thread_local EnginePhase::Phase threadPhase =
+    EnginePhase::Phase::PlayerRecursion;
+}  // namespace
+
+EnginePhase::Phase EnginePhase::current() { return threadPhase; }
+
+const char* EnginePhase::name(Phase phase) {
+  switch (phase) {
+    case Phase::PlayerRecursion:
+      return "Player recursion";
+    case Phase::DealerDistribution:
+      return "Dealer distribution";
+    case Phase::SplitEvaluation:
+      return "Split evaluation";
+    case Phase::Output:
+      return "Output";
+  }
+  return "Unknown";
+}
+
+EnginePhase::Scope::Scope(Phase phase) : previousPhase(threadPhase) {
+  // Events so far belong to the phase being left
+  HardwareCounters::attributeToCurrentPhase();
+  threadPhase = phase;
+}
+
+EnginePhase::Scope::~Scope() {
+  HardwareCounters::attributeToCurrentPhase();
+  threadPhase = previousPhase;
+}
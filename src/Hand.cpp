@@ -8,14 +8,20 @@
 
 Hand::Hand() {}
 
-void Hand::addCard(const Card& card) { cards.push_back(card); }
+void Hand::addCard(const Card& card) {
+  if (numCards == kMaxCards) {
+    throw std::runtime_error("A hand can't hold more than " +
+                             std::to_string(kMaxCards) + " cards.");
+  }
+  cards[numCards++] = card;
+}
 
 int Hand::getValue() const {
   int score = 0;
   int numAces = 0;
 
   // First pass: Sum card values using Ace as default 11
-  for (const auto& card : cards) {
+  for (const auto& card : getCards()) {
     if (card.getRank() == Card::Rank::Ace) {
       numAces++;  // Count no. of aces in hand
     }
@@ -36,7 +42,7 @@ bool Hand::isSoft() const {
   int numAces = 0;
   int potentialSoftScore = 0;  // Score if ace counted as 11
 
-  for (const auto& card : cards) {
+  for (const auto& card : getCards()) {
     if (card.getRank() == Card::Rank::Ace) {
       hasAce = true;
       numAces++;
@@ -56,19 +62,19 @@ bool Hand::isSoft() const {
 
 bool Hand::isBust() const { return getValue() > 21; }
 
-bool Hand::isBlackjack() const { return cards.size() == 2 && getValue() == 21; }
+bool Hand::isBlackjack() const { return numCards == 2 && getValue() == 21; }
 
 bool Hand::canSplit() const {
-  return cards.size() == 2 && cards[0].getRank() == cards[1].getRank();
+  return numCards == 2 && cards[0].getRank() == cards[1].getRank();
 }
 
-void Hand::clear() { cards.clear(); }
+void Hand::clear() { numCards = 0; }
 
 std::string Hand::toString() const {
   std::stringstream ss;
-  for (size_t i = 0; i < cards.size(); ++i) {
+  for (size_t i = 0; i < numCards; ++i) {
     ss << cards[i].toString();
-    if (i < cards.size() - 1) {
+    if (i < numCards - 1) {
       ss << " ";
     }
   }
@@ -0,0 +1,604 @@
+#include "HandAnalyzer.h"
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "BlackjackUtils.h"
+
+namespace {
+// Errors printed before the rest are only counted
+constexpr size_t kMaxErrorsPrinted = 20;
+
+// Helper function to print analyze usage information
+void print_analyze_help() {
+  std::cout
+      << "Usage: ./BlackjackLab analyze --log <file> [options]\n"
+      << "Replays a hand-history log and scores every recorded decision "
+         "against the exact EV\n"
+      << "of optimal play for the shoe composition at that point.\n"
+      << "\nOptions:\n"
+      << "  --log <file>              Hand-history log to analyze, or '-' to "
+         "read standard input.\n"
+      << "  --output <file.csv>       Write the EV of every decision to a CSV "
+         "file.\n"
+      << "  --threads <num>           Number of threads to use; shoes are "
+         "analyzed in parallel\n"
+      << "                            (default: max (recommended)).\n"
+      << "  --max-memo-entries <num>  Clear a thread's EV cache between rounds "
+         "once it holds this\n"
+      << "                            many entries (default: 4000000).\n"
+      << "  --stats <bool>            Print the number of states expanded "
+         "and memo hit rates\n"
+      << "                            ('true' or 'false', default: "
+         "false).\n"
+      << "  --validate-memo <bool>    Solve every memo hit again and check "
+         "it matches (slow;\n"
+      << "                            'true' or 'false', default: false).\n"
+      << "  Game rule flags (--decks, --s17, --das, --surrender, ...) are the "
+         "same as for 'strategy'.\n"
+      << "\nLog format (one entry per line, '#' starts a comment):\n"
+      << "  shoe                      Starts a new, freshly shuffled shoe.\n"
+      << "  seen <cards>              Cards that left the shoe outside our "
+         "hands (other seats, burn card).\n"
+      << "  round <cards> vs <upcard> : <actions> ; dealer <cards> ; result "
+         "<units>\n"
+      << "                            One round of our hand. Actions are H<card> "
+         "(hit), D<card> (double),\n"
+      << "                            S (stand), R (surrender) and P (split). "
+         "After a split, each hand\n"
+      << "                            follows in table order as '| <card> "
+         "<actions>', starting with the\n"
+      << "                            card that completed it. The dealer "
+         "section lists the hole card and\n"
+      << "                            draws, and the result section is "
+         "optional.\n"
+      << "  Example: round 8 8 vs 6 : P | 3 D9 | 10 S ; dealer 10 5 ; result "
+         "0\n";
+}
+
+// Splits a string on whitespace
+std::vector<std::string> tokenize(const std::string& text) {
+  std::stringstream ss(text);
+  std::vector<std::string> tokens;
+  std::string token;
+  while (ss >> token) {
+    tokens.push_back(token);
+  }
+  return tokens;
+}
+
+// Converts a card token to its rank with a readable error
+Card::Rank parseCard(const std::string& token) {
+  try {
+    return BlackjackUtils::stringToRank(token);
+  } catch (const std::invalid_argument& e) {
+    throw std::runtime_error("Invalid card '" + token + "'.");
+  }
+}
+
+// Joins card ranks into a hand label such as "10 6"
+std::string handLabel(const std::vector<Card::Rank>& cards) {
+  std::string label;
+  for (const auto& rank : cards) {
+    if (!label.empty()) label += " ";
+    label += BlackjackUtils::rankToString(rank);
+  }
+  return label;
+}
+
+// Returns whether a log line starts a new shoe
+bool isShoeLine(const std::string& line) {
+  std::vector<std::string> tokens = tokenize(line);
+  return !tokens.empty() && tokens[0] == "shoe";
+}
+
+// Returns whether a log line holds anything other than whitespace or comments
+bool hasContent(const std::string& line) {
+  size_t start = line.find_first_not_of(" \t\r");
+  return start != std::string::npos && line[start] != '#';
+}
+}  // namespace
+
+void AnalysisStats::merge(const AnalysisStats& other) {
+  shoes += other.shoes;
+  rounds += other.rounds;
+  decisions += other.decisions;
+  mistakes += other.mistakes;
+  invalidLines += other.invalidLines;
+  evLost += other.evLost;
+  loggedResult += other.loggedResult;
+  roundsWithResult += other.roundsWithResult;
+}
+
+bool HandAnalyzer::ShoeReader::next(ShoeBlock& block) {
+  std::lock_guard<std::mutex> lock(mutex);
+  block.lines.clear();
+  bool started = false;
+  if (hasPendingLine) {
+    block.lines.emplace_back(lineNumber, pendingLine);
+    hasPendingLine = false;
+    started = true;
+  }
+
+  std::string line;
+  while (std::getline(input, line)) {
+    ++lineNumber;
+    if (isShoeLine(line) && started) {
+      pendingLine = line;
+      hasPendingLine = true;
+      break;
+    }
+    block.lines.emplace_back(lineNumber, line);
+    started = started || hasContent(line);
+  }
+  if (!started) {
+    return false;
+  }
+  block.shoeIndex = shoesRead++;
+  return true;
+}
+
+int HandAnalyzer::run(int argc, char* argv[]) {
+  // Print help message if requested
+  if (argc > 2 && argv[2] == std::string("--help")) {
+    print_analyze_help();
+    return 0;
+  }
+
+  std::map<std::string, std::string> args;
+  if (!BlackjackUtils::parseArguments(argc, argv, args)) {
+    return 1;
+  }
+
+  AnalysisConfig config;
+  int threadCount;
+  if (!BlackjackUtils::parseGameRules(args, config.rules) ||
+      !BlackjackUtils::parseThreadCount(args, threadCount)) {
+    return 1;
+  }
+
+  if (args.find("log") == args.end()) {
+    std::cerr << "Error: Required flag '--log' is missing." << std::endl;
+    return 1;
+  }
+
+  if (args.count("max-memo-entries")) {
+    try {
+      long long entries = std::stoll(args["max-memo-entries"]);
+      if (entries < 1) {
+        throw std::out_of_range("Must be positive.");
+      }
+      config.maxMemoEntries = static_cast<size_t>(entries);
+    } catch (const std::exception& e) {
+      std::cerr << "Error: Invalid value for '--max-memo-entries'. Must be a "
+                   "positive integer."
+                << std::endl;
+      return 1;
+    }
+  }
+
+  config.printStats = args.count("stats") && args["stats"] == "true";
+  config.validateMemo =
+      args.count("validate-memo") && args["validate-memo"] == "true";
+
+  std::string outputFileName = args.count("output") ? args["output"] : "";
+  config.writeDecisions = !outputFileName.empty();
+
+  if (args["log"] == "-") {
+    return analyze(std::cin, config, threadCount, outputFileName);
+  }
+  std::ifstream logFile(args["log"]);
+  if (!logFile.is_open()) {
+    std::cerr << "Error: Could not open log file " << args["log"] << "."
+              << std::endl;
+    return 1;
+  }
+  return analyze(logFile, config, threadCount, outputFileName);
+}
+
+int HandAnalyzer::analyze(std::istream& input, const AnalysisConfig& config,
+                          int threadCount, const std::string& outputFileName) {
+  std::ofstream outputFile;
+  if (config.writeDecisions) {
+    outputFile.open(outputFileName);
+    if (!outputFile.is_open()) {
+      std::cerr << "Error: Could not open file " << outputFileName
+                << " for writing." << std::endl;
+      return 1;
+    }
+    outputFile << "Shoe,Line,Player Hand,Dealer Upcard,Action,Action EV,"
+                  "Optimal Action,Optimal EV,EV Lost\n";
+  }
+
+  std::cout << "Analyzing hand history using " << threadCount
+            << " threads...\n";
+  auto startTime = std::chrono::steady_clock::now();
+
+  // Shoes finish out of order; results are held back until every earlier
+  // shoe is done so the output is the same for any thread count
+  ShoeReader reader(input);
+  AnalysisStats totals;
+  BlackjackGame::SearchStats searchTotals;
+  std::map<long long, ShoeAnalysis> finished;
+  long long nextToReport = 0;
+  size_t errorsSeen = 0;
+  std::mutex resultsMutex;
+  std::atomic<long long> shoesAnalyzed = 0;
+  std::atomic<int> threadsFinished = 0;
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < threadCount; ++i) {
+    threads.emplace_back([&] {
+      // Each thread keeps one game so its memos stay warm within a shoe
+      BlackjackGame game(config.rules);
+      game.setValidateMemoKeys(config.validateMemo);
+      ShoeBlock block;
+      while (reader.next(block)) {
+        ShoeAnalysis analysis = analyzeShoe(block, config, game);
+        std::lock_guard<std::mutex> lock(resultsMutex);
+        finished[block.shoeIndex] = std::move(analysis);
+        while (!finished.empty() && finished.begin()->first == nextToReport) {
+          ShoeAnalysis& done = finished.begin()->second;
+          totals.merge(done.stats);
+          if (config.writeDecisions) {
+            outputFile << done.decisionRows;
+          }
+          for (const auto& error : done.errors) {
+            if (errorsSeen++ < kMaxErrorsPrinted) {
+              std::cerr << "\rWarning: " << error << std::endl;
+            }
+          }
+          finished.erase(finished.begin());
+          nextToReport++;
+        }
+        shoesAnalyzed++;
+      }
+      {
+        std::lock_guard<std::mutex> lock(resultsMutex);
+        searchTotals.merge(game.getSearchStats());
+      }
+      threadsFinished++;
+    });
+  }
+
+  // Print a progress meter as the program runs
+  while (threadsFinished < threadCount) {
+    std::cout << "\rShoes analyzed: " << shoesAnalyzed << std::flush;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+
+  // Join all threads
+  for (auto& t : threads) {
+    if (t.joinable()) {
+      t.join();
+    }
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - startTime)
+                       .count();
+
+  std::cout << "\rShoes analyzed: " << totals.shoes << "\n";
+  std::cout << "Rounds: " << totals.rounds << "\n";
+  std::cout << "Decisions: " << totals.decisions << "\n";
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "Mistakes: " << totals.mistakes << " ("
+            << (totals.decisions > 0
+                    ? 100.0 * totals.mistakes / totals.decisions
+                    : 0.0)
+            << "% of decisions)\n";
+  std::cout << std::setprecision(4);
+  std::cout << "Total EV lost: " << totals.evLost << " units";
+  if (totals.rounds > 0) {
+    std::cout << " (" << 100.0 * totals.evLost / totals.rounds
+              << " units per 100 rounds)";
+  }
+  std::cout << "\n";
+  if (totals.roundsWithResult > 0) {
+    std::cout << "Logged result: " << totals.loggedResult << " units over "
+              << totals.roundsWithResult << " rounds\n";
+  }
+  if (totals.invalidLines > 0) {
+    std::cout << "Invalid lines skipped: " << totals.invalidLines << "\n";
+  }
+  std::cout << std::setprecision(2) << "Time: " << seconds << " s ("
+            << (seconds > 0.0 ? totals.decisions / seconds : 0.0)
+            << " decisions per second)\n";
+  if (config.writeDecisions) {
+    std::cout << "Decisions written to " << outputFileName << "\n";
+  }
+  if (config.printStats || config.validateMemo) {
+    BlackjackUtils::printSearchStats(searchTotals);
+  }
+  if (searchTotals.memoMismatches > 0) {
+    std::cerr << "Error: " << searchTotals.memoMismatches
+              << " memo hits didn't match a fresh calculation." << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+ShoeAnalysis HandAnalyzer::analyzeShoe(const ShoeBlock& block,
+                                       const AnalysisConfig& config,
+                                       const BlackjackGame& game) {
+  ShoeAnalysis analysis;
+  analysis.stats.shoes = 1;
+
+  std::map<Card::Rank, int> shoeCounts;
+  for (int r = static_cast<int>(Card::Rank::Ace);
+       r <= static_cast<int>(Card::Rank::King); ++r) {
+    shoeCounts[static_cast<Card::Rank>(r)] = 4 * config.rules.numDecks;
+  }
+
+  // Memo entries are keyed by the full remaining composition, so entries from
+  // another shoe can never be hit again
+  game.clearMemos();
+
+  for (const auto& [lineNumber, line] : block.lines) {
+    if (!hasContent(line)) {
+      continue;
+    }
+    std::string text = line.substr(0, line.find('#'));
+    std::vector<std::string> tokens = tokenize(text);
+    try {
+      if (tokens[0] == "shoe") {
+        continue;
+      } else if (tokens[0] == "seen") {
+        std::vector<Card::Rank> cards;
+        for (size_t i = 1; i < tokens.size(); ++i) {
+          cards.push_back(parseCard(tokens[i]));
+        }
+        removeCards(cards, shoeCounts);
+      } else if (tokens[0] == "round") {
+        analyzeRound(text, lineNumber, block.shoeIndex, config, game,
+                     shoeCounts, analysis);
+      } else {
+        throw std::runtime_error("Unknown entry '" + tokens[0] + "'.");
+      }
+    } catch (const std::runtime_error& e) {
+      analysis.stats.invalidLines++;
+      analysis.errors.push_back("line " + std::to_string(lineNumber) + ": " +
+                                e.what());
+    }
+
+    if (game.getMemoEntryCount() > config.maxMemoEntries) {
+      game.clearMemos();
+    }
+  }
+  return analysis;
+}
+
+void HandAnalyzer::analyzeRound(const std::string& line, long long lineNumber,
+                                long long shoeIndex,
+                                const AnalysisConfig& config,
+                                const BlackjackGame& game,
+                                std::map<Card::Rank, int>& shoeCounts,
+                                ShoeAnalysis& analysis) {
+  // Split into the hand, dealer and result sections
+  std::vector<std::string> sections;
+  std::stringstream ss(line);
+  std::string section;
+  while (std::getline(ss, section, ';')) {
+    sections.push_back(section);
+  }
+
+  // Make ':' and '|' their own tokens so spacing around them doesn't matter
+  std::string handSection;
+  for (char c : sections[0]) {
+    if (c == ':' || c == '|') {
+      handSection += std::string(" ") + c + " ";
+    } else {
+      handSection += c;
+    }
+  }
+  std::vector<std::string> tokens = tokenize(handSection);
+
+  std::vector<Card::Rank> playerCards;
+  size_t pos = 1;
+  while (pos < tokens.size() && tokens[pos] != "vs") {
+    playerCards.push_back(parseCard(tokens[pos++]));
+  }
+  if (playerCards.size() != 2 || pos + 1 >= tokens.size()) {
+    throw std::runtime_error(
+        "A round must start with 'round <card> <card> vs <upcard>'.");
+  }
+  Card::Rank upcard = parseCard(tokens[pos + 1]);
+  pos += 2;
+  if (pos < tokens.size()) {
+    if (tokens[pos] != ":") {
+      throw std::runtime_error("Expected ':' before the actions.");
+    }
+    pos++;
+  }
+
+  std::vector<Card::Rank> dealerCards = {upcard};
+  AnalysisStats roundStats;
+  roundStats.rounds = 1;
+  for (size_t i = 1; i < sections.size(); ++i) {
+    std::vector<std::string> fields = tokenize(sections[i]);
+    if (fields.empty()) {
+      continue;
+    }
+    if (fields[0] == "dealer") {
+      for (size_t j = 1; j < fields.size(); ++j) {
+        dealerCards.push_back(parseCard(fields[j]));
+      }
+    } else if (fields[0] == "result" && fields.size() == 2) {
+      try {
+        roundStats.loggedResult = std::stod(fields[1]);
+        roundStats.roundsWithResult = 1;
+      } catch (const std::exception& e) {
+        throw std::runtime_error("Invalid result '" + fields[1] + "'.");
+      }
+    } else {
+      throw std::runtime_error("Unknown section '" + fields[0] + "'.");
+    }
+  }
+
+  // Play the hands in table order. A split replaces the current hand with
+  // its first card and inserts the second hand right after it.
+  std::vector<std::vector<Card::Rank>> hands = {playerCards};
+  size_t current = 0;
+  bool handFinished = false;
+  bool awaitingCard = false;
+  bool lastActionWasSplit = false;
+  std::string rows;
+
+  for (; pos < tokens.size(); ++pos) {
+    const std::string& token = tokens[pos];
+    if (token == "|") {
+      if (hands.size() == 1) {
+        throw std::runtime_error("'|' is only allowed after a split.");
+      }
+      if (!lastActionWasSplit) {
+        current++;
+      }
+      if (current >= hands.size()) {
+        throw std::runtime_error("More split hands than splits.");
+      }
+      handFinished = false;
+      awaitingCard = true;
+      lastActionWasSplit = false;
+      continue;
+    }
+    if (awaitingCard) {
+      hands[current].push_back(parseCard(token));
+      awaitingCard = false;
+      continue;
+    }
+    if (handFinished) {
+      throw std::runtime_error("Action '" + token +
+                               "' after the hand was finished.");
+    }
+
+    BlackjackGame::PlayerAction action;
+    switch (token[0]) {
+      case 'H':
+        action = BlackjackGame::PlayerAction::Hit;
+        break;
+      case 'S':
+        action = BlackjackGame::PlayerAction::Stand;
+        break;
+      case 'D':
+        action = BlackjackGame::PlayerAction::Double;
+        break;
+      case 'P':
+        action = BlackjackGame::PlayerAction::Split;
+        break;
+      case 'R':
+        action = BlackjackGame::PlayerAction::Surrender;
+        break;
+      default:
+        throw std::runtime_error("Unknown action '" + token + "'.");
+    }
+    bool drawsCard = action == BlackjackGame::PlayerAction::Hit ||
+                     action == BlackjackGame::PlayerAction::Double;
+    if (drawsCard != (token.size() > 1)) {
+      throw std::runtime_error(
+          drawsCard ? "Action '" + token + "' needs the card drawn."
+                    : "Action '" + token + "' doesn't draw a card.");
+    }
+
+    // Cards of the other hands are known, so they are out of the shoe
+    std::map<Card::Rank, int> counts = shoeCounts;
+    for (size_t h = 0; h < hands.size(); ++h) {
+      if (h != current) {
+        removeCards(hands[h], counts);
+      }
+    }
+    // With early surrender the first decision comes before the dealer checks
+    // for blackjack
+    bool dealerChecked =
+        !(config.rules.surrenderType == BlackjackGame::SurrenderType::Early &&
+          hands.size() == 1 && hands[0].size() == 2);
+    BlackjackGame::GameState state =
+        BlackjackGame::getGameStateForComposition(
+            hands[current], upcard, counts, config.rules.numDecks,
+            dealerChecked);
+    state.wasSplit = hands.size() > 1;
+    state.numPlayerHands = static_cast<int>(hands.size());
+
+    BlackjackGame::EVResult result = game.calculateEVForOptimalStrategy(state);
+    double actionEV = result.standEV;
+    if (action == BlackjackGame::PlayerAction::Hit) actionEV = result.hitEV;
+    if (action == BlackjackGame::PlayerAction::Double) {
+      actionEV = result.doubleEV;
+    }
+    if (action == BlackjackGame::PlayerAction::Split) actionEV = result.splitEV;
+    if (action == BlackjackGame::PlayerAction::Surrender) {
+      actionEV = result.surrenderEV;
+    }
+    if (std::isnan(actionEV)) {
+      throw std::runtime_error(
+          BlackjackUtils::playerActionToString(action) +
+          " is not allowed on " + handLabel(hands[current]) + ".");
+    }
+
+    double evLost = std::max(0.0, result.optimalEV - actionEV);
+    roundStats.decisions++;
+    roundStats.evLost += evLost;
+    if (evLost > 1e-9) {
+      roundStats.mistakes++;
+    }
+    if (config.writeDecisions) {
+      std::ostringstream row;
+      row << std::setprecision(6) << shoeIndex + 1 << "," << lineNumber << ","
+          << handLabel(hands[current]) << ","
+          << BlackjackUtils::rankToString(upcard) << ","
+          << BlackjackUtils::playerActionToString(action) << "," << actionEV
+          << ","
+          << BlackjackUtils::playerActionToString(result.optimalAction) << ","
+          << result.optimalEV << "," << evLost << "\n";
+      rows += row.str();
+    }
+
+    lastActionWasSplit = false;
+    if (drawsCard) {
+      hands[current].push_back(parseCard(token.substr(1)));
+      Hand hand;
+      for (const auto& rank : hands[current]) {
+        hand.addCard(Card(rank, Card::Suit::Hearts));
+      }
+      handFinished = action == BlackjackGame::PlayerAction::Double ||
+                     hand.getValue() >= 21;
+    } else if (action == BlackjackGame::PlayerAction::Split) {
+      Card::Rank splitRank = hands[current][0];
+      hands[current] = {splitRank};
+      hands.insert(hands.begin() + current + 1, {splitRank});
+      handFinished = true;
+      lastActionWasSplit = true;
+    } else {
+      handFinished = true;
+    }
+  }
+  if (awaitingCard || lastActionWasSplit) {
+    throw std::runtime_error("Every split hand needs its own '|' section.");
+  }
+
+  // The round is valid, so take all of its cards out of the shoe
+  std::vector<Card::Rank> roundCards = dealerCards;
+  for (const auto& hand : hands) {
+    roundCards.insert(roundCards.end(), hand.begin(), hand.end());
+  }
+  removeCards(roundCards, shoeCounts);
+  analysis.stats.merge(roundStats);
+  analysis.decisionRows += rows;
+}
+
+void HandAnalyzer::removeCards(const std::vector<Card::Rank>& cards,
+                               std::map<Card::Rank, int>& shoeCounts) {
+  std::map<Card::Rank, int> remaining = shoeCounts;
+  for (const auto& rank : cards) {
+    if (--remaining[rank] < 0) {
+      throw std::runtime_error("More cards of rank " +
+                               BlackjackUtils::rankToString(rank) +
+                               " than the shoe holds.");
+    }
+  }
+  shoeCounts = std::move(remaining);
+}
@@ -0,0 +1,216 @@
+// HardwareCounters.cpp
+#include "HardwareCounters.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+namespace {
+const char* const kEventNames[HardwareCounters::kNumEvents] = {
+    "Cycles",     "Instructions",  "L1D misses",
+    "LLC misses", "Branch misses", "dTLB misses"};
+
+// Stores the counters of the calling thread
+struct ThreadCounters {
+  bool counting = false;
+  int groupFd = -1;
+  int fds[HardwareCounters::kNumEvents] = {};
+  // Position of each event in a group read, or -1 if it isn't counted
+  int readIndex[HardwareCounters::kNumEvents] = {};
+  int numOpened = 0;
+  // Raw values at the last phase change: enabled time, running time, events
+  uint64_t lastEnabled = 0;
+  uint64_t lastRunning = 0;
+  uint64_t lastValues[HardwareCounters::kNumEvents] = {};
+  HardwareCounters::Counts counts;
+};
+
+thread_local ThreadCounters threadCounters;
+
+#ifdef __linux__
+// Gets the perf type and config of an event
+std::pair<uint32_t, uint64_t> getEventConfig(int event) {
+  auto cacheMiss = [](uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  };
+  switch (static_cast<HardwareCounters::Event>(event)) {
+    case HardwareCounters::Event::Cycles:
+      return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES};
+    case HardwareCounters::Event::Instructions:
+      return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS};
+    case HardwareCounters::Event::L1DMisses:
+      return {PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_L1D)};
+    case HardwareCounters::Event::LLCMisses:
+      return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES};
+    case HardwareCounters::Event::BranchMisses:
+      return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES};
+    case HardwareCounters::Event::DTLBMisses:
+      return {PERF_TYPE_HW_CACHE, cacheMiss(PERF_COUNT_HW_CACHE_DTLB)};
+  }
+  return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES};
+}
+
+// Opens an event for the calling thread in user space, as a member of a
+// group or as a new (disabled) group leader
+int openEvent(int event, int groupFd) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  auto [type, config] = getEventConfig(event);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = groupFd == -1 ? 1 : 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return static_cast<int>(
+      syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0));
+}
+
+// Reads the group and adds the events since the last read to the current
+// phase, scaled up if the kernel multiplexed the counters
+void attributeToPhase(ThreadCounters& tc) {
+  uint64_t buffer[3 + HardwareCounters::kNumEvents];
+  if (read(tc.groupFd, buffer, sizeof(buffer)) <= 0) {
+    return;
+  }
+  uint64_t enabled = buffer[1];
+  uint64_t running = buffer[2];
+  double deltaEnabled = static_cast<double>(enabled - tc.lastEnabled);
+  double deltaRunning = static_cast<double>(running - tc.lastRunning);
+  double scale = deltaRunning > 0 ? deltaEnabled / deltaRunning : 0.0;
+  auto& phaseValues =
+      tc.counts.values[static_cast<int>(EnginePhase::current())];
+  for (int event = 0; event < HardwareCounters::kNumEvents; ++event) {
+    int index = tc.readIndex[event];
+    if (index < 0) continue;
+    uint64_t value = buffer[3 + index];
+    phaseValues[event] += (value - tc.lastValues[event]) * scale;
+    tc.lastValues[event] = value;
+  }
+  tc.lastEnabled = enabled;
+  tc.lastRunning = running;
+}
+#endif
+}  // namespace
+
+void HardwareCounters::Counts::merge(const Counts& other) {
+  for (int phase = 0; phase < EnginePhase::kNumPhases; ++phase) {
+    for (int event = 0; event < kNumEvents; ++event) {
+      values[phase][event] += other.values[phase][event];
+    }
+  }
+  for (int event = 0; event < kNumEvents; ++event) {
+    available[event] = available[event] || other.available[event];
+  }
+}
+
+bool HardwareCounters::startThread(std::string& error) {
+  ThreadCounters& tc = threadCounters;
+  if (tc.counting) {
+    return true;
+  }
+#ifdef __linux__
+  tc = ThreadCounters();
+  int firstError = 0;
+  for (int event = 0; event < kNumEvents; ++event) {
+    tc.readIndex[event] = -1;
+    int fd = openEvent(event, tc.groupFd);
+    if (fd < 0) {
+      // Skip events this CPU or kernel doesn't offer
+      if (firstError == 0) firstError = errno;
+      continue;
+    }
+    if (tc.groupFd == -1) {
+      tc.groupFd = fd;
+    }
+    tc.fds[tc.numOpened] = fd;
+    tc.readIndex[event] = tc.numOpened++;
+    tc.counts.available[event] = true;
+  }
+  if (tc.groupFd == -1) {
+    error = std::string("perf_event_open failed (") + std::strerror(firstError) +
+            ")";
+    return false;
+  }
+  ioctl(tc.groupFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(tc.groupFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  tc.counting = true;
+  return true;
+#else
+  error = "hardware counters are only supported on Linux";
+  return false;
+#endif
+}
+
+HardwareCounters::Counts HardwareCounters::stopThread() {
+  ThreadCounters& tc = threadCounters;
+  if (!tc.counting) {
+    return Counts();
+  }
+#ifdef __linux__
+  attributeToPhase(tc);
+  ioctl(tc.groupFd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  for (int i = tc.numOpened - 1; i >= 0; --i) {
+    close(tc.fds[i]);
+  }
+#endif
+  tc.counting = false;
+  return tc.counts;
+}
+
+void HardwareCounters::print(const std::string& title, const Counts& counts) {
+  std::cout << "\nHardware counters (" << title << "):\n";
+  std::cout << std::left << std::setw(21) << "Phase" << std::right;
+  for (int event = 0; event < kNumEvents; ++event) {
+    std::cout << std::setw(16) << kEventNames[event];
+  }
+  std::cout << std::setw(8) << "IPC" << "\n";
+
+  auto cycles = static_cast<int>(Event::Cycles);
+  auto instructions = static_cast<int>(Event::Instructions);
+  for (int phase = 0; phase < EnginePhase::kNumPhases; ++phase) {
+    const auto& values = counts.values[phase];
+    std::cout << std::left << std::setw(21)
+              << EnginePhase::name(static_cast<EnginePhase::Phase>(phase))
+              << std::right;
+    for (int event = 0; event < kNumEvents; ++event) {
+      if (counts.available[event]) {
+        std::cout << std::setw(16) << static_cast<uint64_t>(values[event]);
+      } else {
+        std::cout << std::setw(16) << "n/a";
+      }
+    }
+    if (counts.available[cycles] && counts.available[instructions] &&
+        values[cycles] > 0) {
+      std::ostringstream ipc;
+      ipc << std::fixed << std::setprecision(2)
+          << values[instructions] / values[cycles];
+      std::cout << std::setw(8) << ipc.str();
+    } else {
+      std::cout << std::setw(8) << "n/a";
+    }
+    std::cout << "\n";
+  }
+}
+
+void HardwareCounters::attributeToCurrentPhase() {
+#ifdef __linux__
+  if (threadCounters.counting) {
+    attributeToPhase(threadCounters);
+  }
+#endif
+}
@@ -0,0 +1,295 @@
+// InfiniteDeckGame.cpp
+#include "InfiniteDeckGame.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+// Gets the value of a rank with an Ace counted as 1
+int cardValue(Card::Rank rank) {
+  int value = Card(rank, Card::Suit::Hearts).getValue();
+  return value == 11 ? 1 : value;
+}
+
+// All ranks in the order they are drawn
+constexpr Card::Rank kRanks[] = {
+    Card::Rank::Ace,  Card::Rank::Two,   Card::Rank::Three, Card::Rank::Four,
+    Card::Rank::Five, Card::Rank::Six,   Card::Rank::Seven, Card::Rank::Eight,
+    Card::Rank::Nine, Card::Rank::Ten,   Card::Rank::Jack,  Card::Rank::Queen,
+    Card::Rank::King};
+}  // namespace
+
+InfiniteDeckGame::InfiniteDeckGame(const BlackjackGame::GameRules& rules)
+    : rules(rules) {
+  for (Card::Rank rank : kRanks) {
+    valueProbabilities[cardValue(rank)] += kRankProbability;
+  }
+  solveDealerChain();
+
+  for (int upcardValue = 2; upcardValue <= 11; ++upcardValue) {
+    bool dealerCanHaveBlackjack = upcardValue >= 10;
+    for (bool dealerChecked : {false, true}) {
+      UpcardTables& tables =
+          upcardTables[(upcardValue - 2) * 2 + (dealerChecked ? 1 : 0)];
+      tables.dealer = calcDealerOutcomeProbs(upcardValue, dealerChecked);
+      solvePlayerValues(tables);
+
+      // Same surrender window as BlackjackGame::calculateEVForSurrender
+      tables.canSurrender =
+          rules.surrenderType != BlackjackGame::SurrenderType::None;
+      if (dealerCanHaveBlackjack) {
+        if (rules.surrenderType == BlackjackGame::SurrenderType::Late &&
+            !dealerChecked) {
+          tables.canSurrender = false;
+        }
+        if (rules.surrenderType == BlackjackGame::SurrenderType::Early &&
+            dealerChecked) {
+          tables.canSurrender = false;
+        }
+      }
+    }
+  }
+}
+
+int InfiniteDeckGame::handIndexAfterCard(int index, int cardValue) {
+  int hardTotal = std::min(index / 2 + cardValue, 31);
+  return handIndex(hardTotal, index % 2 == 1 || cardValue == 1);
+}
+
+int InfiniteDeckGame::handValue(int index) {
+  return isSoftHand(index) ? index / 2 + 10 : index / 2;
+}
+
+bool InfiniteDeckGame::isSoftHand(int index) {
+  return index % 2 == 1 && index / 2 + 10 <= 21;
+}
+
+const InfiniteDeckGame::UpcardTables& InfiniteDeckGame::getTables(
+    Card::Rank dealerUpcard, bool dealerChecked) const {
+  int upcardValue = Card(dealerUpcard, Card::Suit::Hearts).getValue();
+  return upcardTables[(upcardValue - 2) * 2 + (dealerChecked ? 1 : 0)];
+}
+
+bool InfiniteDeckGame::dealerStands(int index) const {
+  int value = handValue(index);
+  if (value == 17 && isSoftHand(index)) {
+    return !rules.dealerHitsSoft17;
+  }
+  return value >= 17;
+}
+
+void InfiniteDeckGame::solveDealerChain() {
+  for (int index = 0; index < kNumHandStates; ++index) {
+    if (index / 2 > 21 || dealerStands(index)) {
+      continue;  // Absorbing
+    }
+    for (int value = 1; value <= 10; ++value) {
+      dealerTransition[index][handIndexAfterCard(index, value)] +=
+          valueProbabilities[value];
+    }
+  }
+
+  // Every card raises the total with Aces counted as 1, so solving from the
+  // highest total down only reads hands that are already solved
+  for (int index = kNumHandStates - 1; index >= 0; --index) {
+    if (index / 2 > 21) {
+      dealerAbsorption[index][5] = 1.0;  // Bust
+    } else if (dealerStands(index)) {
+      dealerAbsorption[index][handValue(index) - 17] = 1.0;
+    } else {
+      for (int next = index + 1; next < kNumHandStates; ++next) {
+        if (dealerTransition[index][next] == 0.0) continue;
+        for (int total = 0; total < kNumDealerTotals; ++total) {
+          dealerAbsorption[index][total] +=
+              dealerTransition[index][next] * dealerAbsorption[next][total];
+        }
+      }
+    }
+  }
+}
+
+InfiniteDeckGame::DealerOutcomeProbabilities
+InfiniteDeckGame::calcDealerOutcomeProbs(int upcardValue,
+                                         bool dealerChecked) const {
+  int upcardIndex = handIndexAfterCard(handIndex(0, false),
+                                       upcardValue == 11 ? 1 : upcardValue);
+  int blackjackValue = upcardValue == 10 ? 1 : (upcardValue == 11 ? 10 : 0);
+
+  DealerOutcomeProbabilities outcomes;
+  std::array<double, kNumDealerTotals> totals = {};
+  double holeCardMass = 0.0;
+  for (int value = 1; value <= 10; ++value) {
+    if (value == blackjackValue) {
+      if (!dealerChecked) {
+        outcomes.prob_blackjack += valueProbabilities[value];
+        holeCardMass += valueProbabilities[value];
+      }
+      continue;
+    }
+    holeCardMass += valueProbabilities[value];
+    const auto& absorption =
+        dealerAbsorption[handIndexAfterCard(upcardIndex, value)];
+    for (int total = 0; total < kNumDealerTotals; ++total) {
+      totals[total] += valueProbabilities[value] * absorption[total];
+    }
+  }
+
+  outcomes.prob_17 = totals[0] / holeCardMass;
+  outcomes.prob_18 = totals[1] / holeCardMass;
+  outcomes.prob_19 = totals[2] / holeCardMass;
+  outcomes.prob_20 = totals[3] / holeCardMass;
+  outcomes.prob_21 = totals[4] / holeCardMass;
+  outcomes.prob_bust = totals[5] / holeCardMass;
+  outcomes.prob_blackjack /= holeCardMass;
+  return outcomes;
+}
+
+void InfiniteDeckGame::solvePlayerValues(UpcardTables& tables) const {
+  const DealerOutcomeProbabilities& dealer = tables.dealer;
+  const double dealerTotals[] = {dealer.prob_17, dealer.prob_18,
+                                 dealer.prob_19, dealer.prob_20,
+                                 dealer.prob_21};
+
+  // Hitting only raises the total with Aces counted as 1, so solving from the
+  // highest total down is backward induction over the player's hands
+  for (int index = kNumHandStates - 1; index >= 0; --index) {
+    if (index / 2 > 21) {
+      tables.standEV[index] = -1.0;
+      tables.hitEV[index] = std::nan("");
+      tables.optimalEV[index] = -1.0;
+      continue;
+    }
+
+    int playerTotal = handValue(index);
+    double standEV = dealer.prob_bust - dealer.prob_blackjack;
+    for (int dealerTotal = 17; dealerTotal <= 21; ++dealerTotal) {
+      if (playerTotal > dealerTotal) standEV += dealerTotals[dealerTotal - 17];
+      if (playerTotal < dealerTotal) standEV -= dealerTotals[dealerTotal - 17];
+    }
+    tables.standEV[index] = standEV;
+
+    double hitEV = std::nan("");
+    if (playerTotal < 21) {
+      hitEV = 0.0;
+      for (int value = 1; value <= 10; ++value) {
+        hitEV += valueProbabilities[value] *
+                 tables.optimalEV[handIndexAfterCard(index, value)];
+      }
+    }
+    tables.hitEV[index] = hitEV;
+    tables.optimalEV[index] =
+        std::isnan(hitEV) ? standEV : std::max(standEV, hitEV);
+  }
+}
+
+InfiniteDeckGame::EVResult InfiniteDeckGame::calculateEVForTwoCardHand(
+    Card::Rank firstRank, Card::Rank secondRank, const UpcardTables& tables,
+    bool wasSplit, int numPlayerHands) const {
+  int index = handIndexAfterCard(
+      handIndexAfterCard(handIndex(0, false), cardValue(firstRank)),
+      cardValue(secondRank));
+  bool isBlackjack = handValue(index) == 21;
+
+  EVResult result;
+  // Win with blackjack payout unless dealer also has blackjack (push)
+  result.standEV = isBlackjack
+                       ? (1 - tables.dealer.prob_blackjack) *
+                             rules.blackjackPayout
+                       : tables.standEV[index];
+  result.hitEV = tables.hitEV[index];
+
+  result.doubleEV = std::nan("");
+  if (!isBlackjack && (!wasSplit || rules.canDoubleAfterSplit)) {
+    result.doubleEV = 0.0;
+    for (int value = 1; value <= 10; ++value) {
+      result.doubleEV += 2 * valueProbabilities[value] *
+                         tables.standEV[handIndexAfterCard(index, value)];
+    }
+  }
+
+  result.surrenderEV = tables.canSurrender ? -0.5 : std::nan("");
+
+  // Like BlackjackGame, one split hand is played out and its EV doubled
+  result.splitEV = std::nan("");
+  if (firstRank == secondRank && numPlayerHands < rules.maxSplits + 1 &&
+      (firstRank != Card::Rank::Ace || rules.canSplitAces)) {
+    double singleHandEV = 0.0;
+    for (Card::Rank rank : kRanks) {
+      singleHandEV += kRankProbability *
+                      calculateEVForTwoCardHand(firstRank, rank, tables, true,
+                                                numPlayerHands + 1)
+                          .optimalEV;
+    }
+    result.splitEV = 2 * singleHandEV;
+  }
+
+  // Record the optimal action and its EV in the result
+  result.optimalEV = result.standEV;
+  result.optimalAction = PlayerAction::Stand;
+  if (!std::isnan(result.hitEV) && result.hitEV > result.optimalEV) {
+    result.optimalEV = result.hitEV;
+    result.optimalAction = PlayerAction::Hit;
+  }
+  if (!std::isnan(result.doubleEV) && result.doubleEV > result.optimalEV) {
+    result.optimalEV = result.doubleEV;
+    result.optimalAction = PlayerAction::Double;
+  }
+  if (!std::isnan(result.splitEV) && result.splitEV > result.optimalEV) {
+    result.optimalEV = result.splitEV;
+    result.optimalAction = PlayerAction::Split;
+  }
+  if (!std::isnan(result.surrenderEV) &&
+      result.surrenderEV > result.optimalEV) {
+    result.optimalEV = result.surrenderEV;
+    result.optimalAction = PlayerAction::Surrender;
+  }
+  return result;
+}
+
+InfiniteDeckGame::EVResult InfiniteDeckGame::calculateEVForOptimalStrategy(
+    const std::vector<Card::Rank>& playerRanks, Card::Rank dealerUpcard,
+    bool dealerChecked) const {
+  if (playerRanks.size() < 2) {
+    throw std::runtime_error("At least two player cards are needed.");
+  }
+  const UpcardTables& tables = getTables(dealerUpcard, dealerChecked);
+  if (playerRanks.size() == 2) {
+    return calculateEVForTwoCardHand(playerRanks[0], playerRanks[1], tables,
+                                     false, 1);
+  }
+
+  int index = handIndex(0, false);
+  for (Card::Rank rank : playerRanks) {
+    index = handIndexAfterCard(index, cardValue(rank));
+  }
+  // If player hand is busted, EV is always -1
+  if (index / 2 > 21) {
+    EVResult bust;
+    bust.hitEV = bust.standEV = bust.splitEV = bust.doubleEV =
+        bust.surrenderEV = bust.optimalEV = -1.0;
+    bust.optimalAction = PlayerAction::None;
+    return bust;
+  }
+
+  // Only hitting and standing are allowed after the first two cards
+  EVResult result;
+  result.standEV = tables.standEV[index];
+  result.hitEV = tables.hitEV[index];
+  result.doubleEV = std::nan("");
+  result.splitEV = std::nan("");
+  result.surrenderEV = std::nan("");
+  result.optimalEV = result.standEV;
+  result.optimalAction = PlayerAction::Stand;
+  if (!std::isnan(result.hitEV) && result.hitEV > result.optimalEV) {
+    result.optimalEV = result.hitEV;
+    result.optimalAction = PlayerAction::Hit;
+  }
+  return result;
+}
+
+const InfiniteDeckGame::DealerOutcomeProbabilities&
+InfiniteDeckGame::getDealerOutcomeProbs(Card::Rank dealerUpcard,
+                                        bool dealerChecked) const {
+  return getTables(dealerUpcard, dealerChecked).dealer;
+}
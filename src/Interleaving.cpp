@@ -0,0 +1,58 @@
+// Interleaving.cpp
+#include "Interleaving.h"
+
+#include <new>
+#include <vector>
+
+namespace {
+// Frames freed by the calling thread, by size. A search only uses a few
+// coroutine functions, so a short list of sizes covers it.
+struct FramePool {
+  struct SizeClass {
+    size_t bytes;
+    std::vector<void*> frames;
+  };
+  std::vector<SizeClass> sizeClasses;
+
+  std::vector<void*>& framesOfSize(size_t bytes) {
+    for (SizeClass& sizeClass : sizeClasses) {
+      if (sizeClass.bytes == bytes) {
+        return sizeClass.frames;
+      }
+    }
+    sizeClasses.push_back({bytes, {}});
+    return sizeClasses.back().frames;
+  }
+};
+
+thread_local FramePool framePool;
+thread_local Interleaving::Scheduler* currentScheduler = nullptr;
+}  // namespace
+
+void* Interleaving::allocateFrame(size_t bytes) {
+  std::vector<void*>& frames = framePool.framesOfSize(bytes);
+  if (frames.empty()) {
+    return ::operator new(bytes);
+  }
+  void* frame = frames.back();
+  frames.pop_back();
+  return frame;
+}
+
+void Interleaving::freeFrame(void* frame, size_t bytes) {
+  framePool.framesOfSize(bytes).push_back(frame);
+}
+
+bool Interleaving::Scheduler::resumeNext() {
+  if (ready.empty()) {
+    return false;
+  }
+  std::coroutine_handle<> handle = ready.front();
+  ready.pop_front();
+  handle.resume();
+  return true;
+}
+
+Interleaving::Scheduler*& Interleaving::Scheduler::current() {
+  return currentScheduler;
+}
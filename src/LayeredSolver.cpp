@@ -0,0 +1,361 @@
+// LayeredSolver.cpp
+#include "LayeredSolver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <thread>
+
+LayeredSolver::LayeredSolver(const BlackjackGame::GameRules& rules,
+                             int threadCount) {
+  size_t numWorkers = std::max(1, threadCount);
+  workers.reserve(numWorkers);
+  for (size_t i = 0; i < numWorkers; ++i) {
+    workers.emplace_back(rules);
+  }
+  if (numWorkers > 1) {
+    memoShards.reserve(numWorkers);
+    for (size_t i = 0; i < numWorkers; ++i) {
+      memoShards.emplace_back(rules);
+    }
+    for (BlackjackGame& worker : workers) {
+      for (const BlackjackGame& shard : memoShards) {
+        worker.sharedMemos.push_back(shard.memos);
+      }
+    }
+  }
+}
+
+BlackjackGame::EVResult LayeredSolver::calculateEVForOptimalStrategy(
+    const BlackjackGame::GameState& state) {
+  // A busted hand has no states to lay out
+  if (state.playerHand.isBust()) {
+    return workers[0].calculateEVForOptimalStrategy(state);
+  }
+  limitMemos();
+
+  std::vector<Layer> layers = enumerateLayers(state);
+  layerStats = LayerStats();
+  layerStats.layers = static_cast<int>(layers.size());
+  for (const Layer& layer : layers) {
+    layerStats.states += layer.size();
+    layerStats.widestLayer =
+        std::max<uint64_t>(layerStats.widestLayer, layer.size());
+  }
+
+  // The deepest layer only stands, so it needs no results below it
+  std::vector<BlackjackGame::EVResult> results;
+  while (!layers.empty()) {
+    results = evaluateLayer(layers.back(), results);
+    layers.pop_back();
+    shareMemos();
+  }
+  return results[0];
+}
+
+void LayeredSolver::setDealerTable(std::shared_ptr<const DealerTable> table) {
+  for (BlackjackGame& worker : workers) {
+    worker.setDealerTable(table);
+  }
+}
+
+void LayeredSolver::shareMemos() {
+  if (memoShards.empty()) {
+    return;
+  }
+  size_t numShards = memoShards.size();
+  // First each thread sorts one worker's new entries by shard, then each
+  // fills one shard. The workers are idle between layers, so the shards can
+  // change.
+  std::vector<std::vector<std::vector<const DealerEntry*>>> dealerEntries(
+      workers.size(), std::vector<std::vector<const DealerEntry*>>(numShards));
+  std::vector<std::vector<std::vector<const StandEntry*>>> standEntries(
+      workers.size(), std::vector<std::vector<const StandEntry*>>(numShards));
+  runInParallel(workers.size(), [&](size_t worker) {
+    for (const DealerEntry& entry : workers[worker].memos->dealer) {
+      dealerEntries[worker][BlackjackGame::getMemoShard(
+                                std::get<BlackjackGame::DeckCounts>(entry.first),
+                                numShards)]
+          .push_back(&entry);
+    }
+    for (const StandEntry& entry : workers[worker].memos->stand) {
+      standEntries[worker][BlackjackGame::getMemoShard(
+                               std::get<BlackjackGame::DeckCounts>(entry.first),
+                               numShards)]
+          .push_back(&entry);
+    }
+  });
+  runInParallel(numShards, [&](size_t shardIndex) {
+    BlackjackGame::Memos& shard = *memoShards[shardIndex].memos;
+    for (size_t worker = 0; worker < workers.size(); ++worker) {
+      for (const DealerEntry* entry : dealerEntries[worker][shardIndex]) {
+        shard.dealer.try_emplace(entry->first, entry->second);
+      }
+      for (const StandEntry* entry : standEntries[worker][shardIndex]) {
+        shard.stand.try_emplace(entry->first, entry->second);
+      }
+    }
+  });
+  for (BlackjackGame& worker : workers) {
+    worker.clearMemos();
+  }
+}
+
+void LayeredSolver::limitMemos() {
+  size_t entries = 0;
+  for (const BlackjackGame& game : workers) {
+    entries += game.getMemoEntryCount();
+  }
+  for (const BlackjackGame& game : memoShards) {
+    entries += game.getMemoEntryCount();
+  }
+  if (entries <= kMaxMemoEntries) {
+    return;
+  }
+  for (BlackjackGame& game : workers) {
+    game.clearMemos();
+  }
+  for (BlackjackGame& game : memoShards) {
+    game.clearMemos();
+  }
+  // Clearing moved the shards' memos
+  for (BlackjackGame& worker : workers) {
+    for (size_t i = 0; i < memoShards.size(); ++i) {
+      worker.sharedMemos[i] = memoShards[i].memos;
+    }
+  }
+}
+
+void LayeredSolver::runInParallel(size_t numThreads,
+                                  const std::function<void(size_t)>& work) {
+  if (numThreads <= 1) {
+    work(0);
+    return;
+  }
+  std::exception_ptr error;
+  std::mutex errorMutex;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < numThreads; ++t) {
+    threads.emplace_back([&, t] {
+      try {
+        work(t);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+BlackjackGame::SearchStats LayeredSolver::getSearchStats() const {
+  BlackjackGame::SearchStats stats;
+  for (const BlackjackGame& worker : workers) {
+    stats.merge(worker.getSearchStats());
+  }
+  return stats;
+}
+
+std::vector<LayeredSolver::Layer> LayeredSolver::enumerateLayers(
+    const BlackjackGame::GameState& state) const {
+  const BlackjackGame& game = workers[0];
+  std::vector<Layer> layers;
+  layers.push_back(
+      {Node{.state = state, .hitChildren = {}, .splitChildren = {}}});
+
+  while (true) {
+    Layer& layer = layers.back();
+    Layer next;
+    // States with the same memo key have the same results, so they share
+    // one node, just as they share a memo entry in the recursive search
+    std::map<BlackjackGame::PlayerMemoKey, int32_t> nextIndices;
+    auto addChild = [&](const BlackjackGame::GameState& child) {
+      if (child.playerHand.isBust()) {
+        return kBust;
+      }
+      auto [it, inserted] = nextIndices.try_emplace(
+          game.getPlayerMemoKey(child), static_cast<int32_t>(next.size()));
+      if (inserted) {
+        next.push_back(
+            Node{.state = child, .hitChildren = {}, .splitChildren = {}});
+      }
+      return it->second;
+    };
+
+    for (Node& node : layer) {
+      node.hitChildren.fill(kNoChild);
+      node.splitChildren.fill(kNoChild);
+      const BlackjackGame::GameState& nodeState = node.state;
+      // Doubling draws the same cards as hitting, so it needs no more states
+      bool canHit = nodeState.playerHand.getValue() < 21;
+      bool canSplit =
+          game.canSplitHand(nodeState.playerHand, nodeState.numPlayerHands);
+      BlackjackGame::GameState singleHandState;
+      if (canSplit) {
+        singleHandState = game.getGameStateAfterSplit(
+            nodeState, nodeState.playerHand.getCards()[0]);
+      }
+      for (int r = 1; r <= 13; ++r) {
+        if (nodeState.remainingCardCounts[r] == 0) {
+          continue;
+        }
+        Card::Rank rank = static_cast<Card::Rank>(r);
+        if (canHit) {
+          node.hitChildren[r] =
+              addChild(game.getGameStateMinusCardToPlayer(nodeState, rank));
+        }
+        if (canSplit) {
+          node.splitChildren[r] = addChild(
+              game.getGameStateMinusCardToPlayer(singleHandState, rank));
+        }
+      }
+    }
+
+    if (next.empty()) {
+      break;
+    }
+    sortByComposition(next, layer);
+    layers.push_back(std::move(next));
+  }
+  return layers;
+}
+
+void LayeredSolver::sortByComposition(Layer& layer, Layer& parents) const {
+  const BlackjackGame& game = workers[0];
+  std::vector<BlackjackGame::DeckCounts> counts;
+  counts.reserve(layer.size());
+  for (const Node& node : layer) {
+    counts.push_back(game.convertToDeckCounts(node.state.remainingCardCounts));
+  }
+  std::vector<int32_t> order(layer.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&counts](int32_t a, int32_t b) {
+    return counts[a] < counts[b];
+  });
+
+  std::vector<int32_t> newIndices(layer.size());
+  Layer sorted;
+  sorted.reserve(layer.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    newIndices[order[i]] = static_cast<int32_t>(i);
+    sorted.push_back(layer[order[i]]);
+  }
+  layer = std::move(sorted);
+  for (Node& parent : parents) {
+    for (int r = 1; r <= 13; ++r) {
+      if (parent.hitChildren[r] >= 0) {
+        parent.hitChildren[r] = newIndices[parent.hitChildren[r]];
+      }
+      if (parent.splitChildren[r] >= 0) {
+        parent.splitChildren[r] = newIndices[parent.splitChildren[r]];
+      }
+    }
+  }
+}
+
+std::vector<BlackjackGame::EVResult> LayeredSolver::evaluateLayer(
+    const Layer& layer,
+    const std::vector<BlackjackGame::EVResult>& childResults) {
+  std::vector<BlackjackGame::EVResult> results(layer.size());
+  // Neighbouring states in the sorted layer share most of their dealer
+  // sub-trees, so each worker takes one contiguous slice. Small layers
+  // aren't worth starting threads for.
+  size_t numThreads = std::min(workers.size(),
+                               (layer.size() + kMinSliceSize - 1) /
+                                   kMinSliceSize);
+  runInParallel(numThreads, [&](size_t worker) {
+    size_t begin = layer.size() * worker / numThreads;
+    size_t end = layer.size() * (worker + 1) / numThreads;
+    for (size_t i = begin; i < end; ++i) {
+      results[i] = evaluateNode(workers[worker], layer[i], childResults);
+    }
+  });
+  return results;
+}
+
+BlackjackGame::EVResult LayeredSolver::evaluateNode(
+    const BlackjackGame& game, const Node& node,
+    const std::vector<BlackjackGame::EVResult>& childResults) {
+  const BlackjackGame::GameState& state = node.state;
+  game.stats.playerNodes++;
+
+  // Each action sums its draws in rank order, as the recursive search does
+  auto childEV = [&childResults](int32_t child, bool stand) {
+    if (child == kBust) {
+      return -1.0;
+    }
+    return stand ? childResults[child].standEV : childResults[child].optimalEV;
+  };
+
+  BlackjackGame::EVResult result;
+  double standError;
+  result.standEV = game.calculateEVForStand(state, standError);
+
+  result.hitEV = std::nan("");
+  if (state.playerHand.getValue() < 21) {
+    result.hitEV = 0.0;
+    for (int r = 1; r <= 13; ++r) {
+      if (node.hitChildren[r] == kNoChild) {
+        continue;
+      }
+      double probDrawCard =
+          game.getCardDrawProbability(state, static_cast<Card::Rank>(r));
+      if (probDrawCard == 0.0) {
+        continue;
+      }
+      result.hitEV += probDrawCard * childEV(node.hitChildren[r], false);
+    }
+  }
+
+  result.doubleEV = std::nan("");
+  if (state.playerHand.getCards().size() == 2 &&
+      state.playerHand.getValue() != 21 &&
+      (!state.wasSplit || game.canDoubleAfterSplit)) {
+    result.doubleEV = 0.0;
+    for (int r = 1; r <= 13; ++r) {
+      if (node.hitChildren[r] == kNoChild) {
+        continue;
+      }
+      double probDrawCard =
+          game.getCardDrawProbability(state, static_cast<Card::Rank>(r));
+      if (probDrawCard == 0.0) {
+        continue;
+      }
+      result.doubleEV += 2 * probDrawCard * childEV(node.hitChildren[r], true);
+    }
+  }
+
+  result.surrenderEV = game.calculateEVForSurrender(state);
+
+  result.splitEV = std::nan("");
+  if (game.canSplitHand(state.playerHand, state.numPlayerHands)) {
+    // The split hand is dealt from the same shoe as this state
+    double singleHandEV = 0.0;
+    for (int r = 1; r <= 13; ++r) {
+      if (node.splitChildren[r] == kNoChild) {
+        continue;
+      }
+      double probDrawCard =
+          game.getCardDrawProbability(state, static_cast<Card::Rank>(r));
+      if (probDrawCard == 0.0) {
+        continue;
+      }
+      singleHandEV += probDrawCard * childEV(node.splitChildren[r], false);
+    }
+    result.splitEV = 2 * singleHandEV;
+  }
+
+  result.errorBound = 0.0;
+  BlackjackGame::chooseOptimalAction(result);
+  return result;
+}
@@ -0,0 +1,323 @@
+// MulticardTable.cpp
+#include "MulticardTable.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include "DealerTable.h"
+
+namespace {
+// Identifies multi-card strategy files and their layout
+constexpr char kFileMagic[4] = {'B', 'J', 'M', 'C'};
+constexpr int32_t kFileVersion = 1;
+// Bytes of a packed record: the key, the action and two floats
+constexpr size_t kRecordBytes = 5 + 1 + 4 + 4;
+
+// Number of card values (A, 2-9, 10)
+constexpr int kNumValues = 10;
+constexpr int kAceIndex = 0;
+constexpr int kTenIndex = 9;
+
+// Gets the value index (aces first) of a card value (1 or 11 = Ace, 2-10)
+int valueIndexOf(int value) {
+  return value == 1 || value == 11 ? kAceIndex : value - 1;
+}
+
+// Gets the rank of the i-th card of a value index in a hand. Tens are taken
+// from the kings first, like the dealer table, so they never run out.
+Card::Rank rankForValueIndex(int valueIndex, int i) {
+  if (valueIndex == kAceIndex) return Card::Rank::Ace;
+  if (valueIndex != kTenIndex) return static_cast<Card::Rank>(valueIndex + 1);
+  const Card::Rank tenRanks[] = {Card::Rank::King, Card::Rank::Queen,
+                                 Card::Rank::Jack, Card::Rank::Ten};
+  return tenRanks[i % 4];
+}
+
+// Adds every hand of exactly cardsLeft more cards, from value indices
+// valueIndex and up, whose hard total stays at most 20
+void enumerateHands(const MulticardTable::HandCounts& available,
+                    int valueIndex, int cardsLeft, int hardTotal,
+                    MulticardTable::HandCounts& counts,
+                    std::vector<MulticardTable::HandCounts>& hands) {
+  if (cardsLeft == 0) {
+    // A soft 21 has nothing left to decide
+    bool soft21 = counts[kAceIndex] > 0 && hardTotal == 11;
+    if (!soft21) {
+      hands.push_back(counts);
+    }
+    return;
+  }
+  if (valueIndex == kNumValues) {
+    return;
+  }
+  int value = valueIndex == kAceIndex ? 1 : valueIndex + 1;
+  for (int n = 0; n <= std::min(cardsLeft, available[valueIndex]) &&
+                  hardTotal + n * value <= 20;
+       ++n) {
+    counts[valueIndex] = n;
+    enumerateHands(available, valueIndex + 1, cardsLeft - n,
+                   hardTotal + n * value, counts, hands);
+  }
+  counts[valueIndex] = 0;
+}
+
+// Gets the EV of an action in a result
+double getActionEV(const BlackjackGame::EVResult& result,
+                   BlackjackGame::PlayerAction action) {
+  switch (action) {
+    case BlackjackGame::PlayerAction::Hit:
+      return result.hitEV;
+    case BlackjackGame::PlayerAction::Stand:
+      return result.standEV;
+    case BlackjackGame::PlayerAction::Double:
+      return result.doubleEV;
+    case BlackjackGame::PlayerAction::Split:
+      return result.splitEV;
+    case BlackjackGame::PlayerAction::Surrender:
+      return result.surrenderEV;
+    default:
+      return result.optimalEV;
+  }
+}
+}  // namespace
+
+MulticardTable::MulticardTable(int numDecks, bool dealerHitsSoft17,
+                               bool dealerChecked, int maxCards)
+    : numDecks(numDecks),
+      dealerHitsSoft17(dealerHitsSoft17),
+      dealerChecked(dealerChecked),
+      maxCards(maxCards),
+      blockStarts(kNumValues * (maxCards - 2) + 1, 0) {}
+
+uint64_t MulticardTable::packKey(const HandCounts& counts) {
+  uint64_t key = 0;
+  for (int valueIndex = 0; valueIndex < kNumValues; ++valueIndex) {
+    key |= static_cast<uint64_t>(counts[valueIndex]) << (4 * valueIndex);
+  }
+  return key;
+}
+
+MulticardTable MulticardTable::build(
+    const BlackjackGame::GameRules& rules, bool dealerChecked, int maxCards,
+    int threadCount, BlackjackGame::MemoStorage memoStorage,
+    std::shared_ptr<const DealerTable> dealerTable) {
+  if (maxCards < 3 || maxCards > kMaxCardsLimit) {
+    throw std::runtime_error("A multi-card table holds hands of 3 to " +
+                             std::to_string(kMaxCardsLimit) + " cards.");
+  }
+  MulticardTable table(rules.numDecks, rules.dealerHitsSoft17, dealerChecked,
+                       maxCards);
+  int blocksPerUpcard = maxCards - 2;
+  std::vector<std::vector<Entry>> blocks(kNumValues * blocksPerUpcard);
+
+  // Each thread claims whole upcards and keeps its memos for all of an
+  // upcard's hands, clearing them only before the next upcard
+  std::atomic<int> nextUpcard = 0;
+  auto solveUpcards = [&] {
+    BlackjackGame game(rules);
+    game.setMemoStorage(memoStorage);
+    game.setDealerTable(dealerTable);
+    int upcardIndex;
+    while ((upcardIndex = nextUpcard++) < kNumValues) {
+      game.clearMemos();
+      Card::Rank upcard = rankForValueIndex(upcardIndex, 3);
+      HandCounts available;
+      for (int valueIndex = 0; valueIndex < kNumValues; ++valueIndex) {
+        available[valueIndex] =
+            (valueIndex == kTenIndex ? 16 : 4) * rules.numDecks -
+            (valueIndex == upcardIndex ? 1 : 0);
+      }
+
+      for (int cardCount = 3; cardCount <= maxCards; ++cardCount) {
+        std::vector<HandCounts> hands;
+        HandCounts counts{};
+        enumerateHands(available, 0, cardCount, 0, counts, hands);
+
+        std::vector<Entry>& block =
+            blocks[upcardIndex * blocksPerUpcard + cardCount - 3];
+        block.reserve(hands.size());
+        for (const HandCounts& hand : hands) {
+          std::vector<Card::Rank> playerRanks;
+          for (int valueIndex = 0; valueIndex < kNumValues; ++valueIndex) {
+            for (int i = 0; i < hand[valueIndex]; ++i) {
+              playerRanks.push_back(rankForValueIndex(valueIndex, i));
+            }
+          }
+          BlackjackGame::GameState state =
+              BlackjackGame::getGameStateForCalculation(
+                  playerRanks, upcard, rules.numDecks, dealerChecked);
+          BlackjackGame::EVResult result =
+              game.calculateEVForOptimalStrategy(state);
+
+          // The margin is how much is lost by the best of the other actions
+          double nextBestEV = -std::numeric_limits<double>::infinity();
+          for (BlackjackGame::PlayerAction action :
+               {BlackjackGame::PlayerAction::Hit,
+                BlackjackGame::PlayerAction::Stand,
+                BlackjackGame::PlayerAction::Double,
+                BlackjackGame::PlayerAction::Split,
+                BlackjackGame::PlayerAction::Surrender}) {
+            double ev = getActionEV(result, action);
+            if (action != result.optimalAction && !std::isnan(ev)) {
+              nextBestEV = std::max(nextBestEV, ev);
+            }
+          }
+          block.push_back(
+              {.key = packKey(hand),
+               .optimalEV = static_cast<float>(result.optimalEV),
+               .margin = static_cast<float>(result.optimalEV - nextBestEV),
+               .optimalAction = result.optimalAction});
+        }
+        std::sort(block.begin(), block.end(),
+                  [](const Entry& a, const Entry& b) { return a.key < b.key; });
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < std::min(threadCount, kNumValues); ++i) {
+    threads.emplace_back(solveUpcards);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  for (size_t block = 0; block < blocks.size(); ++block) {
+    table.blockStarts[block] = table.entries.size();
+    table.entries.insert(table.entries.end(), blocks[block].begin(),
+                         blocks[block].end());
+  }
+  table.blockStarts.back() = table.entries.size();
+  return table;
+}
+
+const MulticardTable::Entry* MulticardTable::find(
+    int upcardValue, const HandCounts& counts) const {
+  int cardCount = 0;
+  for (int count : counts) {
+    if (count < 0 || count > kMaxCardsLimit) {
+      return nullptr;
+    }
+    cardCount += count;
+  }
+  if (cardCount < 3 || cardCount > maxCards) {
+    return nullptr;
+  }
+  size_t block = blockIndex(valueIndexOf(upcardValue), cardCount);
+  uint64_t key = packKey(counts);
+  auto begin = entries.begin() + blockStarts[block];
+  auto end = entries.begin() + blockStarts[block + 1];
+  auto found = std::lower_bound(
+      begin, end, key,
+      [](const Entry& entry, uint64_t key) { return entry.key < key; });
+  return found != end && found->key == key ? &*found : nullptr;
+}
+
+size_t MulticardTable::getEntryCount(int cardCount) const {
+  if (cardCount < 3 || cardCount > maxCards) {
+    return 0;
+  }
+  size_t count = 0;
+  for (int upcardIndex = 0; upcardIndex < kNumValues; ++upcardIndex) {
+    size_t block = blockIndex(upcardIndex, cardCount);
+    count += blockStarts[block + 1] - blockStarts[block];
+  }
+  return count;
+}
+
+MulticardTable MulticardTable::load(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open multi-card table " + filename);
+  }
+
+  char magic[4];
+  int32_t version, decks, hitsSoft17, checked, maxCards;
+  uint64_t entryCount;
+  file.read(magic, sizeof(magic));
+  file.read(reinterpret_cast<char*>(&version), sizeof(version));
+  file.read(reinterpret_cast<char*>(&decks), sizeof(decks));
+  file.read(reinterpret_cast<char*>(&hitsSoft17), sizeof(hitsSoft17));
+  file.read(reinterpret_cast<char*>(&checked), sizeof(checked));
+  file.read(reinterpret_cast<char*>(&maxCards), sizeof(maxCards));
+  file.read(reinterpret_cast<char*>(&entryCount), sizeof(entryCount));
+  if (!file || std::memcmp(magic, kFileMagic, sizeof(magic)) != 0 ||
+      version != kFileVersion || maxCards < 3 || maxCards > kMaxCardsLimit) {
+    throw std::runtime_error(filename + " is not a multi-card table file.");
+  }
+
+  MulticardTable table(decks, hitsSoft17 != 0, checked != 0, maxCards);
+  file.read(reinterpret_cast<char*>(table.blockStarts.data()),
+            table.blockStarts.size() * sizeof(uint64_t));
+  std::vector<char> records(entryCount * kRecordBytes);
+  file.read(records.data(), records.size());
+  if (!file) {
+    throw std::runtime_error("Multi-card table " + filename +
+                             " is truncated.");
+  }
+  if (table.blockStarts.back() != entryCount ||
+      !std::is_sorted(table.blockStarts.begin(), table.blockStarts.end())) {
+    throw std::runtime_error("Multi-card table " + filename + " is corrupt.");
+  }
+
+  table.entries.resize(entryCount);
+  const char* record = records.data();
+  for (Entry& entry : table.entries) {
+    entry.key = 0;
+    for (int byte = 0; byte < 5; ++byte) {
+      entry.key |= static_cast<uint64_t>(static_cast<uint8_t>(record[byte]))
+                   << (8 * byte);
+    }
+    entry.optimalAction = static_cast<PlayerAction>(record[5]);
+    std::memcpy(&entry.optimalEV, record + 6, sizeof(float));
+    std::memcpy(&entry.margin, record + 10, sizeof(float));
+    record += kRecordBytes;
+  }
+  return table;
+}
+
+void MulticardTable::save(const std::string& filename) const {
+  std::ofstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open " + filename + " for writing.");
+  }
+
+  int32_t version = kFileVersion;
+  int32_t decks = numDecks;
+  int32_t hitsSoft17 = dealerHitsSoft17 ? 1 : 0;
+  int32_t checked = dealerChecked ? 1 : 0;
+  int32_t cards = maxCards;
+  uint64_t entryCount = entries.size();
+  file.write(kFileMagic, sizeof(kFileMagic));
+  file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+  file.write(reinterpret_cast<const char*>(&decks), sizeof(decks));
+  file.write(reinterpret_cast<const char*>(&hitsSoft17), sizeof(hitsSoft17));
+  file.write(reinterpret_cast<const char*>(&checked), sizeof(checked));
+  file.write(reinterpret_cast<const char*>(&cards), sizeof(cards));
+  file.write(reinterpret_cast<const char*>(&entryCount), sizeof(entryCount));
+  file.write(reinterpret_cast<const char*>(blockStarts.data()),
+             blockStarts.size() * sizeof(uint64_t));
+
+  // Keys only use 40 bits, and the action fits in a byte
+  std::vector<char> records(entries.size() * kRecordBytes);
+  char* record = records.data();
+  for (const Entry& entry : entries) {
+    for (int byte = 0; byte < 5; ++byte) {
+      record[byte] = static_cast<char>(entry.key >> (8 * byte));
+    }
+    record[5] = static_cast<char>(entry.optimalAction);
+    std::memcpy(record + 6, &entry.optimalEV, sizeof(float));
+    std::memcpy(record + 10, &entry.margin, sizeof(float));
+    record += kRecordBytes;
+  }
+  file.write(records.data(), records.size());
+  if (!file) {
+    throw std::runtime_error("Could not write multi-card table " + filename);
+  }
+}
@@ -0,0 +1,39 @@
+// Rng.cpp
+#include "Rng.h"
+
+Rng::Rng(uint64_t seed) {
+  // Expand the seed with splitmix64 so that similar seeds give unrelated states
+  for (auto& word : state) {
+    seed += 0x9E3779B97F4A7C15ULL;
+    uint64_t z = seed;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    word = z ^ (z >> 31);
+  }
+}
+
+Rng Rng::forStream(uint64_t seed, int streamIndex) {
+  Rng rng(seed);
+  for (int i = 0; i < streamIndex; ++i) {
+    rng.jump();
+  }
+  return rng;
+}
+
+void Rng::jump() {
+  static const uint64_t kJump[] = {0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL,
+                                   0xA9582618E03FC9AAULL,
+                                   0x39ABDC4529B1661CULL};
+  std::array<uint64_t, 4> jumped = {};
+  for (uint64_t word : kJump) {
+    for (int bit = 0; bit < 64; ++bit) {
+      if (word & (uint64_t{1} << bit)) {
+        for (int i = 0; i < 4; ++i) {
+          jumped[i] ^= state[i];
+        }
+      }
+      next();
+    }
+  }
+  state = jumped;
+}
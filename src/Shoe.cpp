@@ -0,0 +1,58 @@
+// Shoe.cpp
+#include "Shoe.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+Shoe::Shoe(int numDecks, double penetration)
+    : numDecks(numDecks), numCards(numDecks * 52) {
+  if (numDecks < 1 || numDecks > kMaxDecks) {
+    throw std::invalid_argument("Invalid deck count for shoe");
+  }
+  if (penetration <= 0.0 || penetration > 1.0) {
+    throw std::invalid_argument("Invalid shoe penetration");
+  }
+
+  int index = 0;
+  for (int d = 0; d < numDecks * 4; ++d) {
+    for (int r = static_cast<int>(Card::Rank::Ace);
+         r <= static_cast<int>(Card::Rank::King); ++r) {
+      cards[index++] = encode(static_cast<Card::Rank>(r));
+    }
+  }
+  cutCard = static_cast<int>(numCards * penetration);
+  // Start exhausted so the first deal triggers a shuffle
+  nextCard = numCards;
+}
+
+uint8_t Shoe::encode(Card::Rank rank) {
+  if (rank == Card::Rank::Ace) {
+    return kAce;
+  }
+  int value = static_cast<int>(rank);
+  return static_cast<uint8_t>(value > 10 ? 10 : value);
+}
+
+void Shoe::shuffle(Rng& rng) {
+  // Fisher-Yates shuffle
+  for (int i = numCards - 1; i > 0; --i) {
+    int j = static_cast<int>(rng.nextBelow(static_cast<uint32_t>(i + 1)));
+    uint8_t tmp = cards[i];
+    cards[i] = cards[j];
+    cards[j] = tmp;
+  }
+  nextCard = 0;
+  runningCount = 0;
+}
+
+int Shoe::getTrueCount() const {
+  // Integer floor of running count / decks remaining. Never divide by less
+  // than half a deck so the last cards don't explode the count.
+  int remaining = std::max(26, getRemainingCardsCount());
+  int scaled = runningCount * 52;
+  int trueCount = scaled / remaining;
+  if (scaled % remaining != 0 && scaled < 0) {
+    trueCount--;
+  }
+  return trueCount;
+}
@@ -0,0 +1,644 @@
+#include "Simulator.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BlackjackUtils.h"
+
+namespace {
+// Maximum number of hands a player can hold after splitting (3 splits)
+constexpr int kMaxHands = 4;
+
+// Minimal hand representation for simulation: running hard total plus an ace
+// flag, which is all that is needed to derive the soft/hard total. Round state
+// is trivially constructible so unused seats cost nothing; value-initialize
+// ({}) before use.
+struct SimHand {
+  int hardTotal;
+  int numCards;
+  uint8_t firstCard;
+  bool hasAce;
+  bool fromSplit;
+  bool doubled;
+
+  void addCard(uint8_t card) {
+    if (numCards == 0) {
+      firstCard = card;
+    }
+    hardTotal += card;
+    hasAce |= (card == Shoe::kAce);
+    numCards++;
+  }
+  bool isSoft() const { return hasAce && hardTotal + 10 <= 21; }
+  int getValue() const { return isSoft() ? hardTotal + 10 : hardTotal; }
+  bool isBust() const { return hardTotal > 21; }
+  bool isPair() const {
+    return numCards == 2 && firstCard == hardTotal - firstCard;
+  }
+};
+
+// One seat's hands and bet during a round
+struct SeatRound {
+  std::array<SimHand, kMaxHands> hands;
+  int numHands;
+  double bet;
+  double net;
+  bool settled;  // Result already decided (blackjack or surrender)
+};
+
+// Splits an option value into its entries
+std::vector<std::string> splitList(const std::string& list, char separator) {
+  std::vector<std::string> entries;
+  std::stringstream ss(list);
+  std::string entry;
+  while (std::getline(ss, entry, separator)) {
+    entries.push_back(entry);
+  }
+  return entries;
+}
+
+// Helper function to print simulate usage information
+void print_simulate_help() {
+  std::cout
+      << "Usage: ./BlackjackLab simulate [options]\n"
+      << "Plays rounds from a shuffled shoe using fixed strategy charts and "
+         "reports the measured EV.\n"
+      << "\nOptions:\n"
+      << "  --hands <num>             Number of rounds to play (default: "
+         "10000000).\n"
+      << "  --seats <num>             Number of seats at the table sharing "
+         "the shoe (1-7, default: 1).\n"
+      << "  --strategies <list>       Comma-separated strategy per seat: "
+         "'basic' for the built-in basic\n"
+      << "                            strategy or a strategy CSV written by "
+         "the strategy command.\n"
+      << "                            A single entry applies to every seat "
+         "(default: basic).\n"
+      << "  --bet-ramps <list>        Comma-separated bet ramp per seat: "
+         "units bet at Hi-Lo true count\n"
+      << "                            1, 2, 3... separated by '/' (e.g. "
+         "'1/2/4/8'), or 'flat'.\n"
+      << "                            A single entry applies to every seat "
+         "(default: flat).\n"
+      << "  --penetration <fraction>  Fraction of the shoe dealt before "
+         "reshuffling (default: 0.75).\n"
+      << "  --tc-output <file.csv>    Write seat 1's frequency, EV and "
+         "variance per Hi-Lo true count\n"
+      << "                            (input for the bankroll command).\n"
+      << "  --seed <num>              Seed for reproducible runs (default: "
+         "random).\n"
+      << "  --threads <num>           Number of threads to use (default: "
+         "max (recommended)).\n"
+      << "  --decks <num>             Number of decks in play (default: "
+         "6).\n"
+      << "  --s17 <bool>              Does dealer hit on soft 17? ('true' "
+         "or 'false', default: true).\n"
+      << "  --das <bool>              Can double after split? ('true' or "
+         "'false', default: true).\n"
+      << "  --surrender <type>        Surrender type ('none', 'late', or "
+         "'early', default: late).\n"
+      << "  --blackjack-payout <num>  Payout for blackjack (default: "
+         "1.5).\n"
+      << "  --can-split-aces <bool>   Can split aces? ('true' or 'false', "
+         "default: true).\n"
+      << "  --max-splits <num>        Maximum number of splits allowed "
+         "(default: 3; use 0 for no splitting allowed).\n";
+}
+
+// Picks the charted action for a hand, falling back to hit or stand when the
+// charted action is not allowed in the current situation
+BlackjackGame::PlayerAction chooseAction(const BlackjackGame::GameRules& rules,
+                                         const StrategyTable& strategy,
+                                         const SimHand& hand, int upcard,
+                                         int numHands, bool canSurrender) {
+  using PlayerAction = BlackjackGame::PlayerAction;
+
+  PlayerAction action = PlayerAction::None;
+  if (hand.isPair()) {
+    action = strategy.pairAction(hand.firstCard, upcard);
+    bool splitAllowed = numHands < rules.maxSplits + 1 &&
+                        (hand.firstCard != Shoe::kAce || rules.canSplitAces);
+    if (action == PlayerAction::Split && !splitAllowed) {
+      action = PlayerAction::None;
+    }
+  }
+  if (action == PlayerAction::None) {
+    action = strategy.totalAction(hand.getValue(), hand.isSoft(), upcard);
+  }
+
+  if (action == PlayerAction::Double &&
+      (hand.numCards != 2 || (hand.fromSplit && !rules.canDoubleAfterSplit))) {
+    action = (hand.isSoft() && hand.getValue() >= 18) ? PlayerAction::Stand
+                                                      : PlayerAction::Hit;
+  }
+  if (action == PlayerAction::Surrender && !canSurrender) {
+    action =
+        hand.getValue() >= 17 ? PlayerAction::Stand : PlayerAction::Hit;
+  }
+  return action;
+}
+}  // namespace
+
+void SeatStats::merge(const SeatStats& other) {
+  handsPlayed += other.handsPlayed;
+  blackjacks += other.blackjacks;
+  doubles += other.doubles;
+  splits += other.splits;
+  surrenders += other.surrenders;
+  totalInitialBet += other.totalInitialBet;
+  totalWagered += other.totalWagered;
+  totalNet += other.totalNet;
+  totalNetSquared += other.totalNetSquared;
+  for (int bin = 0; bin < kNumTrueCountBins; ++bin) {
+    byTrueCount[bin].rounds += other.byTrueCount[bin].rounds;
+    byTrueCount[bin].totalNet += other.byTrueCount[bin].totalNet;
+    byTrueCount[bin].totalNetSquared += other.byTrueCount[bin].totalNetSquared;
+  }
+}
+
+void SimulationStats::merge(const SimulationStats& other) {
+  rounds += other.rounds;
+  shuffles += other.shuffles;
+  cardsDealt += other.cardsDealt;
+  cardsDealtSquared += other.cardsDealtSquared;
+  for (int seat = 0; seat < kMaxSeats; ++seat) {
+    seats[seat].merge(other.seats[seat]);
+  }
+}
+
+int Simulator::run(int argc, char* argv[]) {
+  // Print help message if requested
+  if (argc > 2 && argv[2] == std::string("--help")) {
+    print_simulate_help();
+    return 0;
+  }
+
+  std::map<std::string, std::string> args;
+  if (!BlackjackUtils::parseArguments(argc, argv, args)) {
+    return 1;
+  }
+
+  SimulationConfig config;
+  if (!BlackjackUtils::parseGameRules(args, config.rules) ||
+      !BlackjackUtils::parseThreadCount(args, config.threadCount)) {
+    return 1;
+  }
+
+  if (args.count("hands")) {
+    try {
+      config.numRounds = std::stoull(args["hands"]);
+      if (config.numRounds == 0) {
+        throw std::out_of_range("Invalid hand count. Must be at least 1.");
+      }
+    } catch (const std::exception& e) {
+      std::cerr << "Error: Invalid value for '--hands'. Must be a positive "
+                   "integer."
+                << std::endl;
+      return 1;
+    }
+  }
+
+  if (args.count("penetration")) {
+    try {
+      config.penetration = std::stod(args["penetration"]);
+      if (config.penetration <= 0.0 || config.penetration > 1.0) {
+        throw std::out_of_range("Invalid penetration. Must be in (0, 1].");
+      }
+    } catch (const std::exception& e) {
+      std::cerr << "Error: Invalid value for '--penetration'. Must be a "
+                   "number greater than 0 and at most 1."
+                << std::endl;
+      return 1;
+    }
+  }
+
+  if (args.count("seed")) {
+    try {
+      config.seed = std::stoull(args["seed"]);
+    } catch (const std::exception& e) {
+      std::cerr << "Error: Invalid value for '--seed'. Must be a non-negative "
+                   "integer."
+                << std::endl;
+      return 1;
+    }
+  } else {
+    std::random_device rd;
+    config.seed = (static_cast<uint64_t>(rd()) << 32) | rd();
+  }
+
+  int numSeats = 1;
+  if (args.count("seats")) {
+    try {
+      numSeats = std::stoi(args["seats"]);
+      if (numSeats < 1 || numSeats > kMaxSeats) {
+        throw std::out_of_range("Invalid seat count. Must be between 1 and 7.");
+      }
+    } catch (const std::exception& e) {
+      std::cerr << "Error: Invalid value for '--seats'. Must be an integer "
+                   "(1-7)."
+                << std::endl;
+      return 1;
+    }
+  }
+
+  std::vector<std::string> strategySources =
+      splitList(args.count("strategies") ? args["strategies"] : "basic", ',');
+  std::vector<std::string> betRamps =
+      splitList(args.count("bet-ramps") ? args["bet-ramps"] : "flat", ',');
+  if ((strategySources.size() != 1 &&
+       strategySources.size() != static_cast<size_t>(numSeats)) ||
+      (betRamps.size() != 1 &&
+       betRamps.size() != static_cast<size_t>(numSeats))) {
+    std::cerr << "Error: '--strategies' and '--bet-ramps' need either one "
+                 "entry or one entry per seat."
+              << std::endl;
+    return 1;
+  }
+
+  // Load each distinct strategy source once
+  std::map<std::string, StrategyTable> strategies;
+  for (const auto& source : strategySources) {
+    if (strategies.count(source)) {
+      continue;
+    }
+    if (source == "basic") {
+      strategies[source] = StrategyTable::basic();
+      continue;
+    }
+    try {
+      strategies[source] = StrategyTable::fromCSV(source);
+    } catch (const std::runtime_error& e) {
+      std::cerr << "Error: " << e.what() << std::endl;
+      return 1;
+    }
+  }
+
+  for (int seat = 0; seat < numSeats; ++seat) {
+    SeatConfig seatConfig;
+    seatConfig.strategy =
+        strategies[strategySources[strategySources.size() == 1 ? 0 : seat]];
+    const std::string& ramp = betRamps[betRamps.size() == 1 ? 0 : seat];
+    try {
+      seatConfig.betRamp = BlackjackUtils::parseBetRamp(ramp);
+    } catch (const std::exception& e) {
+      std::cerr << "Error: Invalid bet ramp '" << ramp
+                << "'. Must be 'flat' or positive bets separated by '/'."
+                << std::endl;
+      return 1;
+    }
+    config.countsCards |= seatConfig.betRamp.size() > 1;
+    config.seats.push_back(seatConfig);
+  }
+
+  if (args.count("tc-output")) {
+    config.trueCountOutput = args["tc-output"];
+    config.countsCards = true;
+  }
+
+  return simulate(config);
+}
+
+int Simulator::simulate(const SimulationConfig& config) {
+  const int numSeats = static_cast<int>(config.seats.size());
+  std::cout << "Simulating " << config.numRounds << " rounds at " << numSeats
+            << (numSeats == 1 ? " seat" : " seats") << " using "
+            << config.threadCount << " threads (seed " << config.seed
+            << ")...\n";
+
+  std::vector<SimulationStats> threadStats(config.threadCount);
+  std::atomic<uint64_t> roundsCompleted = 0;
+  std::vector<std::thread> threads;
+
+  auto startTime = std::chrono::steady_clock::now();
+
+  // Split the rounds evenly, giving the remainder to the first threads. Each
+  // thread plays its own independent shoe.
+  uint64_t roundsPerThread = config.numRounds / config.threadCount;
+  uint64_t remainder = config.numRounds % config.threadCount;
+  for (int i = 0; i < config.threadCount; ++i) {
+    uint64_t rounds = roundsPerThread + (static_cast<uint64_t>(i) < remainder);
+    threads.emplace_back([&, i, rounds] {
+      simulateChunk(config, i, rounds, threadStats[i], roundsCompleted);
+    });
+  }
+
+  // Print a progress meter as the program runs
+  while (roundsCompleted < config.numRounds) {
+    int currentProgress =
+        static_cast<int>((roundsCompleted * 100) / config.numRounds);
+    std::cout << "\rProgress: " << currentProgress << "%" << std::flush;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
+  std::cout << "\rProgress: 100%\n";
+
+  for (auto& t : threads) {
+    if (t.joinable()) {
+      t.join();
+    }
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - startTime)
+                       .count();
+
+  SimulationStats totals;
+  for (const auto& stats : threadStats) {
+    totals.merge(stats);
+  }
+
+  double n = static_cast<double>(totals.rounds);
+  double cardsMean = totals.cardsDealt / n;
+  double cardsVariance =
+      std::max(0.0, totals.cardsDealtSquared / n - cardsMean * cardsMean);
+
+  std::cout << std::fixed << std::setprecision(6);
+  std::cout << "Rounds: " << totals.rounds << "\n";
+  std::cout << "Cards per round: " << cardsMean << " (sd "
+            << std::sqrt(cardsVariance) << ")\n";
+  std::cout << "Rounds per shoe: "
+            << (totals.shuffles > 0 ? n / totals.shuffles : n) << "\n";
+
+  for (int seat = 0; seat < numSeats; ++seat) {
+    const SeatStats& stats = totals.seats[seat];
+    // EV per round with a 95% confidence interval from the sample variance
+    double mean = stats.totalNet / n;
+    double variance = std::max(0.0, stats.totalNetSquared / n - mean * mean);
+    double standardError = std::sqrt(variance / n);
+
+    std::cout << "\nSeat " << seat + 1 << ":\n";
+    std::cout << "Hands played (including splits): " << stats.handsPlayed
+              << "\n";
+    std::cout << "EV per round (units): " << mean << " +/- "
+              << 1.96 * standardError << " (95% CI)\n";
+    std::cout << "EV per unit of initial bet: "
+              << stats.totalNet / stats.totalInitialBet << "\n";
+    std::cout << "EV per unit wagered: " << stats.totalNet / stats.totalWagered
+              << "\n";
+    std::cout << "Average initial bet: " << stats.totalInitialBet / n << "\n";
+    std::cout << "Standard deviation per round: " << std::sqrt(variance)
+              << "\n";
+    std::cout << "Blackjacks: " << stats.blackjacks / n
+              << " | Doubles: " << stats.doubles / n
+              << " | Splits: " << stats.splits / n
+              << " | Surrenders: " << stats.surrenders / n
+              << " (per round)\n";
+  }
+
+  std::cout << std::setprecision(0) << "\nSpeed: " << n / seconds
+            << " rounds/second, " << n * numSeats / seconds
+            << " hands/second (" << std::setprecision(2) << seconds << " s)"
+            << std::endl;
+
+  if (!config.trueCountOutput.empty()) {
+    return writeTrueCountCSV(config.trueCountOutput, totals, config);
+  }
+  return 0;
+}
+
+int Simulator::writeTrueCountCSV(const std::string& filename,
+                                 const SimulationStats& totals,
+                                 const SimulationConfig& config) {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Error: Could not open file " << filename << " for writing."
+              << std::endl;
+    return 1;
+  }
+
+  const BlackjackGame::GameRules& rules = config.rules;
+  file << "#Simulated Hi-Lo true count results for seat 1\n";
+  file << "#Number of Decks: " << rules.numDecks << "\n";
+  file << "#Dealer Hits Soft 17: " << (rules.dealerHitsSoft17 ? "Yes" : "No")
+       << "\n";
+  file << "#Penetration: " << config.penetration << "\n";
+  file << "#Seats: " << config.seats.size() << "\n";
+  file << "#Rounds: " << totals.rounds << "\n";
+  file << "True Count,Frequency,EV,Variance\n";
+  file << std::setprecision(10);
+  const SeatStats& seat = totals.seats[0];
+  for (int bin = 0; bin < kNumTrueCountBins; ++bin) {
+    const TrueCountStats& stats = seat.byTrueCount[bin];
+    if (stats.rounds == 0) {
+      continue;
+    }
+    double n = static_cast<double>(stats.rounds);
+    double mean = stats.totalNet / n;
+    double variance = std::max(0.0, stats.totalNetSquared / n - mean * mean);
+    file << bin + kMinTrackedTrueCount << "," << n / totals.rounds << ","
+         << mean << "," << variance << "\n";
+  }
+  std::cout << "True count table written to " << filename << "\n";
+  return 0;
+}
+
+void Simulator::simulateChunk(const SimulationConfig& config, int streamIndex,
+                              uint64_t numRounds, SimulationStats& stats,
+                              std::atomic<uint64_t>& roundsCompleted) {
+  Rng rng = Rng::forStream(config.seed, streamIndex);
+  Shoe shoe(config.rules.numDecks, config.penetration);
+  // Accumulate locally and publish once so the hot loop never writes to
+  // memory shared with other threads
+  SimulationStats local;
+
+  const uint64_t kProgressBatch = 1 << 16;
+  uint64_t sinceLastReport = 0;
+  for (uint64_t round = 0; round < numRounds; ++round) {
+    // The cut card is only checked between rounds
+    if (shoe.isCutCardReached()) {
+      shoe.shuffle(rng);
+      local.shuffles++;
+    }
+    playRound(config, shoe, rng, local);
+    local.rounds++;
+
+    if (++sinceLastReport == kProgressBatch) {
+      roundsCompleted += sinceLastReport;
+      sinceLastReport = 0;
+    }
+  }
+  roundsCompleted += sinceLastReport;
+  stats = local;
+}
+
+void Simulator::playRound(const SimulationConfig& config, Shoe& shoe, Rng& rng,
+                          SimulationStats& stats) {
+  using PlayerAction = BlackjackGame::PlayerAction;
+  const BlackjackGame::GameRules& rules = config.rules;
+  const int numSeats = static_cast<int>(config.seats.size());
+
+  // Everything for the round lives on the stack; nothing is allocated
+  std::array<SeatRound, kMaxSeats> seats;
+  SimHand dealer{};
+  int cardsThisRound = 0;
+  auto dealCard = [&]() {
+    cardsThisRound++;
+    return shoe.dealCard(rng);
+  };
+
+  // Bets are placed on the count before any card of the round is seen
+  const int trueCount = config.countsCards ? shoe.getTrueCount() : 0;
+  for (int s = 0; s < numSeats; ++s) {
+    seats[s] = SeatRound{};
+    seats[s].numHands = 1;
+    seats[s].bet = config.seats[s].betForTrueCount(trueCount);
+  }
+
+  // Deal in casino order: one card to each seat, dealer upcard, a second card
+  // to each seat, dealer hole card
+  for (int s = 0; s < numSeats; ++s) {
+    seats[s].hands[0].addCard(dealCard());
+  }
+  dealer.addCard(dealCard());
+  for (int s = 0; s < numSeats; ++s) {
+    seats[s].hands[0].addCard(dealCard());
+  }
+  dealer.addCard(dealCard());
+  const int upcard = dealer.firstCard;
+
+  bool dealerBlackjack = dealer.getValue() == 21;
+  bool dealerCanHaveBlackjack = upcard == Shoe::kAce || upcard == 10;
+  bool canSurrender = rules.surrenderType != BlackjackGame::SurrenderType::None;
+
+  for (int s = 0; s < numSeats; ++s) {
+    SeatRound& seat = seats[s];
+    SeatStats& seatStats = stats.seats[s];
+    bool playerBlackjack = seat.hands[0].getValue() == 21;
+    seatStats.totalInitialBet += seat.bet;
+    seatStats.totalWagered += seat.bet;
+
+    // Early surrender is decided before the dealer checks for blackjack
+    if (rules.surrenderType == BlackjackGame::SurrenderType::Early &&
+        dealerCanHaveBlackjack && !playerBlackjack &&
+        chooseAction(rules, config.seats[s].strategy, seat.hands[0], upcard, 1,
+                     true) == PlayerAction::Surrender) {
+      seatStats.surrenders++;
+      seat.net = -0.5 * seat.bet;
+      seat.settled = true;
+      continue;
+    }
+
+    // Dealer peeks; a dealer blackjack ends the round for every seat
+    if (dealerBlackjack) {
+      seat.net = playerBlackjack ? 0.0 : -seat.bet;
+      seat.settled = true;
+    } else if (playerBlackjack) {
+      seat.net = rules.blackjackPayout * seat.bet;
+      seat.settled = true;
+    }
+    if (playerBlackjack) {
+      seatStats.blackjacks++;
+    }
+  }
+
+  // Each seat plays out its hands in order
+  bool anyLive = false;
+  for (int s = 0; s < numSeats && !dealerBlackjack; ++s) {
+    SeatRound& seat = seats[s];
+    SeatStats& seatStats = stats.seats[s];
+    if (seat.settled) {
+      continue;
+    }
+    const StrategyTable& strategy = config.seats[s].strategy;
+
+    for (int h = 0; h < seat.numHands && !seat.settled; ++h) {
+      SimHand& hand = seat.hands[h];
+      while (true) {
+        // Split hands receive their second card when they are played
+        if (hand.numCards < 2) {
+          hand.addCard(dealCard());
+        }
+        if (hand.getValue() >= 21) {
+          break;
+        }
+
+        PlayerAction action = chooseAction(
+            rules, strategy, hand, upcard, seat.numHands,
+            canSurrender && seat.numHands == 1 && hand.numCards == 2);
+        if (action == PlayerAction::Stand) {
+          break;
+        } else if (action == PlayerAction::Hit) {
+          hand.addCard(dealCard());
+        } else if (action == PlayerAction::Double) {
+          hand.doubled = true;
+          hand.addCard(dealCard());
+          seatStats.doubles++;
+          seatStats.totalWagered += seat.bet;
+          break;
+        } else if (action == PlayerAction::Surrender) {
+          seatStats.surrenders++;
+          seat.net = -0.5 * seat.bet;
+          seat.settled = true;
+          break;
+        } else if (action == PlayerAction::Split) {
+          SimHand splitHand{};
+          splitHand.addCard(hand.firstCard);
+          splitHand.fromSplit = true;
+          hand = splitHand;
+          seat.hands[seat.numHands++] = splitHand;
+          seatStats.splits++;
+          seatStats.totalWagered += seat.bet;
+        }
+      }
+    }
+
+    for (int h = 0; h < seat.numHands && !seat.settled; ++h) {
+      anyLive |= !seat.hands[h].isBust();
+    }
+  }
+
+  // Dealer only draws if at least one hand is still live
+  if (anyLive) {
+    while (dealer.getValue() < 17 ||
+           (dealer.getValue() == 17 && dealer.isSoft() &&
+            rules.dealerHitsSoft17)) {
+      dealer.addCard(dealCard());
+    }
+  }
+
+  int dealerTotal = dealer.getValue();
+  for (int s = 0; s < numSeats; ++s) {
+    SeatRound& seat = seats[s];
+    SeatStats& seatStats = stats.seats[s];
+    if (!seat.settled) {
+      for (int h = 0; h < seat.numHands; ++h) {
+        const SimHand& hand = seat.hands[h];
+        double bet = hand.doubled ? 2.0 * seat.bet : seat.bet;
+        int total = hand.getValue();
+        if (hand.isBust()) {
+          seat.net -= bet;
+        } else if (dealerTotal > 21 || total > dealerTotal) {
+          seat.net += bet;
+        } else if (total < dealerTotal) {
+          seat.net -= bet;
+        }
+      }
+    }
+    seatStats.handsPlayed += seat.numHands;
+    seatStats.totalNet += seat.net;
+    seatStats.totalNetSquared += seat.net * seat.net;
+
+    if (config.countsCards) {
+      int bin = std::clamp(trueCount, kMinTrackedTrueCount,
+                           kMaxTrackedTrueCount) -
+                kMinTrackedTrueCount;
+      double netPerUnit = seat.net / seat.bet;
+      seatStats.byTrueCount[bin].rounds++;
+      seatStats.byTrueCount[bin].totalNet += netPerUnit;
+      seatStats.byTrueCount[bin].totalNetSquared += netPerUnit * netPerUnit;
+    }
+  }
+
+  stats.cardsDealt += cardsThisRound;
+  stats.cardsDealtSquared +=
+      static_cast<double>(cardsThisRound) * cardsThisRound;
+}
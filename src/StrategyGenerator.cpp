@@ -1,8 +1,13 @@
 #include "StrategyGenerator.h"
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <map>
 #include <mutex>
@@ -14,6 +19,9 @@
 #include <vector>
 
 #include "BlackjackUtils.h"
+#include "InfiniteDeckGame.h"
+#include "MulticardTable.h"
+#include "TraceRecorder.h"
 
 // Helper function to print strategy usage information
 static void print_strategy_help() {
@@ -29,6 +37,10 @@ static void print_strategy_help() {
          "'false', default: true).\n"
       << "  --surrender <type>        Surrender type ('none', 'late', or "
          "'early', default: late).\n"
+      << "  --blackjack-payout <num>  Payout for blackjack (default: "
+         "1.5).\n"
+      << "  --insurance-payout <num>  Payout for insurance (default: "
+         "2.0).\n"
       << "  --can-split-aces <bool>   Can split aces? ('true' or 'false', "
          "default: true).\n"
       << "  --max-splits <num>        Maximum number of splits allowed "
@@ -36,140 +48,508 @@ static void print_strategy_help() {
       << "  --threads <num>           Number of threads to use (default: "
          "max (recommended)).\n"
       << "  --output <filename.csv>   Output CSV file name (default: "
-         "strategy.csv).\n";
+         "strategy.csv).\n"
+      << "  --epsilon <p>             Replace sub-trees reached with "
+         "probability below p by an\n"
+      << "                            estimate and report the largest error "
+         "bound (default: 0, exact).\n"
+      << "  --decisions-only <bool>   Skip actions that provably can't be "
+         "optimal; the chart is the\n"
+      << "                            same but other action EVs aren't "
+         "needed ('true' or 'false',\n"
+      << "                            default: false).\n"
+      << "  --memo-storage <mode>     'full', 'compact' (a third less "
+         "memory per memo entry) or\n"
+      << "                            'float' (half, with EVs within 1e-5; "
+         "default: full).\n"
+      << "  --moments <bool>          Add the variance and skewness of the "
+         "optimal action's payout\n"
+      << "                            to each cell (exact only; 'true' or "
+         "'false', default: false).\n"
+      << "  --compositions <bool>     Solve all 55 two-card holdings and "
+         "play each hard total the\n"
+      << "                            way that is best over its holdings "
+         "weighted by their odds.\n"
+      << "                            Every holding is also written to "
+         "<output>_compositions.csv\n"
+      << "                            ('true' or 'false', default: "
+         "false).\n"
+      << "  --multicard <bool>        Solve every hand of 3 or more cards "
+         "that can still act against\n"
+      << "                            each upcard, and write the action, EV "
+         "and margin of each to a\n"
+      << "                            binary table for 'ev-calc "
+         "--multicard-table' (default output:\n"
+      << "                            strategy_multicard.bin; 'true' or "
+         "'false', default: false).\n"
+      << "  --max-cards <num>         Most cards in a '--multicard' hand "
+         "(3-15, default: 5).\n"
+      << "  --stats <bool>            Print the number of states expanded "
+         "and memo hit rates\n"
+      << "                            ('true' or 'false', default: "
+         "false).\n"
+      << "  --validate-memo <bool>    Solve every memo hit again and check "
+         "it matches, to test the\n"
+      << "                            memo keys (slow; 'true' or 'false', "
+         "default: false).\n"
+      << "  --dealer-table <cards>    Precompute the dealer outcomes of "
+         "every shoe missing up to\n"
+      << "                            this many cards besides the upcard "
+         "(default: 0, off).\n"
+      << "  --dealer-table-file <f>   Load the dealer table from this file, "
+         "or build it (6 cards\n"
+      << "                            unless --dealer-table is given) and "
+         "save it there. A loaded\n"
+      << "                            table must match --dealer-table if "
+         "given.\n"
+      << "  --infinite-deck <bool>    Draw every card with a fixed "
+         "probability instead of from the\n"
+      << "                            shoe. Much faster and close to 8 "
+         "decks; --decks is ignored\n"
+      << "                            ('true' or 'false', default: "
+         "false).\n"
+      << "  --trace <file.json>       Record when each thread works on each "
+         "hand, clears its memos\n"
+      << "                            and evaluates the first action to a "
+         "Chrome trace file (open\n"
+      << "                            in ui.perfetto.dev or "
+         "chrome://tracing).\n"
+      << "  --hw-counters <bool>      Count cycles, instructions and cache, "
+         "branch and TLB misses\n"
+      << "                            per engine phase and thread with "
+         "perf_event_open ('true' or\n"
+      << "                            'false', default: false).\n"
+      << "  --shard <i>/<n>           Solve only shard i of n, with the hands "
+         "split so each shard\n"
+      << "                            gets about the same work, and write "
+         "them to a shard file\n"
+      << "                            (default output: "
+         "strategy_shard_<i>_of_<n>.csv).\n"
+      << "  --resume <bool>           Continue an interrupted run. Each "
+         "solved hand is appended to\n"
+      << "                            <output>.journal, and a resumed run "
+         "only solves the hands\n"
+      << "                            missing from it ('true' or 'false', "
+         "default: false).\n"
+      << "\nTo combine the shard files into one chart:\n"
+      << "  ./BlackjackLab strategy merge [--output <filename.csv>] <shard "
+         "files...>\n";
 }
 
+namespace {
+// Stores the contents of a shard file or journal
+struct ResultFile {
+  std::string rulesHeader;  // Comment lines describing the rules
+  int shardIndex = 0;       // 0 if the file covers the whole chart
+  int shardCount = 0;
+  int taskCount = 0;
+  std::vector<std::pair<int, StrategyResult>> results;  // By task index
+};
+
+// Reads a shard file or journal. A journal's last row may have been cut off
+// when the run was killed, so it's dropped if it can't be read.
+ResultFile readResultFile(const std::string& filename, bool isJournal) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open " + filename);
+  }
+
+  ResultFile resultFile;
+  std::string line;
+  bool headerSeen = false;
+  while (std::getline(file, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    if (line.rfind("#Shard: ", 0) == 0) {
+      if (std::sscanf(line.c_str(), "#Shard: %d/%d", &resultFile.shardIndex,
+                      &resultFile.shardCount) != 2) {
+        throw std::runtime_error("Malformed shard line in " + filename);
+      }
+      continue;
+    }
+    if (line.rfind("#Tasks: ", 0) == 0) {
+      if (std::sscanf(line.c_str(), "#Tasks: %d", &resultFile.taskCount) !=
+          1) {
+        throw std::runtime_error("Malformed task count in " + filename);
+      }
+      continue;
+    }
+    if (line[0] == '#') {
+      resultFile.rulesHeader += line + "\n";
+      continue;
+    }
+    if (resultFile.taskCount < 1) {
+      throw std::runtime_error(filename +
+                               " is not a strategy shard file or journal");
+    }
+    if (!headerSeen) {
+      headerSeen = true;
+      continue;
+    }
+
+    // Task,"Player Hand",Dealer Upcard,Optimal Action,Expected Value,Bound,
+    // and Variance,Skewness if the run calculated them
+    try {
+      size_t openingQuote = line.find('"');
+      size_t closingQuote = line.find('"', openingQuote + 1);
+      if (openingQuote == std::string::npos ||
+          closingQuote == std::string::npos) {
+        throw std::invalid_argument("Missing player hand.");
+      }
+      std::stringstream ss(
+          line.substr(std::min(line.size(), closingQuote + 2)));
+      std::string dealerUpcard, action, expectedValue, errorBound;
+      std::getline(ss, dealerUpcard, ',');
+      std::getline(ss, action, ',');
+      std::getline(ss, expectedValue, ',');
+      std::getline(ss, errorBound, ',');
+      std::string variance, skewness;
+      bool hasMoments = std::getline(ss, variance, ',') &&
+                        std::getline(ss, skewness, ',');
+      StrategyResult result = {
+          .playerHand =
+              line.substr(openingQuote + 1, closingQuote - openingQuote - 1),
+          .dealerUpcard = dealerUpcard,
+          .optimalAction = BlackjackUtils::stringToPlayerAction(action),
+          .expectedValue = std::stod(expectedValue),
+          .errorBound = std::stod(errorBound)};
+      if (hasMoments) {
+        result.variance = std::stod(variance);
+        result.skewness = std::stod(skewness);
+      }
+      resultFile.results.push_back(
+          {std::stoi(line.substr(0, openingQuote)), result});
+    } catch (const std::exception& e) {
+      if (isJournal && file.peek() == EOF) {
+        break;
+      }
+      throw std::runtime_error("Malformed row in " + filename + ": " + line);
+    }
+  }
+
+  if (resultFile.taskCount < 1) {
+    throw std::runtime_error(filename +
+                             " is not a strategy shard file or journal");
+  }
+  return resultFile;
+}
+
+// Writes one result as a row of a shard file or journal, at full precision so
+// the final chart matches a run that kept everything in memory
+void writeResultRow(std::ostream& out, int taskIndex,
+                    const StrategyResult& result) {
+  std::streamsize precision = out.precision(17);
+  out << taskIndex << ",\"" << result.playerHand << "\","
+      << result.dealerUpcard << ","
+      << BlackjackUtils::playerActionToString(result.optimalAction) << ","
+      << result.expectedValue << "," << result.errorBound;
+  if (!std::isnan(result.variance)) {
+    out << "," << result.variance << "," << result.skewness;
+  }
+  out << "\n";
+  out.precision(precision);
+}
+
+// Gets the header of a shard file or journal: the rules, the shard and the
+// number of tasks in the chart, so results can't be mixed between runs
+std::string getResultFileHeader(const std::string& rulesHeader,
+                                const StrategyOptions& options,
+                                int taskCount) {
+  std::ostringstream header;
+  header << rulesHeader;
+  if (options.shardCount > 0) {
+    header << "#Shard: " << options.shardIndex << "/" << options.shardCount
+           << "\n";
+  }
+  header << "#Tasks: " << taskCount << "\n";
+  header << "Task,Player Hand,Dealer Upcard,Optimal Action,Expected Value,"
+            "Error Bound";
+  if (options.payoutMoments) {
+    header << ",Variance,Skewness";
+  }
+  header << "\n";
+  return header.str();
+}
+}  // namespace
+
 int StrategyGenerator::run(int argc, char* argv[]) {
   // Print help message if requested
   if (argc > 2 && argv[2] == std::string("--help")) {
     print_strategy_help();
     return 0;
   }
+  if (argc > 2 && argv[2] == std::string("merge")) {
+    return runMerge(argc, argv);
+  }
 
   std::map<std::string, std::string> args;
+  if (!BlackjackUtils::parseArguments(argc, argv, args)) {
+    return 1;
+  }
 
-  // Parse command-line arguments
-  for (int i = 2; i < argc; ++i) {
-    std::string arg = argv[i];
-    if (arg.rfind("--", 0) == 0) {
-      if (i + 1 < argc) {
-        std::string key = arg.substr(2);
-        std::string value = argv[++i];
-        args[key] = value;
-      } else {
-        std::cerr << "Error: Missing value for argument " << arg << "\n";
-        return 1;
+  BlackjackGame::GameRules rules;
+  int threadCount;
+  if (!BlackjackUtils::parseGameRules(args, rules) ||
+      !BlackjackUtils::parseThreadCount(args, threadCount)) {
+    return 1;
+  }
+
+  // Get output file name or use default
+  std::string outputFileName = "strategy.csv";
+  if (args.find("output") != args.end()) {
+    outputFileName = args["output"];
+  }
+
+  StrategyOptions options;
+  if (args.count("epsilon")) {
+    try {
+      options.epsilon = std::stod(args["epsilon"]);
+      if (options.epsilon < 0.0 || options.epsilon >= 1.0) {
+        throw std::out_of_range("Invalid epsilon. Must be in [0, 1).");
       }
+    } catch (const std::exception& e) {
+      std::cerr << "Error: Invalid value for '--epsilon'. Must be a number "
+                   "from 0 up to (not including) 1."
+                << std::endl;
+      return 1;
     }
   }
 
-  int numDecks = 6;
-  if (args.find("decks") != args.end()) {
+  options.decisionsOnly =
+      args.count("decisions-only") && args["decisions-only"] == "true";
+  if (!BlackjackUtils::parseMemoStorage(args, options.memoStorage)) {
+    return 1;
+  }
+  options.payoutMoments = args.count("moments") && args["moments"] == "true";
+  if (options.payoutMoments &&
+      (options.epsilon > 0.0 || options.decisionsOnly)) {
+    std::cerr << "Error: '--moments' can't be combined with '--epsilon' or "
+                 "'--decisions-only'."
+              << std::endl;
+    return 1;
+  }
+  options.printStats = args.count("stats") && args["stats"] == "true";
+  if (args.count("dealer-table")) {
     try {
-      numDecks = std::stoi(args["decks"]);
-      if (numDecks < 1 || numDecks > 8) {
-        throw std::out_of_range("Invalid deck count. Must be between 1 and 8.");
+      options.dealerTableCards = std::stoi(args["dealer-table"]);
+      if (options.dealerTableCards < 0 || options.dealerTableCards > 12) {
+        throw std::out_of_range("Invalid dealer table size.");
       }
     } catch (const std::exception& e) {
-      std::cerr
-          << "Error: Invalid value for '--decks'. Must be an integer (1-8)."
-          << std::endl;
+      std::cerr << "Error: Invalid value for '--dealer-table'. Must be an "
+                   "integer (0-12)."
+                << std::endl;
       return 1;
     }
   }
-
-  bool dealerHitsSoft17 = true;
-  if (args.find("s17") != args.end() && args["s17"] == "false") {
-    dealerHitsSoft17 = false;
+  if (args.count("dealer-table-file")) {
+    options.dealerTableFile = args["dealer-table-file"];
   }
 
-  bool canDoubleAfterSplit = true;
-  if (args.find("das") != args.end() && args["das"] == "false") {
-    canDoubleAfterSplit = false;
+  options.validateMemo =
+      args.count("validate-memo") && args["validate-memo"] == "true";
+  options.hwCounters =
+      args.count("hw-counters") && args["hw-counters"] == "true";
+  if (args.count("trace")) {
+    options.traceFile = args["trace"];
   }
-
-  BlackjackGame::SurrenderType surrenderType =
-      BlackjackGame::SurrenderType::Late;
-  if (args.find("surrender") != args.end()) {
-    const std::string& type = args["surrender"];
-    if (type == "none") {
-      surrenderType = BlackjackGame::SurrenderType::None;
-    } else if (type == "late") {
-      surrenderType = BlackjackGame::SurrenderType::Late;
-    } else if (type == "early") {
-      surrenderType = BlackjackGame::SurrenderType::Early;
-    } else {
-      std::cerr << "Error: Invalid value for '--surrender'. Must be "
-                   "'none', 'late', or 'early'."
+  if (args.count("shard")) {
+    const std::string& shard = args["shard"];
+    size_t slash = shard.find('/');
+    try {
+      if (slash == std::string::npos) {
+        throw std::invalid_argument("Missing shard count.");
+      }
+      options.shardIndex = std::stoi(shard.substr(0, slash));
+      options.shardCount = std::stoi(shard.substr(slash + 1));
+      if (options.shardCount < 1 || options.shardIndex < 1 ||
+          options.shardIndex > options.shardCount) {
+        throw std::out_of_range("Invalid shard.");
+      }
+    } catch (const std::exception& e) {
+      std::cerr << "Error: Invalid value for '--shard'. Must be <i>/<n> with "
+                   "1 <= i <= n."
                 << std::endl;
       return 1;
     }
+    if (!args.count("output")) {
+      outputFileName = "strategy_shard_" + std::to_string(options.shardIndex) +
+                       "_of_" + std::to_string(options.shardCount) + ".csv";
+    }
+  }
+  options.resume = args.count("resume") && args["resume"] == "true";
+  options.infiniteDeck =
+      args.count("infinite-deck") && args["infinite-deck"] == "true";
+  if (options.infiniteDeck && (options.epsilon > 0.0 ||
+                               options.decisionsOnly ||
+                               options.payoutMoments)) {
+    std::cerr << "Error: '--infinite-deck' can't be combined with "
+                 "'--epsilon', '--decisions-only' or '--moments'."
+              << std::endl;
+    return 1;
   }
 
-  bool canSplitAces = true;
-  if (args.find("can-split-aces") != args.end() &&
-      args["can-split-aces"] == "false") {
-    canSplitAces = false;
+  options.compositions =
+      args.count("compositions") && args["compositions"] == "true";
+  if (options.compositions &&
+      (options.infiniteDeck || options.decisionsOnly ||
+       options.payoutMoments || options.shardCount > 0 || options.resume)) {
+    std::cerr << "Error: '--compositions' can't be combined with "
+                 "'--infinite-deck', '--decisions-only', '--moments', "
+                 "'--shard' or '--resume'."
+              << std::endl;
+    return 1;
   }
 
-  int maxSplits = 3;
-  if (args.find("max-splits") != args.end()) {
+  options.multicard = args.count("multicard") && args["multicard"] == "true";
+  if (args.count("max-cards")) {
     try {
-      maxSplits = std::stoi(args["max-splits"]);
-      if (maxSplits < 0 || maxSplits > 3) {
-        throw std::out_of_range(
-            "Invalid max splits. Must be between 0 (splitting not allowed) and "
-            "3.");
+      options.maxCards = std::stoi(args["max-cards"]);
+      if (options.maxCards < 3 ||
+          options.maxCards > MulticardTable::kMaxCardsLimit) {
+        throw std::out_of_range("Invalid max cards.");
       }
     } catch (const std::exception& e) {
-      std::cerr << "Error: Invalid value for '--max-splits'. Must be an "
-                   "integer (0-3)."
-                << std::endl;
+      std::cerr << "Error: Invalid value for '--max-cards'. Must be an "
+                   "integer (3-"
+                << MulticardTable::kMaxCardsLimit << ")." << std::endl;
       return 1;
     }
   }
+  if (options.multicard &&
+      (options.compositions || options.infiniteDeck || options.decisionsOnly ||
+       options.payoutMoments || options.epsilon > 0.0 ||
+       options.shardCount > 0 || options.resume)) {
+    std::cerr << "Error: '--multicard' can't be combined with "
+                 "'--compositions', '--infinite-deck', '--decisions-only', "
+                 "'--moments', '--epsilon', '--shard' or '--resume'."
+              << std::endl;
+    return 1;
+  }
 
-  BlackjackGame::GameRules rules{.numDecks = numDecks,
-                                 .dealerHitsSoft17 = dealerHitsSoft17,
-                                 .canDoubleAfterSplit = canDoubleAfterSplit,
-                                 .surrenderType = surrenderType,
-                                 .canSplitAces = canSplitAces,
-                                 .maxSplits = maxSplits};
+  if (options.compositions) {
+    return generateCompositionStrategy(rules, outputFileName, threadCount,
+                                       options);
+  }
+  if (options.multicard) {
+    if (!args.count("output")) {
+      outputFileName = "strategy_multicard.bin";
+    }
+    return generateMulticardTable(rules, outputFileName, threadCount,
+                                  options);
+  }
+  return generateStrategy(rules, outputFileName, threadCount, options);
+}
 
-  // Parse thread count
-  int threadCount = std::thread::hardware_concurrency();
-  if (args.count("threads")) {
-    if (args["threads"] == "all" || args["threads"] == "max") {
-      threadCount = std::thread::hardware_concurrency();
+int StrategyGenerator::runMerge(int argc, char* argv[]) {
+  std::string outputFileName = "strategy.csv";
+  std::vector<std::string> shardFiles;
+  for (int i = 3; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--output" && i + 1 < argc) {
+      outputFileName = argv[++i];
+    } else if (arg.rfind("--", 0) == 0) {
+      std::cerr << "Error: Unknown argument " << arg << " for 'strategy merge'."
+                << std::endl;
+      return 1;
     } else {
-      try {
-        threadCount = std::stoi(args["threads"]);
-        if (threadCount < 1) {
-          throw std::out_of_range("Invalid thread count. Must be at least 1.");
-        }
-      } catch (const std::exception& e) {
-        std::cerr << "Error: Invalid value for '--threads'. Must be a positive "
-                     "integer."
-                  << std::endl;
-        return 1;
+      shardFiles.push_back(arg);
+    }
+  }
+  if (shardFiles.empty()) {
+    std::cerr << "Error: No shard files given. Usage: ./BlackjackLab strategy "
+                 "merge [--output <filename.csv>] <shard files...>"
+              << std::endl;
+    return 1;
+  }
+
+  std::vector<ResultFile> shards;
+  try {
+    for (const auto& filename : shardFiles) {
+      shards.push_back(readResultFile(filename, false));
+      if (shards.back().shardCount < 1) {
+        throw std::runtime_error(filename + " is not a strategy shard file");
       }
     }
+  } catch (const std::runtime_error& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
   }
 
-  // Get output file name or use default
-  std::string outputFileName = "strategy.csv";
-  if (args.find("output") != args.end()) {
-    outputFileName = args["output"];
+  // Every shard must come from the same run configuration, exactly once
+  const ResultFile& first = shards[0];
+  std::vector<bool> shardSeen(first.shardCount, false);
+  for (size_t i = 0; i < shards.size(); ++i) {
+    if (shards[i].rulesHeader != first.rulesHeader) {
+      std::cerr << "Error: " << shardFiles[i]
+                << " was generated with different rules than "
+                << shardFiles[0] << "." << std::endl;
+      return 1;
+    }
+    if (shards[i].shardCount != first.shardCount ||
+        shards[i].taskCount != first.taskCount) {
+      std::cerr << "Error: " << shardFiles[i] << " is shard "
+                << shards[i].shardIndex << "/" << shards[i].shardCount
+                << " but " << shardFiles[0] << " is from a split into "
+                << first.shardCount << " shards." << std::endl;
+      return 1;
+    }
+    if (shardSeen[shards[i].shardIndex - 1]) {
+      std::cerr << "Error: Shard " << shards[i].shardIndex << "/"
+                << first.shardCount << " was given more than once."
+                << std::endl;
+      return 1;
+    }
+    shardSeen[shards[i].shardIndex - 1] = true;
+  }
+  for (int i = 0; i < first.shardCount; ++i) {
+    if (!shardSeen[i]) {
+      std::cerr << "Error: Shard " << i + 1 << "/" << first.shardCount
+                << " is missing." << std::endl;
+      return 1;
+    }
+  }
+
+  std::vector<StrategyResult> results(first.taskCount);
+  std::vector<bool> taskSeen(first.taskCount, false);
+  for (size_t i = 0; i < shards.size(); ++i) {
+    for (const auto& [taskIndex, result] : shards[i].results) {
+      if (taskIndex < 0 || taskIndex >= first.taskCount ||
+          taskSeen[taskIndex]) {
+        std::cerr << "Error: " << shardFiles[i] << " has an invalid or "
+                  << "repeated task " << taskIndex << "." << std::endl;
+        return 1;
+      }
+      taskSeen[taskIndex] = true;
+      results[taskIndex] = result;
+    }
+  }
+  int missingTasks = std::count(taskSeen.begin(), taskSeen.end(), false);
+  if (missingTasks > 0) {
+    std::cerr << "Error: The shard files are missing " << missingTasks
+              << " of " << first.taskCount << " hands." << std::endl;
+    return 1;
   }
 
-  return generateStrategy(rules, outputFileName, threadCount);
+  std::cout << "Merged " << shards.size() << " shards\n";
+  bool hasEpsilon = first.rulesHeader.find("#Epsilon: ") != std::string::npos;
+  bool hasMoments =
+      first.rulesHeader.find("#Payout Moments: ") != std::string::npos;
+  return writeToCSV(outputFileName, first.rulesHeader, results, hasEpsilon,
+                    hasMoments);
 }
 
 int StrategyGenerator::generateStrategy(const BlackjackGame::GameRules& rules,
                                         const std::string& outputFileName,
-                                        int threadCount) {
-  std::cout << "Generating strategy chart using " << threadCount
-            << " threads... (this may take a few minutes)\n";
+                                        int threadCount,
+                                        const StrategyOptions& options) {
+  if (options.infiniteDeck) {
+    std::cout << "Generating infinite-deck strategy chart...\n";
+  } else {
+    std::cout << "Generating strategy chart using " << threadCount
+              << " threads... (this may take a few minutes)\n";
+  }
 
   // Generate all possible player hands (hard totals, soft totals, pairs)
   std::vector<std::string> playerHands;
@@ -197,76 +577,286 @@ int StrategyGenerator::generateStrategy(const BlackjackGame::GameRules& rules,
   std::vector<std::string> dealerUpcards = {"2", "3", "4", "5",  "6",
                                             "7", "8", "9", "10", "A"};
 
-  // Create a work queue for the player hands and dealer upcards
-  std::queue<std::tuple<std::string, std::string, int>> workQueue;
-  int taskIndex = 0;
-  for (const auto& playerHand : playerHands) {
+  // Each row of the chart (a player hand against every upcard) is solved by
+  // one worker without clearing its memos in between. Once the dealer has
+  // drawn, the upcards reach the same dealer states (a 2 drawing a 3 and a 3
+  // drawing a 2), so the row shares those memo entries.
+  const int chartTasks = playerHands.size() * dealerUpcards.size();
+  std::vector<double> rowCosts(playerHands.size(), 0.0);
+  for (size_t row = 0; row < playerHands.size(); ++row) {
     for (const auto& dealerUpcard : dealerUpcards) {
-      workQueue.push({playerHand, dealerUpcard, taskIndex++});
+      rowCosts[row] +=
+          estimateTaskCost(playerHands[row], dealerUpcard, rules);
     }
   }
 
-  // Protect the work queue with a mutex
+  // A shard only solves the rows assigned to it
+  std::vector<int> rowShards(playerHands.size(), 0);
+  if (options.shardCount > 0) {
+    rowShards = assignShards(rowCosts, options.shardCount);
+  }
+
+  // Initialize the results vector with a slot for every task in the chart
+  std::vector<StrategyResult> allResults(chartTasks);
+
+  // Every result is appended to a journal as soon as it's solved. A resumed
+  // run takes the results from the journal and only solves the rest.
+  std::string rulesHeader = getRulesHeader(rules, options);
+  std::string journalHeader =
+      getResultFileHeader(rulesHeader, options, chartTasks);
+  std::string journalFileName = outputFileName + ".journal";
+  std::vector<bool> taskSolved(chartTasks, false);
+  std::vector<std::pair<int, StrategyResult>> journalResults;
+  if (std::ifstream(journalFileName).good()) {
+    if (!options.resume) {
+      std::cerr << "Error: " << journalFileName
+                << " is left from an unfinished run. Add '--resume true' to "
+                   "continue it, or delete it to start over."
+                << std::endl;
+      return 1;
+    }
+    try {
+      ResultFile journal = readResultFile(journalFileName, true);
+      if (journal.rulesHeader != rulesHeader ||
+          journal.shardIndex != options.shardIndex ||
+          journal.shardCount != options.shardCount ||
+          journal.taskCount != chartTasks) {
+        throw std::runtime_error(
+            journalFileName + " was written with different rules or shard");
+      }
+      for (const auto& [taskIndex, result] : journal.results) {
+        if (taskIndex < 0 || taskIndex >= chartTasks) {
+          throw std::runtime_error("Invalid task in " + journalFileName);
+        }
+        if (!taskSolved[taskIndex]) {
+          taskSolved[taskIndex] = true;
+          allResults[taskIndex] = result;
+          journalResults.push_back({taskIndex, result});
+        }
+      }
+    } catch (const std::runtime_error& e) {
+      std::cerr << "Error: " << e.what() << std::endl;
+      return 1;
+    }
+    std::cout << "Resuming from " << journalFileName << " with "
+              << journalResults.size() << " hands already solved\n";
+  }
+
+  // Create a work queue of rows, most expensive first so no worker is left
+  // with a long row at the end
+  std::vector<int> rowOrder(playerHands.size());
+  std::iota(rowOrder.begin(), rowOrder.end(), 0);
+  std::stable_sort(rowOrder.begin(), rowOrder.end(), [&](int a, int b) {
+    return rowCosts[a] > rowCosts[b];
+  });
+  std::queue<StrategyRow> workQueue;
+  std::vector<int> shardTasks;
+  int totalTasks = 0;
+  for (int row : rowOrder) {
+    if (options.shardCount > 0 && rowShards[row] != options.shardIndex - 1) {
+      continue;
+    }
+    StrategyRow strategyRow{.playerHand = playerHands[row], .upcards = {}};
+    for (size_t column = 0; column < dealerUpcards.size(); ++column) {
+      int taskIndex = row * dealerUpcards.size() + column;
+      shardTasks.push_back(taskIndex);
+      if (!taskSolved[taskIndex]) {
+        strategyRow.upcards.push_back({dealerUpcards[column], taskIndex});
+      }
+    }
+    totalTasks += strategyRow.upcards.size();
+    if (!strategyRow.upcards.empty()) {
+      workQueue.push(strategyRow);
+    }
+  }
+  std::sort(shardTasks.begin(), shardTasks.end());
+  if (options.shardCount > 0) {
+    std::cout << "Shard " << options.shardIndex << "/" << options.shardCount
+              << ": " << shardTasks.size() << " of " << chartTasks
+              << " hands\n";
+  }
+
+  // Protect the work queue and the journal with a mutex
   std::mutex workQueueMutex;
   std::atomic<int> tasksCompleted = 0;
-  const int totalTasks = workQueue.size();
-  // Initialize the results vector with a size equal to the total task count
-  std::vector<StrategyResult> allResults(totalTasks);
 
-  std::vector<std::thread> threads;
+  if (!options.traceFile.empty()) {
+    TraceRecorder::start();
+    TraceRecorder::setThreadName("Main");
+  }
 
-  // Create worker threads
-  for (int i = 0; i < threadCount; ++i) {
-    threads.emplace_back([&] {
-      calculateChunk(rules, workQueue, allResults, workQueueMutex,
-                     tasksCompleted);
-    });
+  // The main thread counts the infinite-deck chart and the output
+  std::vector<HardwareCounters::Counts> threadCounters(threadCount);
+  std::string counterError;
+  if (options.hwCounters && !HardwareCounters::startThread(counterError)) {
+    std::cout << "Hardware counters unavailable: " << counterError << "\n";
   }
 
-  // Print a progress meter as the program runs
-  while (tasksCompleted < totalTasks) {
-    int currentProgress = static_cast<int>((tasksCompleted * 100) / totalTasks);
-    std::cout << "\rProgress: " << currentProgress << "%" << std::flush;
-    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+  std::shared_ptr<const DealerTable> dealerTable;
+  if (!options.infiniteDeck) {
+    try {
+      TraceRecorder::Span span("dealer table", "setup");
+      dealerTable = getDealerTable(rules, options, threadCount);
+    } catch (const std::runtime_error& e) {
+      std::cerr << "Error: " << e.what() << std::endl;
+      return 1;
+    }
   }
-  std::cout << "\rProgress: 100%\n";
 
-  // Join all threads
-  for (auto& t : threads) {
-    if (t.joinable()) {
-      t.join();
+  // Rewrite the journal once setup has succeeded, so a failed start doesn't
+  // leave one behind. This also drops a row cut off by a crash.
+  std::ofstream journal(journalFileName, std::ios::trunc);
+  if (!journal.is_open()) {
+    std::cerr << "Error: Could not open file " << journalFileName
+              << " for writing." << std::endl;
+    return 1;
+  }
+  journal << journalHeader;
+  for (const auto& [taskIndex, result] : journalResults) {
+    writeResultRow(journal, taskIndex, result);
+  }
+  journal.flush();
+
+  std::vector<std::thread> threads;
+  std::vector<BlackjackGame::SearchStats> threadStats(threadCount);
+
+  if (options.infiniteDeck) {
+    // The whole chart takes microseconds, so work through it on this thread
+    auto startTime = std::chrono::steady_clock::now();
+    calculateChunk(rules, options, workQueue, allResults, journal,
+                   workQueueMutex, tasksCompleted, threadStats[0], nullptr);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime);
+    std::cout << "Calculated in " << elapsed.count() << " microseconds\n";
+  } else {
+    // Create worker threads
+    for (int i = 0; i < threadCount; ++i) {
+      threads.emplace_back([&, i] {
+        TraceRecorder::setThreadName("Worker " + std::to_string(i + 1));
+        std::string error;
+        bool counting =
+            options.hwCounters && HardwareCounters::startThread(error);
+        calculateChunk(rules, options, workQueue, allResults, journal,
+                       workQueueMutex, tasksCompleted, threadStats[i],
+                       dealerTable);
+        if (counting) {
+          threadCounters[i] = HardwareCounters::stopThread();
+        }
+      });
+    }
+
+    // Print a progress meter as the program runs
+    while (tasksCompleted < totalTasks) {
+      int currentProgress =
+          static_cast<int>((tasksCompleted * 100) / totalTasks);
+      std::cout << "\rProgress: " << currentProgress << "%" << std::flush;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    }
+    std::cout << "\rProgress: 100%\n";
+
+    // Join all threads
+    for (auto& t : threads) {
+      if (t.joinable()) {
+        t.join();
+      }
     }
   }
 
+  if (options.epsilon > 0.0) {
+    double maxErrorBound = 0.0;
+    for (const auto& result : allResults) {
+      maxErrorBound = std::max(maxErrorBound, result.errorBound);
+    }
+    std::cout << "Largest EV error bound: " << maxErrorBound << "\n";
+  }
+
+  BlackjackGame::SearchStats totals;
+  for (const auto& stats : threadStats) {
+    totals.merge(stats);
+  }
+  if (options.printStats || options.validateMemo) {
+    BlackjackUtils::printSearchStats(totals);
+  }
+  if (totals.memoMismatches > 0) {
+    std::cerr << "Error: " << totals.memoMismatches
+              << " memo hits didn't match a fresh calculation." << std::endl;
+    // The results can't be trusted, so don't offer them for resuming
+    journal.close();
+    std::remove(journalFileName.c_str());
+    return 1;
+  }
+
   // Write the results to a CSV file
-  return writeToCSV(outputFileName, allResults, rules);
+  int writeResult;
+  {
+    EnginePhase::Scope phase(EnginePhase::Phase::Output);
+    if (options.shardCount > 0) {
+      writeResult = writeShardFile(outputFileName, rulesHeader, allResults,
+                                   shardTasks, options);
+    } else {
+      writeResult = writeToCSV(outputFileName, rulesHeader, allResults,
+                               options.epsilon > 0.0, options.payoutMoments);
+    }
+  }
+  // The output now holds everything the journal did
+  journal.close();
+  if (writeResult == 0) {
+    std::remove(journalFileName.c_str());
+  }
+  // Written after the output, so a bad trace path doesn't cost the chart
+  if (!options.traceFile.empty()) {
+    try {
+      TraceRecorder::write(options.traceFile);
+      std::cout << "Trace written to " << options.traceFile << "\n";
+    } catch (const std::runtime_error& e) {
+      std::cerr << "Error: " << e.what() << std::endl;
+      writeResult = 1;
+    }
+  }
+
+  HardwareCounters::Counts mainCounters = HardwareCounters::stopThread();
+  if (options.hwCounters && counterError.empty()) {
+    HardwareCounters::Counts totalCounters = mainCounters;
+    HardwareCounters::print("main thread", mainCounters);
+    if (!options.infiniteDeck) {
+      for (int i = 0; i < threadCount; ++i) {
+        HardwareCounters::print("worker " + std::to_string(i + 1),
+                                threadCounters[i]);
+        totalCounters.merge(threadCounters[i]);
+      }
+    }
+    HardwareCounters::print("all threads", totalCounters);
+  }
+  return writeResult;
 }
 
 void StrategyGenerator::calculateChunk(
-    const BlackjackGame::GameRules& rules,
-    std::queue<std::tuple<std::string, std::string, int>>& workQueue,
-    std::vector<StrategyResult>& results, std::mutex& workQueueMutex,
-    std::atomic<int>& tasksCompleted) {
+    const BlackjackGame::GameRules& rules, const StrategyOptions& options,
+    std::queue<StrategyRow>& workQueue, std::vector<StrategyResult>& results,
+    std::ostream& journal, std::mutex& workQueueMutex,
+    std::atomic<int>& tasksCompleted, BlackjackGame::SearchStats& stats,
+    std::shared_ptr<const DealerTable> dealerTable) {
   BlackjackGame game(rules);
+  game.setEpsilon(options.epsilon);
+  game.setDecisionsOnly(options.decisionsOnly);
+  game.setMemoStorage(options.memoStorage);
+  game.setPayoutMoments(options.payoutMoments);
+  game.setValidateMemoKeys(options.validateMemo);
+  game.setDealerTable(dealerTable);
+  InfiniteDeckGame infiniteDeckGame(rules);
 
-  // Process each task in the work queue
+  // Process each row in the work queue
   while (true) {
-    std::tuple<std::string, std::string, int> task;
+    StrategyRow row;
     {
       std::lock_guard<std::mutex> lock(workQueueMutex);
       if (workQueue.empty()) {
         break;  // No more work to do
       }
-      task = workQueue.front();
+      row = workQueue.front();
       workQueue.pop();
     }
-
-    // Extract the player hand, dealer upcard, and task index from the tuple
-    std::string playerHand = std::get<0>(task);
-    std::string dealerUpcard = std::get<1>(task);
-    int taskIndex = std::get<2>(task);
-
-    game.clearMemos();
+    const std::string& playerHand = row.playerHand;
 
     // Parse the player hand
     std::stringstream ss(playerHand);
@@ -274,11 +864,10 @@ void StrategyGenerator::calculateChunk(
     std::getline(ss, firstCardStr, ',');
     std::getline(ss, secondCardStr);
 
-    // Determine the ranks of the player hand and dealer upcard
+    // Determine the ranks of the player hand
     std::vector<Card::Rank> playerRanks = {
         BlackjackUtils::stringToRank(firstCardStr),
         BlackjackUtils::stringToRank(secondCardStr)};
-    Card::Rank dealerUpcardRank = BlackjackUtils::stringToRank(dealerUpcard);
 
     // Assume dealer has checked for blackjack, unless early surrender is
     // allowed
@@ -287,10 +876,6 @@ void StrategyGenerator::calculateChunk(
       dealerChecked = false;
     }
 
-    BlackjackGame::GameState state = BlackjackGame::getGameStateForCalculation(
-        playerRanks, dealerUpcardRank, rules.numDecks, dealerChecked);
-    BlackjackGame::EVResult evResult =
-        game.calculateEVForOptimalStrategy(state);
     // Convert hard totals to single number if necessary
     std::string playerHandTotalString = playerHand;
     if (firstCardStr != secondCardStr && firstCardStr != "A" &&
@@ -299,20 +884,563 @@ void StrategyGenerator::calculateChunk(
           std::to_string(BlackjackUtils::stringToValue(firstCardStr) +
                          BlackjackUtils::stringToValue(secondCardStr));
     }
-    // Create a StrategyResult for this matchup
-    StrategyResult result = {.playerHand = playerHandTotalString,
-                             .dealerUpcard = dealerUpcard,
-                             .optimalAction = evResult.optimalAction,
-                             .expectedValue = evResult.optimalEV};
 
-    results[taskIndex] = result;
-    tasksCompleted++;
+    // The memos are only cleared between rows, so the upcards of a row share
+    // dealer entries
+    if (!options.infiniteDeck) {
+      TraceRecorder::Span clearSpan("clear memos", "memo");
+      game.clearMemos();
+    }
+
+    for (const auto& [dealerUpcard, taskIndex] : row.upcards) {
+      Card::Rank dealerUpcardRank = BlackjackUtils::stringToRank(dealerUpcard);
+      TraceRecorder::Span taskSpan("task", "task",
+                                   playerHand + " vs " + dealerUpcard);
+      BlackjackGame::EVResult evResult;
+      if (options.infiniteDeck) {
+        evResult = infiniteDeckGame.calculateEVForOptimalStrategy(
+            playerRanks, dealerUpcardRank, dealerChecked);
+      } else {
+        BlackjackGame::GameState state =
+            BlackjackGame::getGameStateForCalculation(
+                playerRanks, dealerUpcardRank, rules.numDecks, dealerChecked);
+        evResult = game.calculateEVForOptimalStrategy(state);
+      }
+      // Create a StrategyResult for this matchup
+      StrategyResult result = {.playerHand = playerHandTotalString,
+                               .dealerUpcard = dealerUpcard,
+                               .optimalAction = evResult.optimalAction,
+                               .expectedValue = evResult.optimalEV,
+                               .errorBound = evResult.errorBound};
+      if (options.payoutMoments) {
+        result.variance =
+            evResult.optimalMoments.getVariance(evResult.optimalEV);
+        result.skewness =
+            evResult.optimalMoments.getSkewness(evResult.optimalEV);
+      }
+
+      results[taskIndex] = result;
+      {
+        std::lock_guard<std::mutex> lock(workQueueMutex);
+        writeResultRow(journal, taskIndex, result);
+        journal.flush();
+      }
+      tasksCompleted++;
+    }
+  }
+  stats = game.getSearchStats();
+}
+
+int StrategyGenerator::generateCompositionStrategy(
+    const BlackjackGame::GameRules& rules, const std::string& outputFileName,
+    int threadCount, const StrategyOptions& options) {
+  std::cout << "Generating composition-weighted strategy chart using "
+            << threadCount << " threads... (this may take a few minutes)\n";
+
+  // Every distinct two-card holding, grouped into the rows of the usual
+  // chart. A hard total is the only row dealt more than one way.
+  auto valueToString = [](int value) {
+    return value == 11 ? std::string("A") : std::to_string(value);
+  };
+  std::vector<std::string> holdings;
+  std::vector<std::pair<int, int>> holdingValues;
+  std::vector<CompositionRow> rows;
+  auto addHolding = [&](CompositionRow& row, int first, int second) {
+    row.holdings.push_back(holdings.size());
+    holdings.push_back(valueToString(first) + "," + valueToString(second));
+    holdingValues.push_back({first, second});
+  };
+  for (int total = 5; total <= 19; ++total) {
+    CompositionRow row{.chartRow = std::to_string(total), .holdings = {}};
+    for (int first = 10; first > total - first; --first) {
+      if (total - first >= 2) {
+        addHolding(row, first, total - first);
+      }
+    }
+    rows.push_back(row);
+  }
+  for (int second = 2; second <= 10; ++second) {
+    // A,10 is a blackjack, which isn't a row of the chart
+    CompositionRow row{
+        .chartRow = second < 10 ? "A," + std::to_string(second) : "",
+        .holdings = {}};
+    addHolding(row, 11, second);
+    rows.push_back(row);
+  }
+  for (int value = 2; value <= 11; ++value) {
+    CompositionRow row{
+        .chartRow = valueToString(value) + "," + valueToString(value),
+        .holdings = {}};
+    addHolding(row, value, value);
+    rows.push_back(row);
+  }
+
+  std::vector<std::string> dealerUpcards = {"2", "3", "4", "5",  "6",
+                                            "7", "8", "9", "10", "A"};
+  const int upcardCount = dealerUpcards.size();
+
+  // Each row is solved by one worker without clearing its memos, so besides
+  // the upcards sharing dealer states, the holdings of a total share some too
+  // (10,6 with the dealer drawing 9,7 leaves the same shoe as 9,7 with the
+  // dealer drawing 10,6). Rows are queued most expensive first.
+  std::vector<double> rowCosts(rows.size(), 0.0);
+  for (size_t row = 0; row < rows.size(); ++row) {
+    for (int holding : rows[row].holdings) {
+      for (const auto& dealerUpcard : dealerUpcards) {
+        rowCosts[row] +=
+            estimateTaskCost(holdings[holding], dealerUpcard, rules);
+      }
+    }
+  }
+  std::vector<int> rowOrder(rows.size());
+  std::iota(rowOrder.begin(), rowOrder.end(), 0);
+  std::stable_sort(rowOrder.begin(), rowOrder.end(), [&](int a, int b) {
+    return rowCosts[a] > rowCosts[b];
+  });
+  std::queue<std::vector<int>> workQueue;
+  for (int row : rowOrder) {
+    workQueue.push(rows[row].holdings);
+  }
+
+  std::shared_ptr<const DealerTable> dealerTable;
+  try {
+    dealerTable = getDealerTable(rules, options, threadCount);
+  } catch (const std::runtime_error& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+
+  const int totalTasks = holdings.size() * upcardCount;
+  std::vector<BlackjackGame::EVResult> results(totalTasks);
+  std::vector<BlackjackGame::SearchStats> threadStats(threadCount);
+  std::mutex workQueueMutex;
+  std::atomic<int> tasksCompleted = 0;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < threadCount; ++i) {
+    threads.emplace_back([&, i] {
+      calculateCompositionChunk(rules, options, holdings, dealerUpcards,
+                                workQueue, results, workQueueMutex,
+                                tasksCompleted, threadStats[i], dealerTable);
+    });
+  }
+  while (tasksCompleted < totalTasks) {
+    int currentProgress =
+        static_cast<int>((tasksCompleted * 100) / totalTasks);
+    std::cout << "\rProgress: " << currentProgress << "%" << std::flush;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+  }
+  std::cout << "\rProgress: 100%\n";
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  BlackjackGame::SearchStats totals;
+  for (const auto& stats : threadStats) {
+    totals.merge(stats);
+  }
+  if (options.printStats || options.validateMemo) {
+    BlackjackUtils::printSearchStats(totals);
+  }
+  if (totals.memoMismatches > 0) {
+    std::cerr << "Error: " << totals.memoMismatches
+              << " memo hits didn't match a fresh calculation." << std::endl;
+    return 1;
+  }
+
+  // Average each action's EV over the holdings of a row, weighted by how
+  // likely each holding is against the upcard, and play the best average
+  bool dealerChecked =
+      rules.surrenderType != BlackjackGame::SurrenderType::Early;
+  auto getActionEV = [](const BlackjackGame::EVResult& result,
+                        BlackjackGame::PlayerAction action) {
+    switch (action) {
+      case BlackjackGame::PlayerAction::Hit:
+        return result.hitEV;
+      case BlackjackGame::PlayerAction::Stand:
+        return result.standEV;
+      case BlackjackGame::PlayerAction::Double:
+        return result.doubleEV;
+      case BlackjackGame::PlayerAction::Split:
+        return result.splitEV;
+      case BlackjackGame::PlayerAction::Surrender:
+        return result.surrenderEV;
+      default:
+        return result.optimalEV;
+    }
+  };
+  std::vector<double> weights(totalTasks);
+  std::vector<BlackjackGame::PlayerAction> chartActions(totalTasks);
+  std::vector<StrategyResult> chartResults;
+  for (const CompositionRow& row : rows) {
+    for (int column = 0; column < upcardCount; ++column) {
+      int upcardValue = BlackjackUtils::stringToValue(dealerUpcards[column]);
+      BlackjackGame::EVResult combined;
+      double totalWeight = 0.0;
+      for (int holding : row.holdings) {
+        int task = holding * upcardCount + column;
+        weights[task] = getHoldingWeight(holdingValues[holding].first,
+                                         holdingValues[holding].second,
+                                         upcardValue, rules.numDecks,
+                                         dealerChecked);
+        totalWeight += weights[task];
+      }
+      if (row.holdings.size() == 1) {
+        combined = results[row.holdings[0] * upcardCount + column];
+      } else {
+        // An action only counts if every holding of the total allows it
+        for (double BlackjackGame::EVResult::*actionEV :
+             {&BlackjackGame::EVResult::hitEV,
+              &BlackjackGame::EVResult::standEV,
+              &BlackjackGame::EVResult::splitEV,
+              &BlackjackGame::EVResult::doubleEV,
+              &BlackjackGame::EVResult::surrenderEV,
+              &BlackjackGame::EVResult::errorBound}) {
+          double sum = 0.0;
+          for (int holding : row.holdings) {
+            int task = holding * upcardCount + column;
+            sum += weights[task] * (results[task].*actionEV);
+          }
+          combined.*actionEV = sum / totalWeight;
+        }
+        BlackjackGame::chooseOptimalAction(combined);
+      }
+      for (int holding : row.holdings) {
+        chartActions[holding * upcardCount + column] = combined.optimalAction;
+      }
+      if (!row.chartRow.empty()) {
+        chartResults.push_back({.playerHand = row.chartRow,
+                                .dealerUpcard = dealerUpcards[column],
+                                .optimalAction = combined.optimalAction,
+                                .expectedValue = combined.optimalEV,
+                                .errorBound = combined.errorBound});
+      }
+    }
+  }
+
+  // Report the holdings whose own best action differs from their row's
+  std::cout << "Composition-dependent exceptions:\n";
+  int exceptionCount = 0;
+  for (size_t holding = 0; holding < holdings.size(); ++holding) {
+    for (int column = 0; column < upcardCount; ++column) {
+      int task = holding * upcardCount + column;
+      const BlackjackGame::EVResult& result = results[task];
+      if (result.optimalAction == chartActions[task]) {
+        continue;
+      }
+      exceptionCount++;
+      std::cout << "  " << holdings[holding] << " vs " << dealerUpcards[column]
+                << ": "
+                << BlackjackUtils::playerActionToString(result.optimalAction)
+                << " instead of "
+                << BlackjackUtils::playerActionToString(chartActions[task])
+                << " (+"
+                << result.optimalEV - getActionEV(result, chartActions[task])
+                << ")\n";
+    }
+  }
+  std::cout << exceptionCount << " of " << totalTasks
+            << " holdings play differently from their total\n";
+
+  if (options.epsilon > 0.0) {
+    double maxErrorBound = 0.0;
+    for (const auto& result : results) {
+      maxErrorBound = std::max(maxErrorBound, result.errorBound);
+    }
+    std::cout << "Largest EV error bound: " << maxErrorBound << "\n";
+  }
+
+  // Every holding goes to a second file, with the action of its chart row
+  std::string holdingsFileName = outputFileName;
+  if (holdingsFileName.size() > 4 &&
+      holdingsFileName.compare(holdingsFileName.size() - 4, 4, ".csv") == 0) {
+    holdingsFileName.resize(holdingsFileName.size() - 4);
+  }
+  holdingsFileName += "_compositions.csv";
+  std::string rulesHeader = getRulesHeader(rules, options);
+  std::ofstream holdingsFile(holdingsFileName);
+  if (!holdingsFile.is_open()) {
+    std::cerr << "Error: Could not open file " << holdingsFileName
+              << " for writing." << std::endl;
+    return 1;
+  }
+  holdingsFile << rulesHeader;
+  holdingsFile << "Player Hand,Dealer Upcard,Weight,Optimal Action,Expected "
+                  "Value,Chart Action,Chart Action EV\n";
+  for (size_t holding = 0; holding < holdings.size(); ++holding) {
+    for (int column = 0; column < upcardCount; ++column) {
+      int task = holding * upcardCount + column;
+      holdingsFile << "\"" << holdings[holding] << "\","
+                   << dealerUpcards[column] << "," << weights[task] << ","
+                   << BlackjackUtils::playerActionToString(
+                          results[task].optimalAction)
+                   << "," << results[task].optimalEV << ","
+                   << BlackjackUtils::playerActionToString(chartActions[task])
+                   << "," << getActionEV(results[task], chartActions[task])
+                   << "\n";
+    }
   }
+  holdingsFile.close();
+  std::cout << "Holdings written to " << holdingsFileName << "\n";
+
+  return writeToCSV(outputFileName, rulesHeader, chartResults,
+                    options.epsilon > 0.0, false);
+}
+
+void StrategyGenerator::calculateCompositionChunk(
+    const BlackjackGame::GameRules& rules, const StrategyOptions& options,
+    const std::vector<std::string>& holdings,
+    const std::vector<std::string>& dealerUpcards,
+    std::queue<std::vector<int>>& workQueue,
+    std::vector<BlackjackGame::EVResult>& results, std::mutex& workQueueMutex,
+    std::atomic<int>& tasksCompleted, BlackjackGame::SearchStats& stats,
+    std::shared_ptr<const DealerTable> dealerTable) {
+  BlackjackGame game(rules);
+  game.setEpsilon(options.epsilon);
+  game.setMemoStorage(options.memoStorage);
+  game.setValidateMemoKeys(options.validateMemo);
+  game.setDealerTable(dealerTable);
+  bool dealerChecked =
+      rules.surrenderType != BlackjackGame::SurrenderType::Early;
+
+  while (true) {
+    std::vector<int> row;
+    {
+      std::lock_guard<std::mutex> lock(workQueueMutex);
+      if (workQueue.empty()) {
+        break;  // No more work to do
+      }
+      row = workQueue.front();
+      workQueue.pop();
+    }
+
+    game.clearMemos();
+    for (int holding : row) {
+      size_t comma = holdings[holding].find(',');
+      std::vector<Card::Rank> playerRanks = {
+          BlackjackUtils::stringToRank(holdings[holding].substr(0, comma)),
+          BlackjackUtils::stringToRank(holdings[holding].substr(comma + 1))};
+      for (size_t column = 0; column < dealerUpcards.size(); ++column) {
+        BlackjackGame::GameState state =
+            BlackjackGame::getGameStateForCalculation(
+                playerRanks, BlackjackUtils::stringToRank(dealerUpcards[column]),
+                rules.numDecks, dealerChecked);
+        results[holding * dealerUpcards.size() + column] =
+            game.calculateEVForOptimalStrategy(state);
+        tasksCompleted++;
+      }
+    }
+  }
+  stats = game.getSearchStats();
+}
+
+int StrategyGenerator::generateMulticardTable(
+    const BlackjackGame::GameRules& rules, const std::string& outputFileName,
+    int threadCount, const StrategyOptions& options) {
+  std::cout << "Solving hands of 3 to " << options.maxCards
+            << " cards using " << threadCount
+            << " threads... (this may take a few minutes)\n";
+
+  bool dealerChecked =
+      rules.surrenderType != BlackjackGame::SurrenderType::Early;
+  auto startTime = std::chrono::steady_clock::now();
+  try {
+    std::shared_ptr<const DealerTable> dealerTable =
+        getDealerTable(rules, options, threadCount);
+    MulticardTable table =
+        MulticardTable::build(rules, dealerChecked, options.maxCards,
+                              threadCount, options.memoStorage, dealerTable);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime);
+    for (int cardCount = 3; cardCount <= options.maxCards; ++cardCount) {
+      std::cout << cardCount << "-card hands: "
+                << table.getEntryCount(cardCount) << "\n";
+    }
+    std::cout << "Solved " << table.getEntryCount() << " hands in "
+              << elapsed.count() << " ms\n";
+    table.save(outputFileName);
+  } catch (const std::runtime_error& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return 1;
+  }
+  std::cout << "Multi-card strategy written to " << outputFileName << "\n";
+  std::cout << "To look up a hand, run: ./BlackjackLab ev-calc "
+               "--multicard-table "
+            << outputFileName
+            << " --decks <num> --player-cards <cards> --dealer-upcard "
+               "<card>\n";
+  return 0;
+}
+
+double StrategyGenerator::getHoldingWeight(int firstValue, int secondValue,
+                                           int upcardValue, int numDecks,
+                                           bool dealerChecked) {
+  std::array<int, 12> counts{};
+  for (int value = 2; value <= 11; ++value) {
+    counts[value] = numDecks * (value == 10 ? 16 : 4);
+  }
+  counts[upcardValue]--;
+  int cardsLeft = numDecks * 52 - 1;
+
+  double weight = static_cast<double>(counts[firstValue]) /
+                  cardsLeft;
+  counts[firstValue]--;
+  weight *= static_cast<double>(counts[secondValue]) / (cardsLeft - 1);
+  counts[secondValue]--;
+  // Either card can come first
+  if (firstValue != secondValue) {
+    weight *= 2;
+  }
+
+  // A dealer who checked has no blackjack, which is likelier when the
+  // holding took the cards that would have made one
+  if (dealerChecked && upcardValue >= 10) {
+    int blackjackValue = upcardValue == 10 ? 11 : 10;
+    weight *= 1.0 - static_cast<double>(counts[blackjackValue]) /
+                        (cardsLeft - 2);
+  }
+  return weight;
+}
+
+double StrategyGenerator::estimateTaskCost(
+    const std::string& playerHand, const std::string& dealerUpcard,
+    const BlackjackGame::GameRules& rules) {
+  // Relative solve times measured on a single deck. Low totals can take many
+  // more cards, soft hands can't bust on the first hit, and pairs also solve
+  // their split hands.
+  static constexpr double kHardCosts[] = {18, 23, 22, 10, 7,   8,   9,  7,
+                                          5,  4,  3,  2,  1.3, 0.9, 0.5};
+  static constexpr double kSoftCosts[] = {36, 32, 13, 11, 9, 7, 6, 4};
+  static constexpr double kPairCosts[] = {56, 35, 37, 39, 35,
+                                          34, 28, 21, 16, 31};
+  static constexpr double kUpcardCosts[] = {10.7, 9.3, 7.6, 6.0, 4.7,
+                                            3.4,  2.7, 2.1, 1.5, 9.0};
+
+  size_t comma = playerHand.find(',');
+  int first = BlackjackUtils::stringToValue(playerHand.substr(0, comma));
+  int second = BlackjackUtils::stringToValue(playerHand.substr(comma + 1));
+  double handCost;
+  if (first == second && rules.maxSplits > 0 &&
+      (first != 11 || rules.canSplitAces)) {
+    handCost = kPairCosts[first - 2];
+  } else if (first == 11 || second == 11) {
+    // Treat unsplittable aces like soft 13
+    handCost = kSoftCosts[std::clamp(first + second - 13, 0, 7)];
+  } else {
+    handCost = kHardCosts[std::clamp(first + second, 5, 19) - 5];
+  }
+  return handCost * kUpcardCosts[BlackjackUtils::stringToValue(dealerUpcard) -
+                                 2];
+}
+
+std::vector<int> StrategyGenerator::assignShards(
+    const std::vector<double>& rowCosts, int shardCount) {
+  std::vector<int> order(rowCosts.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    return rowCosts[a] > rowCosts[b];
+  });
+
+  std::vector<int> rowShards(rowCosts.size());
+  std::vector<double> shardCosts(shardCount, 0.0);
+  for (int row : order) {
+    int shard = std::min_element(shardCosts.begin(), shardCosts.end()) -
+                shardCosts.begin();
+    rowShards[row] = shard;
+    shardCosts[shard] += rowCosts[row];
+  }
+  return rowShards;
+}
+
+std::shared_ptr<const DealerTable> StrategyGenerator::getDealerTable(
+    const BlackjackGame::GameRules& rules, const StrategyOptions& options,
+    int threadCount) {
+  if (options.dealerTableCards == 0 && options.dealerTableFile.empty()) {
+    return nullptr;
+  }
+
+  if (!options.dealerTableFile.empty() &&
+      std::ifstream(options.dealerTableFile).good()) {
+    auto table = std::make_shared<const DealerTable>(
+        DealerTable::load(options.dealerTableFile, rules));
+    // An explicit size must match, or the run would quietly use another one
+    if (options.dealerTableCards > 0 &&
+        table->getMaxRemovedCards() != options.dealerTableCards) {
+      throw std::runtime_error(
+          options.dealerTableFile + " covers shoes missing up to " +
+          std::to_string(table->getMaxRemovedCards()) +
+          " cards, not the " + std::to_string(options.dealerTableCards) +
+          " given by '--dealer-table'. Delete it to build a new table.");
+    }
+    std::cout << "Loaded dealer table from " << options.dealerTableFile
+              << " (" << table->getMaxRemovedCards() << " cards, "
+              << table->getEntryCount() << " entries)\n";
+    return table;
+  }
+
+  int maxRemovedCards =
+      options.dealerTableCards > 0 ? options.dealerTableCards : 6;
+  std::cout << "Building dealer table for shoes missing up to "
+            << maxRemovedCards << " cards...\n";
+  auto startTime = std::chrono::steady_clock::now();
+  auto table = std::make_shared<const DealerTable>(
+      DealerTable::build(rules, maxRemovedCards, threadCount));
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - startTime);
+  std::cout << "Built " << table->getEntryCount() << " entries in "
+            << elapsed.count() << " ms\n";
+  if (!options.dealerTableFile.empty()) {
+    table->save(options.dealerTableFile);
+    std::cout << "Dealer table written to " << options.dealerTableFile
+              << "\n";
+  }
+  return table;
+}
+
+std::string StrategyGenerator::getRulesHeader(
+    const BlackjackGame::GameRules& rules, const StrategyOptions& options) {
+  std::ostringstream header;
+  header << "#Rules Used for Generation:\n";
+  if (options.infiniteDeck) {
+    header << "#Number of Decks: Infinite\n";
+  } else {
+    header << "#Number of Decks: " << rules.numDecks << "\n";
+  }
+  header << "#Dealer Hits Soft 17: " << (rules.dealerHitsSoft17 ? "Yes" : "No")
+         << "\n";
+  header << "#Can Double After Split: "
+         << (rules.canDoubleAfterSplit ? "Yes" : "No") << "\n";
+  header << "#Surrender Type: "
+         << BlackjackUtils::surrenderTypeToString(rules.surrenderType) << "\n";
+  header << "#Can Split Aces: " << (rules.canSplitAces ? "Yes" : "No") << "\n";
+  header << "#Max Splits: " << rules.maxSplits << "\n";
+  // Only listed when changed, so charts with the usual payouts stay the same
+  if (rules.blackjackPayout != 1.5) {
+    header << "#Blackjack Payout: " << rules.blackjackPayout << "\n";
+  }
+  if (rules.insurancePayout != 2.0) {
+    header << "#Insurance Payout: " << rules.insurancePayout << "\n";
+  }
+  if (options.epsilon > 0.0) {
+    header << "#Epsilon: " << options.epsilon << "\n";
+  }
+  // Single-precision dealer probabilities can move the last printed digit
+  if (options.memoStorage == BlackjackGame::MemoStorage::Float) {
+    header << "#Memo Storage: Float\n";
+  }
+  // Marks the shard files and journals whose rows have the moment columns
+  if (options.payoutMoments) {
+    header << "#Payout Moments: Yes\n";
+  }
+  if (options.compositions) {
+    header << "#Hard Totals: Composition-Weighted\n";
+  }
+  return header.str();
 }
 
 int StrategyGenerator::writeToCSV(const std::string& filename,
+                                  const std::string& rulesHeader,
                                   const std::vector<StrategyResult>& results,
-                                  const BlackjackGame::GameRules& rules) {
+                                  bool writeErrorBound, bool writeMoments) {
   std::ofstream file(filename);
   if (!file.is_open()) {
     std::cerr << "Error: Could not open file " << filename << " for writing."
@@ -321,22 +1449,28 @@ int StrategyGenerator::writeToCSV(const std::string& filename,
   }
 
   // Add rules used for generation to top of file
-  file << "#Rules Used for Generation:\n";
-  file << "#Number of Decks: " << rules.numDecks << "\n";
-  file << "#Dealer Hits Soft 17: " << (rules.dealerHitsSoft17 ? "Yes" : "No")
-       << "\n";
-  file << "#Can Double After Split: "
-       << (rules.canDoubleAfterSplit ? "Yes" : "No") << "\n";
-  file << "#Surrender Type: "
-       << BlackjackUtils::surrenderTypeToString(rules.surrenderType) << "\n";
-  file << "#Can Split Aces: " << (rules.canSplitAces ? "Yes" : "No") << "\n";
-  file << "#Max Splits: " << rules.maxSplits << "\n";
-
-  file << "Player Hand,Dealer Upcard,Optimal Action,Expected Value\n";
+  file << rulesHeader;
+  if (writeErrorBound) {
+    double maxErrorBound = 0.0;
+    for (const auto& result : results) {
+      maxErrorBound = std::max(maxErrorBound, result.errorBound);
+    }
+    file << "#Largest EV Error Bound: " << maxErrorBound << "\n";
+  }
+
+  file << "Player Hand,Dealer Upcard,Optimal Action,Expected Value";
+  if (writeMoments) {
+    file << ",Variance,Skewness";
+  }
+  file << "\n";
   for (const auto& result : results) {
     file << "\"" << result.playerHand << "\"" << "," << result.dealerUpcard
          << "," << BlackjackUtils::playerActionToString(result.optimalAction)
-         << "," << result.expectedValue << "\n";
+         << "," << result.expectedValue;
+    if (writeMoments) {
+      file << "," << result.variance << "," << result.skewness;
+    }
+    file << "\n";
   }
   file.close();
   std::cout << "Strategy written to " << filename << "\n";
@@ -349,3 +1483,26 @@ int StrategyGenerator::writeToCSV(const std::string& filename,
 
   return 0;
 }
+
+int StrategyGenerator::writeShardFile(
+    const std::string& filename, const std::string& rulesHeader,
+    const std::vector<StrategyResult>& results,
+    const std::vector<int>& taskIndices, const StrategyOptions& options) {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "Error: Could not open file " << filename << " for writing."
+              << std::endl;
+    return 1;
+  }
+
+  file << getResultFileHeader(rulesHeader, options, results.size());
+  for (int taskIndex : taskIndices) {
+    writeResultRow(file, taskIndex, results[taskIndex]);
+  }
+  file.close();
+  std::cout << "Shard " << options.shardIndex << "/" << options.shardCount
+            << " written to " << filename << "\n";
+  std::cout << "When every shard is done, run: ./BlackjackLab strategy merge "
+               "--output <filename.csv> <shard files...>\n";
+  return 0;
+}
@@ -0,0 +1,170 @@
+// StrategyTable.cpp
+#include "StrategyTable.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "BlackjackUtils.h"
+
+namespace {
+// Built-in basic strategy rows, one character per upcard 2-9, 10, A.
+// H = Hit, S = Stand, D = Double, P = Split, R = Surrender.
+const char* const kBasicHard[] = {
+    /* 5 */ "HHHHHHHHHH", /* 6 */ "HHHHHHHHHH", /* 7 */ "HHHHHHHHHH",
+    /* 8 */ "HHHHHHHHHH", /* 9 */ "HDDDDHHHHH", /* 10 */ "DDDDDDDDHH",
+    /* 11 */ "DDDDDDDDDD", /* 12 */ "HHSSSHHHHH", /* 13 */ "SSSSSHHHHH",
+    /* 14 */ "SSSSSHHHHH", /* 15 */ "SSSSSHHHRR", /* 16 */ "SSSSSHHRRR",
+    /* 17 */ "SSSSSSSSSR", /* 18 */ "SSSSSSSSSS", /* 19 */ "SSSSSSSSSS"};
+const char* const kBasicSoft[] = {
+    /* A,2 */ "HHHDDHHHHH", /* A,3 */ "HHHDDHHHHH", /* A,4 */ "HHDDDHHHHH",
+    /* A,5 */ "HHDDDHHHHH", /* A,6 */ "HDDDDHHHHH", /* A,7 */ "DDDDDSSHHH",
+    /* A,8 */ "SSSSDSSSSS", /* A,9 */ "SSSSSSSSSS"};
+const char* const kBasicPairs[] = {
+    /* 2,2 */ "PPPPPPHHHH", /* 3,3 */ "PPPPPPHHHH",   /* 4,4 */ "HHHPPHHHHH",
+    /* 5,5 */ "DDDDDDDDHH", /* 6,6 */ "PPPPPHHHHH",   /* 7,7 */ "PPPPPPHHHH",
+    /* 8,8 */ "PPPPPPPPPP", /* 9,9 */ "PPPPPSPPSS",   /* 10,10 */ "SSSSSSSSSS",
+    /* A,A */ "PPPPPPPPPP"};
+const char* const kUpcards[] = {"2", "3", "4", "5", "6",
+                                "7", "8", "9", "10", "A"};
+
+BlackjackGame::PlayerAction charToAction(char c) {
+  switch (c) {
+    case 'H':
+      return BlackjackGame::PlayerAction::Hit;
+    case 'S':
+      return BlackjackGame::PlayerAction::Stand;
+    case 'D':
+      return BlackjackGame::PlayerAction::Double;
+    case 'P':
+      return BlackjackGame::PlayerAction::Split;
+    case 'R':
+      return BlackjackGame::PlayerAction::Surrender;
+    default:
+      throw std::invalid_argument("Invalid strategy character");
+  }
+}
+
+// Removes surrounding quotes and whitespace from a CSV field
+std::string trimField(const std::string& field) {
+  size_t start = field.find_first_not_of(" \t\"");
+  size_t end = field.find_last_not_of(" \t\"\r");
+  if (start == std::string::npos) {
+    return "";
+  }
+  return field.substr(start, end - start + 1);
+}
+}  // namespace
+
+StrategyTable::StrategyTable() {
+  auto hit = static_cast<uint8_t>(PlayerAction::Hit);
+  auto stand = static_cast<uint8_t>(PlayerAction::Stand);
+  for (int total = 0; total <= 21; ++total) {
+    hard[total].fill(total <= 11 ? hit : stand);
+    soft[total].fill(total <= 17 ? hit : stand);
+  }
+  // Pairs fall back to the total rows until a chart says otherwise
+  for (auto& row : pairs) {
+    row.fill(static_cast<uint8_t>(PlayerAction::None));
+  }
+}
+
+StrategyTable StrategyTable::basic() {
+  StrategyTable table;
+  for (int col = 0; col < 10; ++col) {
+    for (int total = 5; total <= 19; ++total) {
+      table.set(std::to_string(total), kUpcards[col],
+                charToAction(kBasicHard[total - 5][col]));
+    }
+    for (int card = 2; card <= 9; ++card) {
+      table.set("A," + std::to_string(card), kUpcards[col],
+                charToAction(kBasicSoft[card - 2][col]));
+    }
+    for (int card = 2; card <= 11; ++card) {
+      std::string label = card == 11 ? "A" : std::to_string(card);
+      table.set(label + "," + label, kUpcards[col],
+                charToAction(kBasicPairs[card - 2][col]));
+    }
+  }
+  return table;
+}
+
+StrategyTable StrategyTable::fromCSV(const std::string& filename) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open strategy file " + filename);
+  }
+
+  StrategyTable table;
+  std::string line;
+  bool headerSeen = false;
+  int rowsRead = 0;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    if (!headerSeen) {
+      headerSeen = true;
+      continue;
+    }
+
+    // The player hand may itself contain a comma, so split on the quotes
+    std::string playerHand, rest;
+    if (line[0] == '"') {
+      size_t closingQuote = line.find('"', 1);
+      if (closingQuote == std::string::npos) {
+        throw std::runtime_error("Malformed strategy row: " + line);
+      }
+      playerHand = line.substr(1, closingQuote - 1);
+      rest = line.substr(std::min(line.size(), closingQuote + 2));
+    } else {
+      size_t comma = line.find(',');
+      playerHand = line.substr(0, comma);
+      rest = comma == std::string::npos ? "" : line.substr(comma + 1);
+    }
+
+    std::stringstream ss(rest);
+    std::string dealerUpcard, action;
+    std::getline(ss, dealerUpcard, ',');
+    std::getline(ss, action, ',');
+    try {
+      table.set(trimField(playerHand), trimField(dealerUpcard),
+                BlackjackUtils::stringToPlayerAction(trimField(action)));
+    } catch (const std::invalid_argument& e) {
+      throw std::runtime_error("Malformed strategy row: " + line);
+    }
+    rowsRead++;
+  }
+
+  if (rowsRead == 0) {
+    throw std::runtime_error("No strategy rows found in " + filename);
+  }
+  return table;
+}
+
+void StrategyTable::set(const std::string& playerHand,
+                        const std::string& dealerUpcard, PlayerAction action) {
+  int column = upcardIndex(BlackjackUtils::stringToValue(dealerUpcard));
+  auto encoded = static_cast<uint8_t>(action);
+
+  size_t comma = playerHand.find(',');
+  if (comma == std::string::npos) {
+    int total = std::stoi(playerHand);
+    if (total < 4 || total > 21) {
+      throw std::invalid_argument("Invalid hard total");
+    }
+    hard[total][column] = encoded;
+    return;
+  }
+
+  int first = BlackjackUtils::stringToValue(playerHand.substr(0, comma));
+  int second = BlackjackUtils::stringToValue(playerHand.substr(comma + 1));
+  if (first == second) {
+    pairs[upcardIndex(first)][column] = encoded;
+  } else if (first == 11 || second == 11) {
+    soft[first + second][column] = encoded;
+  } else {
+    hard[first + second][column] = encoded;
+  }
+}
@@ -0,0 +1,145 @@
+// TraceRecorder.cpp
+#include "TraceRecorder.h"
+
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+// Stores one finished span
+struct TraceEvent {
+  const char* name;
+  const char* category;
+  std::string label;
+  double startMicros;
+  double durationMicros;
+};
+
+// Stores the spans of one thread. Buffers are shared with the registry so
+// they outlive their thread until the trace is written.
+struct ThreadBuffer {
+  int threadId;
+  std::string threadName;
+  std::vector<TraceEvent> events;
+};
+
+std::atomic<bool> enabled = false;
+std::chrono::steady_clock::time_point traceStart;
+
+std::mutex registryMutex;
+std::vector<std::shared_ptr<ThreadBuffer>> registry;
+
+// Gets the calling thread's buffer, registering it on first use
+ThreadBuffer& getThreadBuffer() {
+  thread_local std::shared_ptr<ThreadBuffer> buffer;
+  if (!buffer) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer = std::make_shared<ThreadBuffer>();
+    buffer->threadId = static_cast<int>(registry.size()) + 1;
+    buffer->threadName = "Thread " + std::to_string(buffer->threadId);
+    registry.push_back(buffer);
+  }
+  return *buffer;
+}
+
+// Gets the time since the trace started in microseconds
+double microsSinceStart(std::chrono::steady_clock::time_point time) {
+  return std::chrono::duration<double, std::micro>(time - traceStart).count();
+}
+
+// Writes a string as a JSON string literal
+void writeJsonString(std::ostream& out, const std::string& text) {
+  out << '"';
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out << ' ';
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+}  // namespace
+
+void TraceRecorder::start() {
+  traceStart = std::chrono::steady_clock::now();
+  enabled = true;
+}
+
+bool TraceRecorder::isEnabled() {
+  return enabled.load(std::memory_order_relaxed);
+}
+
+void TraceRecorder::setThreadName(const std::string& name) {
+  if (isEnabled()) {
+    getThreadBuffer().threadName = name;
+  }
+}
+
+void TraceRecorder::write(const std::string& filename) {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    throw std::runtime_error("Could not open " + filename + " for writing.");
+  }
+
+  std::lock_guard<std::mutex> lock(registryMutex);
+  file << std::fixed << std::setprecision(3);
+  file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  bool first = true;
+  for (const auto& buffer : registry) {
+    file << (first ? "" : ",\n")
+         << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+            "\"tid\": "
+         << buffer->threadId << ", \"args\": {\"name\": ";
+    writeJsonString(file, buffer->threadName);
+    file << "}}";
+    first = false;
+    for (const auto& event : buffer->events) {
+      file << ",\n{\"name\": ";
+      writeJsonString(file, event.name);
+      file << ", \"cat\": ";
+      writeJsonString(file, event.category);
+      file << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->threadId
+           << ", \"ts\": " << event.startMicros
+           << ", \"dur\": " << event.durationMicros;
+      if (!event.label.empty()) {
+        file << ", \"args\": {\"label\": ";
+        writeJsonString(file, event.label);
+        file << "}";
+      }
+      file << "}";
+    }
+  }
+  file << "\n]}\n";
+  if (!file) {
+    throw std::runtime_error("Could not write trace " + filename);
+  }
+}
+
+TraceRecorder::Span::Span(const char* name, const char* category,
+                          std::string label)
+    : enabled(isEnabled()),
+      name(name),
+      category(category),
+      label(std::move(label)) {
+  if (enabled) {
+    startTime = std::chrono::steady_clock::now();
+  }
+}
+
+TraceRecorder::Span::~Span() {
+  if (!enabled) {
+    return;
+  }
+  auto endTime = std::chrono::steady_clock::now();
+  double start = microsSinceStart(startTime);
+  getThreadBuffer().events.push_back(
+      {name, category, std::move(label), start,
+       microsSinceStart(endTime) - start});
+}